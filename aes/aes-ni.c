@@ -0,0 +1,286 @@
+/*
+   Copyright 2020 Andrew Li, Gavin Li
+
+   li.andrew.mail@gmail.com
+   gavinux@gmail.com
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+/*
+ * AES-NI backend, key expansion follows
+ * Intel Advanced Encryption Standard (AES) New Instructions Set, white paper 323641
+ * the round keys are the same bytes as the FIPS-197 key schedule
+ */
+#include <string.h>
+#include "aes.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <wmmintrin.h>
+#include <emmintrin.h>
+
+#define AESNI_TARGET __attribute__((target("aes,sse2")))
+
+int  aesni_supported(void)
+{
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("aes");
+}
+
+AESNI_TARGET
+static inline __m128i key_128_assist(__m128i t1, __m128i t2)
+{
+	__m128i t3;
+
+	t2 = _mm_shuffle_epi32(t2, 0xff);
+	t3 = _mm_slli_si128(t1, 4);
+	t1 = _mm_xor_si128(t1, t3);
+	t3 = _mm_slli_si128(t3, 4);
+	t1 = _mm_xor_si128(t1, t3);
+	t3 = _mm_slli_si128(t3, 4);
+	t1 = _mm_xor_si128(t1, t3);
+	return _mm_xor_si128(t1, t2);
+}
+
+AESNI_TARGET
+static void key_expansion_128(const uint8_t *key, __m128i *ks)
+{
+	__m128i t;
+
+	ks[0]  = t = _mm_loadu_si128((const __m128i *)key);
+	ks[1]  = t = key_128_assist(t, _mm_aeskeygenassist_si128(t, 0x01));
+	ks[2]  = t = key_128_assist(t, _mm_aeskeygenassist_si128(t, 0x02));
+	ks[3]  = t = key_128_assist(t, _mm_aeskeygenassist_si128(t, 0x04));
+	ks[4]  = t = key_128_assist(t, _mm_aeskeygenassist_si128(t, 0x08));
+	ks[5]  = t = key_128_assist(t, _mm_aeskeygenassist_si128(t, 0x10));
+	ks[6]  = t = key_128_assist(t, _mm_aeskeygenassist_si128(t, 0x20));
+	ks[7]  = t = key_128_assist(t, _mm_aeskeygenassist_si128(t, 0x40));
+	ks[8]  = t = key_128_assist(t, _mm_aeskeygenassist_si128(t, 0x80));
+	ks[9]  = t = key_128_assist(t, _mm_aeskeygenassist_si128(t, 0x1b));
+	ks[10] = t = key_128_assist(t, _mm_aeskeygenassist_si128(t, 0x36));
+}
+
+AESNI_TARGET
+static inline void key_192_assist(__m128i *t1, __m128i *t2, __m128i *t3)
+{
+	__m128i t4;
+
+	*t2 = _mm_shuffle_epi32(*t2, 0x55);
+	t4  = _mm_slli_si128(*t1, 4);
+	*t1 = _mm_xor_si128(*t1, t4);
+	t4  = _mm_slli_si128(t4, 4);
+	*t1 = _mm_xor_si128(*t1, t4);
+	t4  = _mm_slli_si128(t4, 4);
+	*t1 = _mm_xor_si128(*t1, t4);
+	*t1 = _mm_xor_si128(*t1, *t2);
+	*t2 = _mm_shuffle_epi32(*t1, 0xff);
+	t4  = _mm_slli_si128(*t3, 4);
+	*t3 = _mm_xor_si128(*t3, t4);
+	*t3 = _mm_xor_si128(*t3, *t2);
+}
+
+/* low half of a, low half of b */
+#define SHUFFLE_LO(a, b)  ((__m128i)_mm_shuffle_pd((__m128d)(a), (__m128d)(b), 0))
+/* high half of a, low half of b */
+#define SHUFFLE_HL(a, b)  ((__m128i)_mm_shuffle_pd((__m128d)(a), (__m128d)(b), 1))
+
+/* 6 key words per step, two steps fill three round keys */
+#define KEY_192_STEP2(i, rc1, rc2) do { \
+	t2 = _mm_aeskeygenassist_si128(t3, rc1); \
+	key_192_assist(&t1, &t2, &t3); \
+	ks[i]   = SHUFFLE_LO(ks[i], t1); \
+	ks[i+1] = SHUFFLE_HL(t1, t3); \
+	t2 = _mm_aeskeygenassist_si128(t3, rc2); \
+	key_192_assist(&t1, &t2, &t3); \
+	ks[i+2] = t1; \
+	ks[i+3] = t3; \
+} while (0)
+
+AESNI_TARGET
+static void key_expansion_192(const uint8_t *key, __m128i *ks)
+{
+	__m128i t1, t2, t3;
+
+	t1 = _mm_loadu_si128((const __m128i *)key);
+	t3 = _mm_loadl_epi64((const __m128i *)(key + 16));
+	ks[0] = t1;
+	ks[1] = t3;
+	KEY_192_STEP2(1, 0x01, 0x02);
+	KEY_192_STEP2(4, 0x04, 0x08);
+	KEY_192_STEP2(7, 0x10, 0x20);
+	t2 = _mm_aeskeygenassist_si128(t3, 0x40);
+	key_192_assist(&t1, &t2, &t3);
+	ks[10] = SHUFFLE_LO(ks[10], t1);
+	ks[11] = SHUFFLE_HL(t1, t3);
+	t2 = _mm_aeskeygenassist_si128(t3, 0x80);
+	key_192_assist(&t1, &t2, &t3);
+	ks[12] = t1;
+}
+
+AESNI_TARGET
+static inline void key_256_assist_1(__m128i *t1, __m128i t2)
+{
+	__m128i t4;
+
+	t2  = _mm_shuffle_epi32(t2, 0xff);
+	t4  = _mm_slli_si128(*t1, 4);
+	*t1 = _mm_xor_si128(*t1, t4);
+	t4  = _mm_slli_si128(t4, 4);
+	*t1 = _mm_xor_si128(*t1, t4);
+	t4  = _mm_slli_si128(t4, 4);
+	*t1 = _mm_xor_si128(*t1, t4);
+	*t1 = _mm_xor_si128(*t1, t2);
+}
+
+AESNI_TARGET
+static inline void key_256_assist_2(__m128i t1, __m128i *t3)
+{
+	__m128i t2, t4;
+
+	t4  = _mm_aeskeygenassist_si128(t1, 0x00);
+	t2  = _mm_shuffle_epi32(t4, 0xaa);
+	t4  = _mm_slli_si128(*t3, 4);
+	*t3 = _mm_xor_si128(*t3, t4);
+	t4  = _mm_slli_si128(t4, 4);
+	*t3 = _mm_xor_si128(*t3, t4);
+	t4  = _mm_slli_si128(t4, 4);
+	*t3 = _mm_xor_si128(*t3, t4);
+	*t3 = _mm_xor_si128(*t3, t2);
+}
+
+#define KEY_256_STEP(i, rc) do { \
+	key_256_assist_1(&t1, _mm_aeskeygenassist_si128(t3, rc)); \
+	ks[i] = t1; \
+	key_256_assist_2(t1, &t3); \
+	ks[i+1] = t3; \
+} while (0)
+
+AESNI_TARGET
+static void key_expansion_256(const uint8_t *key, __m128i *ks)
+{
+	__m128i t1, t3;
+
+	t1 = _mm_loadu_si128((const __m128i *)key);
+	t3 = _mm_loadu_si128((const __m128i *)(key + 16));
+	ks[0] = t1;
+	ks[1] = t3;
+	KEY_256_STEP(2,  0x01);
+	KEY_256_STEP(4,  0x02);
+	KEY_256_STEP(6,  0x04);
+	KEY_256_STEP(8,  0x08);
+	KEY_256_STEP(10, 0x10);
+	KEY_256_STEP(12, 0x20);
+	key_256_assist_1(&t1, _mm_aeskeygenassist_si128(t3, 0x40));
+	ks[14] = t1;
+}
+
+/* rk.ni[0] encryption keys, rk.ni[1] decryption keys for aesdec: reversed and InvMixColumns'ed */
+AESNI_TARGET
+int  aesni_key_schedule(aes_ctx_t *ctx)
+{
+	int i, nround;
+	__m128i ek[15], dk[15];
+
+	switch (ctx->keylen) {
+		case 128: nround = 10; key_expansion_128(ctx->key, ek); break;
+		case 192: nround = 12; key_expansion_192(ctx->key, ek); break;
+		case 256: nround = 14; key_expansion_256(ctx->key, ek); break;
+		default: return -1;
+	}
+	dk[0] = ek[nround];
+	for (i=1; i<nround; i++)
+		dk[i] = _mm_aesimc_si128(ek[nround-i]);
+	dk[nround] = ek[0];
+	memcpy(ctx->rk.ni[0], ek, (nround+1)*16);
+	memcpy(ctx->rk.ni[1], dk, (nround+1)*16);
+	return 0;
+}
+
+/*
+ * 8 independent blocks are interleaved to hide the latency of aesenc/aesdec,
+ * then 4, then single blocks
+ */
+#define AESNI_CRYPT(name, round, last) \
+AESNI_TARGET \
+static void name(const uint8_t *keys, int nround, uint8_t *blocks, size_t nblocks) \
+{ \
+	int i, j; \
+	__m128i k, b[8], rk[15]; \
+	for (i=0; i<=nround; i++) \
+		rk[i] = _mm_loadu_si128((const __m128i *)(keys + 16*i)); \
+	for (; nblocks >= 8; nblocks -= 8, blocks += 8*16) { \
+		for (j=0; j<8; j++) \
+			b[j] = _mm_xor_si128(_mm_loadu_si128((__m128i *)(blocks + 16*j)), rk[0]); \
+		for (i=1; i<nround; i++) { \
+			k = rk[i]; \
+			for (j=0; j<8; j++) \
+				b[j] = round(b[j], k); \
+		} \
+		k = rk[nround]; \
+		for (j=0; j<8; j++) \
+			_mm_storeu_si128((__m128i *)(blocks + 16*j), last(b[j], k)); \
+	} \
+	for (; nblocks >= 4; nblocks -= 4, blocks += 4*16) { \
+		for (j=0; j<4; j++) \
+			b[j] = _mm_xor_si128(_mm_loadu_si128((__m128i *)(blocks + 16*j)), rk[0]); \
+		for (i=1; i<nround; i++) { \
+			k = rk[i]; \
+			for (j=0; j<4; j++) \
+				b[j] = round(b[j], k); \
+		} \
+		k = rk[nround]; \
+		for (j=0; j<4; j++) \
+			_mm_storeu_si128((__m128i *)(blocks + 16*j), last(b[j], k)); \
+	} \
+	for (; nblocks; nblocks--, blocks += 16) { \
+		b[0] = _mm_xor_si128(_mm_loadu_si128((__m128i *)blocks), rk[0]); \
+		for (i=1; i<nround; i++) \
+			b[0] = round(b[0], rk[i]); \
+		_mm_storeu_si128((__m128i *)blocks, last(b[0], rk[nround])); \
+	} \
+}
+
+AESNI_CRYPT(aesni_cipher,    _mm_aesenc_si128, _mm_aesenclast_si128)
+AESNI_CRYPT(aesni_invcipher, _mm_aesdec_si128, _mm_aesdeclast_si128)
+
+void aesni_encrypt(aes_ctx_t *ctx, uint8_t *blocks, size_t nblocks)
+{
+	aesni_cipher(ctx->rk.ni[0], ctx->keylen/32 + 6, blocks, nblocks);
+}
+
+void aesni_decrypt(aes_ctx_t *ctx, uint8_t *blocks, size_t nblocks)
+{
+	aesni_invcipher(ctx->rk.ni[1], ctx->keylen/32 + 6, blocks, nblocks);
+}
+
+#else /* no AES-NI on this architecture */
+
+int  aesni_supported(void)
+{
+	return 0;
+}
+
+int  aesni_key_schedule(aes_ctx_t *ctx)
+{
+	return -1;
+}
+
+void aesni_encrypt(aes_ctx_t *ctx, uint8_t *blocks, size_t nblocks)
+{
+}
+
+void aesni_decrypt(aes_ctx_t *ctx, uint8_t *blocks, size_t nblocks)
+{
+}
+
+#endif
@@ -25,16 +25,34 @@
 
 typedef struct aes_ctx aes_ctx_t;
 
+/*
+ * the implementation behind encrypt/decrypt,
+ * aes_init() uses eAES_AESNI if the CPU has it, eAES_TTABLE otherwise
+ */
+enum aes_impl {
+	eAES_BYTE,     /* byte-wise FIPS-197 round functions, the reference */
+	eAES_TTABLE,   /* 32-bit T-tables, table lookups depend on the data */
+	eAES_BITSLICE, /* constant time, 8 blocks in parallel */
+	eAES_AESNI,    /* x86 AES-NI, falls back to eAES_TTABLE without it */
+};
+
 struct aes_ctx {
 	int     (*init)(aes_ctx_t *ctx, uint8_t *key, int keylen);
 	void (*encrypt)(aes_ctx_t *ctx, uint8_t *blocks, size_t nblocks);
 	void (*decrypt)(aes_ctx_t *ctx, uint8_t *blocks, size_t nblocks);
 	int  keylen, blklen; /* all lengths in bits */
+	int  impl;           /* enum aes_impl */
 	uint8_t key[256/8];
 	uint8_t roundkey[60*16]; /*big enough for aes-128,192,256 */
+	union {
+		uint32_t tt[2][60];          /* T-table encryption and decryption round keys */
+		unsigned __int128 bs[15][8]; /* bitsliced round keys, 8 bit-planes per round */
+		uint8_t  ni[2][15*16];       /* AES-NI encryption and decryption round keys */
+	} rk;
 };
 
 int  aes_init(aes_ctx_t *ctx, uint8_t *key, int keylen);
+int  aes_init_impl(aes_ctx_t *ctx, uint8_t *key, int keylen, enum aes_impl impl);
 
 #endif /* __AES_H__ */
 
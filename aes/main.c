@@ -26,6 +26,8 @@
 #include <unistd.h>
 #include "aes.h"
 
+#define ARRAY_SIZE(x) (sizeof(x) / sizeof(x[0]))
+
 /*
  * openssl enc -aes-128-cbc -e -in aes-in.bin -out aes-encrypt.bin -K 2b7e151628aed2a6abf7158809cf4f3c -iv 0 -nopad
  * openssl enc -aes-128-cbc -d -in aes-encrypt.bin -out aes-decrypt.bin -K 2b7e151628aed2a6abf7158809cf4f3c -iv 0 -nopad
@@ -78,10 +80,19 @@ uint8_t in[]  = {
 	0x6b, 0xc1, 0xbe, 0xe2, 0x2e, 0x40, 0x9f, 0x96, 0xe9, 0x3d, 0x7e, 0x11, 0x73, 0x93, 0x17, 0x2a
 };
 uint8_t test_vector[16];
+uint8_t multi_in[19*16], multi_ref[19*16], multi_out[19*16];
+
+static char *impls[] = {
+	[eAES_BYTE]     = "byte-wise",
+	[eAES_TTABLE]   = "T-table",
+	[eAES_BITSLICE] = "bitsliced",
+	[eAES_AESNI]    = "AES-NI",
+};
 
 int main(int argc, char *argv[])
 {
 	ssize_t n;
+	int i, nb, impl;
 	aes_ctx_t ctx;
 	/* create a input file */
 	int fd = open("aes-in.bin", O_WRONLY | O_CREAT, 0644);
@@ -102,32 +113,59 @@ int main(int argc, char *argv[])
 	if (memcmp(blocks_in, blocks_out, sizeof(blocks_in))) printf("AES-128 encrypt/decrypt failed\n");
 	else printf("AES-128 encrypt/decrypt succeeded\n");
 
-	memcpy(test_vector, in, 16);
-	ctx.encrypt(&ctx, test_vector, 1);
-	if (memcmp(out128, test_vector, 16)) printf("AES-128 encrypt failed\n");
-	else printf("AES-128 encrypt succeeded\n");
-	ctx.decrypt(&ctx, test_vector, 1);
-	if (memcmp(in, test_vector, 16)) printf("AES-128 decrypt failed\n");
-	else printf("AES-128 decrypt succeeded\n");
-
-	memcpy(test_vector, in, 16);
-	aes_init(&ctx, key192, 192);
-	ctx.encrypt(&ctx, test_vector, 1);
-	if (memcmp(out192, test_vector, 16)) printf("AES-192 encrypt failed\n");
-	else printf("AES-192 encrypt succeeded\n");
-	ctx.decrypt(&ctx, test_vector, 1);
-	if (memcmp(in, test_vector, 16)) printf("AES-192 decrypt failed\n");
-	else printf("AES-192 decrypt succeeded\n");
-
-	memcpy(test_vector, in, 16);
-	aes_init(&ctx, key256, 256);
-	ctx.encrypt(&ctx, test_vector, 1);
-	if (memcmp(out256, test_vector, 16)) printf("AES-256 encrypt failed\n");
-	else printf("AES-256 encrypt succeeded\n");
-	ctx.decrypt(&ctx, test_vector, 1);
-	if (memcmp(in, test_vector, 16)) printf("AES-256 decrypt failed\n");
-	else printf("AES-256 decrypt succeeded\n");
+	for (impl=0; impl<ARRAY_SIZE(impls); impl++) {
+		printf("%s:\n", impls[impl]);
+		memcpy(test_vector, in, 16);
+		aes_init_impl(&ctx, key128, 128, impl);
+		ctx.encrypt(&ctx, test_vector, 1);
+		if (memcmp(out128, test_vector, 16)) printf("AES-128 encrypt failed\n");
+		else printf("AES-128 encrypt succeeded\n");
+		ctx.decrypt(&ctx, test_vector, 1);
+		if (memcmp(in, test_vector, 16)) printf("AES-128 decrypt failed\n");
+		else printf("AES-128 decrypt succeeded\n");
+
+		memcpy(test_vector, in, 16);
+		aes_init_impl(&ctx, key192, 192, impl);
+		ctx.encrypt(&ctx, test_vector, 1);
+		if (memcmp(out192, test_vector, 16)) printf("AES-192 encrypt failed\n");
+		else printf("AES-192 encrypt succeeded\n");
+		ctx.decrypt(&ctx, test_vector, 1);
+		if (memcmp(in, test_vector, 16)) printf("AES-192 decrypt failed\n");
+		else printf("AES-192 decrypt succeeded\n");
+
+		memcpy(test_vector, in, 16);
+		aes_init_impl(&ctx, key256, 256, impl);
+		ctx.encrypt(&ctx, test_vector, 1);
+		if (memcmp(out256, test_vector, 16)) printf("AES-256 encrypt failed\n");
+		else printf("AES-256 encrypt succeeded\n");
+		ctx.decrypt(&ctx, test_vector, 1);
+		if (memcmp(in, test_vector, 16)) printf("AES-256 decrypt failed\n");
+		else printf("AES-256 decrypt succeeded\n");
+	}
 
+	/* every implementation must give the same result for any number of blocks */
+	for (i=0; i<sizeof(multi_in); i++)
+		multi_in[i] = i * 7 + 3;
+	memcpy(multi_ref, multi_in, sizeof(multi_in));
+	aes_init_impl(&ctx, key256, 256, eAES_BYTE);
+	ctx.encrypt(&ctx, multi_ref, sizeof(multi_ref)/16);
+	for (impl=0; impl<ARRAY_SIZE(impls); impl++) {
+		for (nb=1; nb<=sizeof(multi_in)/16; nb+=6) {
+			memcpy(multi_out, multi_in, sizeof(multi_in));
+			aes_init_impl(&ctx, key256, 256, impl);
+			ctx.encrypt(&ctx, multi_out, nb);
+			if (memcmp(multi_out, multi_ref, nb*16)) {
+				printf("%s: %d blocks encrypt failed\n", impls[impl], nb);
+				return -1;
+			}
+			ctx.decrypt(&ctx, multi_out, nb);
+			if (memcmp(multi_out, multi_in, nb*16)) {
+				printf("%s: %d blocks decrypt failed\n", impls[impl], nb);
+				return -1;
+			}
+		}
+	}
+	printf("multi-block encrypt/decrypt succeeded\n");
 
 	return 0;
 }
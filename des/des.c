@@ -26,54 +26,25 @@
 #define B0   (1UL<<63)
 #define B0B1 (3UL<<62)
 
-typedef enum {ip, p, fp, exp, pc1, pc2} operation_t;
+#define ROL32(x, n) ((x) << (n) | (x) >> (32 - (n)))
+#define ROR32(x, n) ((x) >> (n) | (x) << (32 - (n)))
+
+/* swaps the bits of b selected by m with the bits of a selected by m << n */
+#define PERM_OP(a, b, n, m) do {               \
+	uint32_t t_ = ((a) >> (n) ^ (b)) & (m); \
+	(b) ^= t_;                              \
+	(a) ^= t_ << (n);                       \
+} while (0)
+
+typedef enum {pc1, pc2} operation_t;
 
 static inline void setbit(uint64_t *in64, uint64_t *out64, int from, int to);
 static void permutation(uint64_t *in, uint64_t *out, operation_t op);
-static void sbox(uint64_t *in48, uint64_t *out32);
-static void key_schedule(uint64_t *key64, uint64_t *keyset48);
-static void cipher(uint64_t *keyset48, uint64_t *block, int mode);
+static void key_schedule(uint64_t *key64, uint32_t ks[16][2]);
 static void swap_u64(uint64_t *u64);
 
 
 /* zero-based tables */
-static const int initial_permutation_table[64] = {
-	57, 49, 41, 33, 25, 17,  9,  1,
-	59, 51, 43, 35, 27, 19, 11,  3,
-	61, 53, 45, 37, 29, 21, 13,  5,
-	63, 55, 47, 39, 31, 23, 15,  7,
-	56, 48, 40, 32, 24, 16,  8,  0,
-	58, 50, 42, 34, 26, 18, 10,  2,
-	60, 52, 44, 36, 28, 20, 12,  4,
-	62, 54, 46, 38, 30, 22, 14,  6
-};
-static const int final_permutation_table[64] = {
-	39,  7, 47, 15, 55, 23, 63, 31,
-	38,  6, 46, 14, 54, 22, 62, 30,
-	37,  5, 45, 13, 53, 21, 61, 29,
-	36,  4, 44, 12, 52, 20, 60, 28,
-	35,  3, 43, 11, 51, 19, 59, 27,
-	34,  2, 42, 10, 50, 18, 58, 26,
-	33,  1, 41,  9, 49, 17, 57, 25,
-	32,  0, 40,  8, 48, 16, 56, 24
-};
-static const int expansion_table[48] = {
-	31,  0,  1,  2,  3,  4,
-	 3,  4,  5,  6,  7,  8,
-	 7,  8,  9, 10, 11, 12,
-	11, 12, 13, 14, 15, 16,
-	15, 16, 17, 18, 19, 20,
-	19, 20, 21, 22, 23, 24,
-	23, 24, 25, 26, 27, 28,
-	27, 28, 29, 30, 31,  0
-};
-static const int p_permutation_table[32] =
-{
-	15,  6, 19, 20, 28, 11, 27, 16,
-	 0, 14, 22, 25,  4, 17, 30,  9,
-	 1,  7, 23, 13, 31, 26,  2,  8,
-	18, 12, 29,  5, 21, 10,  3, 24
-};
 static const int pc1_permutation_table[56] =
 {
 	56, 48, 40, 32, 24, 16,  8,  0,
@@ -94,63 +65,155 @@ static const int pc2_permutation_table[48] =
 	33, 52, 45, 41, 49, 35, 28, 31
 };
 
-/* 
- * sbox table re-organized as follow:
- * the original 6-bit index is rccccr
- *     which r is for row number
- *           c is for column number
- * this table is organized as a one-dimension
- * array, the idex is the 6-bit number
+/*
+ * the S-boxes followed by the P permutation, sp_table[i] is indexed
+ * by the 6 input bits of S-box i+1 and gives its 4 output bits already
+ * at their place in the 32-bit P output, so a round is 8 lookups and xors
  */
-static const uint8_t sbox_table[][64] =
-{
+static const uint32_t sp_table[8][64] = {
 	{
-		14,  0,  4, 15, 13,  7,  1,  4,  2, 14, 15,  2, 11, 13,  8,  1,
-		 3, 10, 10,  6,  6, 12, 12, 11,  5,  9,  9,  5,  0,  3,  7,  8,
-		 4, 15,  1, 12, 14,  8,  8,  2, 13,  4,  6,  9,  2,  1, 11,  7,
-		15,  5, 12, 11,  9,  3,  7, 14,  3, 10, 10,  0,  5,  6,  0, 13
+		0x00808200, 0x00000000, 0x00008000, 0x00808202,
+		0x00808002, 0x00008202, 0x00000002, 0x00008000,
+		0x00000200, 0x00808200, 0x00808202, 0x00000200,
+		0x00800202, 0x00808002, 0x00800000, 0x00000002,
+		0x00000202, 0x00800200, 0x00800200, 0x00008200,
+		0x00008200, 0x00808000, 0x00808000, 0x00800202,
+		0x00008002, 0x00800002, 0x00800002, 0x00008002,
+		0x00000000, 0x00000202, 0x00008202, 0x00800000,
+		0x00008000, 0x00808202, 0x00000002, 0x00808000,
+		0x00808200, 0x00800000, 0x00800000, 0x00000200,
+		0x00808002, 0x00008000, 0x00008200, 0x00800002,
+		0x00000200, 0x00000002, 0x00800202, 0x00008202,
+		0x00808202, 0x00008002, 0x00808000, 0x00800202,
+		0x00800002, 0x00000202, 0x00008202, 0x00808200,
+		0x00000202, 0x00800200, 0x00800200, 0x00000000,
+		0x00008002, 0x00008200, 0x00000000, 0x00808002
 	},
 	{
-		15,  3,  1, 13,  8,  4, 14,  7,  6, 15, 11,  2,  3,  8,  4, 14,
-		 9, 12,  7,  0,  2,  1, 13, 10, 12,  6,  0,  9,  5, 11, 10,  5,
-		 0, 13, 14,  8,  7, 10, 11,  1, 10,  3,  4, 15, 13,  4,  1,  2,
-		 5, 11,  8,  6, 12,  7,  6, 12,  9,  0,  3,  5,  2, 14, 15,  9
+		0x40084010, 0x40004000, 0x00004000, 0x00084010,
+		0x00080000, 0x00000010, 0x40080010, 0x40004010,
+		0x40000010, 0x40084010, 0x40084000, 0x40000000,
+		0x40004000, 0x00080000, 0x00000010, 0x40080010,
+		0x00084000, 0x00080010, 0x40004010, 0x00000000,
+		0x40000000, 0x00004000, 0x00084010, 0x40080000,
+		0x00080010, 0x40000010, 0x00000000, 0x00084000,
+		0x00004010, 0x40084000, 0x40080000, 0x00004010,
+		0x00000000, 0x00084010, 0x40080010, 0x00080000,
+		0x40004010, 0x40080000, 0x40084000, 0x00004000,
+		0x40080000, 0x40004000, 0x00000010, 0x40084010,
+		0x00084010, 0x00000010, 0x00004000, 0x40000000,
+		0x00004010, 0x40084000, 0x00080000, 0x40000010,
+		0x00080010, 0x40004010, 0x40000010, 0x00080010,
+		0x00084000, 0x00000000, 0x40004000, 0x00004010,
+		0x40000000, 0x40080010, 0x40084010, 0x00084000
 	},
 	{
-		10, 13,  0,  7,  9,  0, 14,  9,  6,  3,  3,  4, 15,  6,  5, 10,
-		 1,  2, 13,  8, 12,  5,  7, 14, 11, 12,  4, 11,  2, 15,  8,  1,
-		13,  1,  6, 10,  4, 13,  9,  0,  8,  6, 15,  9,  3,  8,  0,  7,
-		11,  4,  1, 15,  2, 14, 12,  3,  5, 11, 10,  5, 14,  2,  7, 12
+		0x00000104, 0x04010100, 0x00000000, 0x04010004,
+		0x04000100, 0x00000000, 0x00010104, 0x04000100,
+		0x00010004, 0x04000004, 0x04000004, 0x00010000,
+		0x04010104, 0x00010004, 0x04010000, 0x00000104,
+		0x04000000, 0x00000004, 0x04010100, 0x00000100,
+		0x00010100, 0x04010000, 0x04010004, 0x00010104,
+		0x04000104, 0x00010100, 0x00010000, 0x04000104,
+		0x00000004, 0x04010104, 0x00000100, 0x04000000,
+		0x04010100, 0x04000000, 0x00010004, 0x00000104,
+		0x00010000, 0x04010100, 0x04000100, 0x00000000,
+		0x00000100, 0x00010004, 0x04010104, 0x04000100,
+		0x04000004, 0x00000100, 0x00000000, 0x04010004,
+		0x04000104, 0x00010000, 0x04000000, 0x04010104,
+		0x00000004, 0x00010104, 0x00010100, 0x04000004,
+		0x04010000, 0x04000104, 0x00000104, 0x04010000,
+		0x00010104, 0x00000004, 0x04010004, 0x00010100
 	},
 	{
-		 7, 13, 13,  8, 14, 11,  3,  5,  0,  6,  6, 15,  9,  0, 10,  3,
-		 1,  4,  2,  7,  8,  2,  5, 12, 11,  1, 12, 10,  4, 14, 15,  9,
-		10,  3,  6, 15,  9,  0,  0,  6, 12, 10, 11,  1,  7, 13, 13,  8,
-		15,  9,  1,  4,  3,  5, 14, 11,  5, 12,  2,  7,  8,  2,  4, 14
+		0x80401000, 0x80001040, 0x80001040, 0x00000040,
+		0x00401040, 0x80400040, 0x80400000, 0x80001000,
+		0x00000000, 0x00401000, 0x00401000, 0x80401040,
+		0x80000040, 0x00000000, 0x00400040, 0x80400000,
+		0x80000000, 0x00001000, 0x00400000, 0x80401000,
+		0x00000040, 0x00400000, 0x80001000, 0x00001040,
+		0x80400040, 0x80000000, 0x00001040, 0x00400040,
+		0x00001000, 0x00401040, 0x80401040, 0x80000040,
+		0x00400040, 0x80400000, 0x00401000, 0x80401040,
+		0x80000040, 0x00000000, 0x00000000, 0x00401000,
+		0x00001040, 0x00400040, 0x80400040, 0x80000000,
+		0x80401000, 0x80001040, 0x80001040, 0x00000040,
+		0x80401040, 0x80000040, 0x80000000, 0x00001000,
+		0x80400000, 0x80001000, 0x00401040, 0x80400040,
+		0x80001000, 0x00001040, 0x00400000, 0x80401000,
+		0x00000040, 0x00400000, 0x00001000, 0x00401040
 	},
 	{
-		 2, 14, 12, 11,  4,  2,  1, 12,  7,  4, 10,  7, 11, 13,  6,  1,
-		 8,  5,  5,  0,  3, 15, 15, 10, 13,  3,  0,  9, 14,  8,  9,  6,
-		 4, 11,  2,  8,  1, 12, 11,  7, 10,  1, 13, 14,  7,  2,  8, 13,
-		15,  6,  9, 15, 12,  0,  5,  9,  6, 10,  3,  4,  0,  5, 14,  3
+		0x00000080, 0x01040080, 0x01040000, 0x21000080,
+		0x00040000, 0x00000080, 0x20000000, 0x01040000,
+		0x20040080, 0x00040000, 0x01000080, 0x20040080,
+		0x21000080, 0x21040000, 0x00040080, 0x20000000,
+		0x01000000, 0x20040000, 0x20040000, 0x00000000,
+		0x20000080, 0x21040080, 0x21040080, 0x01000080,
+		0x21040000, 0x20000080, 0x00000000, 0x21000000,
+		0x01040080, 0x01000000, 0x21000000, 0x00040080,
+		0x00040000, 0x21000080, 0x00000080, 0x01000000,
+		0x20000000, 0x01040000, 0x21000080, 0x20040080,
+		0x01000080, 0x20000000, 0x21040000, 0x01040080,
+		0x20040080, 0x00000080, 0x01000000, 0x21040000,
+		0x21040080, 0x00040080, 0x21000000, 0x21040080,
+		0x01040000, 0x00000000, 0x20040000, 0x21000000,
+		0x00040080, 0x01000080, 0x20000080, 0x00040000,
+		0x00000000, 0x20040000, 0x01040080, 0x20000080
 	},
 	{
-		12, 10,  1, 15, 10,  4, 15,  2,  9,  7,  2, 12,  6,  9,  8,  5,
-		 0,  6, 13,  1,  3, 13,  4, 14, 14,  0,  7, 11,  5,  3, 11,  8,
-		 9,  4, 14,  3, 15,  2,  5, 12,  2,  9,  8,  5, 12, 15,  3, 10,
-		 7, 11,  0, 14,  4,  1, 10,  7,  1,  6, 13,  0, 11,  8,  6, 13
+		0x10000008, 0x10200000, 0x00002000, 0x10202008,
+		0x10200000, 0x00000008, 0x10202008, 0x00200000,
+		0x10002000, 0x00202008, 0x00200000, 0x10000008,
+		0x00200008, 0x10002000, 0x10000000, 0x00002008,
+		0x00000000, 0x00200008, 0x10002008, 0x00002000,
+		0x00202000, 0x10002008, 0x00000008, 0x10200008,
+		0x10200008, 0x00000000, 0x00202008, 0x10202000,
+		0x00002008, 0x00202000, 0x10202000, 0x10000000,
+		0x10002000, 0x00000008, 0x10200008, 0x00202000,
+		0x10202008, 0x00200000, 0x00002008, 0x10000008,
+		0x00200000, 0x10002000, 0x10000000, 0x00002008,
+		0x10000008, 0x10202008, 0x00202000, 0x10200000,
+		0x00202008, 0x10202000, 0x00000000, 0x10200008,
+		0x00000008, 0x00002000, 0x10200000, 0x00202008,
+		0x00002000, 0x00200008, 0x10002008, 0x00000000,
+		0x10202000, 0x10000000, 0x00200008, 0x10002008
 	},
 	{
-		 4, 13, 11,  0,  2, 11, 14,  7, 15,  4,  0,  9,  8,  1, 13, 10,
-		 3, 14, 12,  3,  9,  5,  7, 12,  5,  2, 10, 15,  6,  8,  1,  6,
-		 1,  6,  4, 11, 11, 13, 13,  8, 12,  1,  3,  4,  7, 10, 14,  7,
-		10,  9, 15,  5,  6,  0,  8, 15,  0, 14,  5,  2,  9,  3,  2, 12
+		0x00100000, 0x02100001, 0x02000401, 0x00000000,
+		0x00000400, 0x02000401, 0x00100401, 0x02100400,
+		0x02100401, 0x00100000, 0x00000000, 0x02000001,
+		0x00000001, 0x02000000, 0x02100001, 0x00000401,
+		0x02000400, 0x00100401, 0x00100001, 0x02000400,
+		0x02000001, 0x02100000, 0x02100400, 0x00100001,
+		0x02100000, 0x00000400, 0x00000401, 0x02100401,
+		0x00100400, 0x00000001, 0x02000000, 0x00100400,
+		0x02000000, 0x00100400, 0x00100000, 0x02000401,
+		0x02000401, 0x02100001, 0x02100001, 0x00000001,
+		0x00100001, 0x02000000, 0x02000400, 0x00100000,
+		0x02100400, 0x00000401, 0x00100401, 0x02100400,
+		0x00000401, 0x02000001, 0x02100401, 0x02100000,
+		0x00100400, 0x00000000, 0x00000001, 0x02100401,
+		0x00000000, 0x00100401, 0x02100000, 0x00000400,
+		0x02000001, 0x02000400, 0x00000400, 0x00100001
 	},
 	{
-		13,  1,  2, 15,  8, 13,  4,  8,  6, 10, 15,  3, 11,  7,  1,  4,
-		10, 12,  9,  5,  3,  6, 14, 11,  5,  0,  0, 14, 12,  9,  7,  2,
-		 7,  2, 11,  1,  4, 14,  1,  7,  9,  4, 12, 10, 14,  8,  2, 13,
-		 0, 15,  6, 12, 10,  9, 13,  0, 15,  3,  3,  5,  5,  6,  8, 11
+		0x08000820, 0x00000800, 0x00020000, 0x08020820,
+		0x08000000, 0x08000820, 0x00000020, 0x08000000,
+		0x00020020, 0x08020000, 0x08020820, 0x00020800,
+		0x08020800, 0x00020820, 0x00000800, 0x00000020,
+		0x08020000, 0x08000020, 0x08000800, 0x00000820,
+		0x00020800, 0x00020020, 0x08020020, 0x08020800,
+		0x00000820, 0x00000000, 0x00000000, 0x08020020,
+		0x08000020, 0x08000800, 0x00020820, 0x00020000,
+		0x00020820, 0x00020000, 0x08020800, 0x00000800,
+		0x00000020, 0x08020020, 0x00000800, 0x00020820,
+		0x08000800, 0x00000020, 0x08000020, 0x08020000,
+		0x08020020, 0x08000000, 0x00020000, 0x08000820,
+		0x00000000, 0x08020820, 0x00020020, 0x08000020,
+		0x08020000, 0x08000800, 0x08000820, 0x00000000,
+		0x08020820, 0x00020800, 0x00020800, 0x00000820,
+		0x00000820, 0x00020020, 0x08000000, 0x08020800
 	}
 };
 
@@ -166,12 +229,8 @@ static void permutation(uint64_t *in, uint64_t *out, operation_t op)
 	const int *table;
 
 	switch(op) {
-		case  ip: table = initial_permutation_table; n = 64; break;
-		case   p: table = p_permutation_table;       n = 32; break;
-		case  fp: table = final_permutation_table;   n = 64; break;
-		case exp: table = expansion_table;           n = 48; break;
 		case pc1: table = pc1_permutation_table;     n = 56; break;
-		case pc2: table = pc2_permutation_table;     n = 48; break;
+		default:  table = pc2_permutation_table;     n = 48; break;
 	}
 
 	*out = 0;
@@ -179,65 +238,136 @@ static void permutation(uint64_t *in, uint64_t *out, operation_t op)
 		setbit(in, out, table[i],  i);
 }
 
-static void sbox(uint64_t *in48, uint64_t *out32)
-{
-	int i;
-	uint64_t u64;
-
-	*out32 = 0UL;
-	for (i=0; i<8; i++) {
-		/* assign from uint8_t to uint64_t, expand to 64 bit */
-		u64 = sbox_table[i][*in48 >> (64 - 6 - 6 * i)  & 0x3f];
-		*out32 |= u64 << (64 - 4 - 4 * i);
-	}
-}
-
-static void key_schedule(uint64_t *key64, uint64_t *keyset48)
+/*
+ * the 48-bit subkey k is stored as two words for the rounds, each has
+ * four 6-bit groups at bits 24, 16, 8 and 0: ks[0] the ones of S-boxes
+ * 2, 4, 6, 8 and ks[1] the ones of S-boxes 1, 3, 5, 7
+ */
+static void key_schedule(uint64_t *key64, uint32_t ks[16][2])
 {
 	const int shifts[] = {1, 1, 2, 2, 2, 2, 2, 2, 1, 2, 2, 2, 2, 2, 2, 1};
-	int i;
-	uint64_t key56, bitmask;
+	int i, j;
+	uint64_t key56, k, bitmask;
 
 	permutation(key64, &key56, pc1);
 
 	for (i=0; i<16; i++) {
 		bitmask = shifts[i] == 1 ?  (B0 | B0>>28) : (B0B1 | B0B1>>28);
 		key56 = (key56 & ~bitmask) << shifts[i] | (key56 & bitmask) >> (28 - shifts[i]);
-		permutation(&key56, &keyset48[i], pc2);
+		permutation(&key56, &k, pc2);
+		ks[i][0] = ks[i][1] = 0;
+		for (j=0; j<8; j++)
+			ks[i][!(j & 1)] |= (k >> (58 - 6 * j) & 0x3f) << (24 - 8 * (j / 2));
 	}
 }
 
-static void cipher(uint64_t *keyset48, uint64_t *block, int mode)
+/*
+ * IP and FP as delta swaps on the two halves, l is bits 0-31 of the
+ * block and r bits 32-63, FP undoes IP by the same steps in reverse
+ */
+static inline void des_ip(uint32_t *l, uint32_t *r)
 {
-	int i;
-	uint64_t x, f, l, r;
+	PERM_OP(*l, *r,  4, 0x0f0f0f0f);
+	PERM_OP(*l, *r, 16, 0x0000ffff);
+	PERM_OP(*r, *l,  2, 0x33333333);
+	PERM_OP(*r, *l,  8, 0x00ff00ff);
+	PERM_OP(*l, *r,  1, 0x55555555);
+}
 
-	permutation(block, &x, ip);
+static inline void des_fp(uint32_t *l, uint32_t *r)
+{
+	PERM_OP(*l, *r,  1, 0x55555555);
+	PERM_OP(*r, *l,  8, 0x00ff00ff);
+	PERM_OP(*r, *l,  2, 0x33333333);
+	PERM_OP(*l, *r, 16, 0x0000ffff);
+	PERM_OP(*l, *r,  4, 0x0f0f0f0f);
+}
 
-	l = x & 0xffffffff00000000UL;
-	r = x << 32 & 0xffffffff00000000UL;
+/*
+ * the Feistel function, the expansion is done by rotations:
+ * the 6-bit input of S-box i+1 is r rotated right by 27 - 4 * i,
+ * so ROL32(r, 1) holds the even S-boxes inputs at bits 24, 16, 8, 0
+ * and ROR32(r, 3) the odd ones, they are xored with the subkey words
+ */
+static inline uint32_t feistel(uint32_t r, const uint32_t k[2])
+{
+	uint32_t a = ROL32(r, 1) ^ k[0];
+	uint32_t b = ROR32(r, 3) ^ k[1];
 
-	for (i=0; i<16; i++) {
-		/* the Feistel function */
-		/* x is 48 bits */
-		permutation(&r, &x, exp);
-		/* temp use f as 48 bits */
-		if (mode == DES_DECRYPT)
-			f = x ^ keyset48[15-i];
+	return sp_table[1][a >> 24 & 0x3f] ^ sp_table[3][a >> 16 & 0x3f]
+	     ^ sp_table[5][a >>  8 & 0x3f] ^ sp_table[7][a       & 0x3f]
+	     ^ sp_table[0][b >> 24 & 0x3f] ^ sp_table[2][b >> 16 & 0x3f]
+	     ^ sp_table[4][b >>  8 & 0x3f] ^ sp_table[6][b       & 0x3f];
+}
+
+#define DES_BATCH 2  /* blocks in flight, their rounds are independent */
+
+/*
+ * two rounds per step, so the halves don't swap within a DES stage.
+ * the output of a stage is FP(r, l) and the IP of the next stage
+ * undoes the FP, so for 3DES the halves are only swapped between the
+ * stages and IP/FP are done once for the 48 rounds
+ */
+static inline void des_rounds(const uint32_t (*ks)[2], int nrounds, uint32_t *l, uint32_t *r, int m)
+{
+	int i, j;
+	uint32_t t;
+
+	for (i=0; i<nrounds; i+=2) {
+		for (j=0; j<m; j++) {
+			l[j] ^= feistel(r[j], ks[i]);
+			r[j] ^= feistel(l[j], ks[i+1]);
+		}
+		if (i % 16 == 14)
+			for (j=0; j<m; j++)
+				t = l[j], l[j] = r[j], r[j] = t;
+	}
+}
+
+/*
+ * nrounds is 16 for DES, 48 for 3DES. ks has the round keys in the
+ * order they are used, the decrypt order is set up by the init.
+ * DES_BATCH blocks go through the rounds together to hide the latency
+ * of the table lookups, multi-block callers (CBC decrypt, CTR) gain most
+ */
+static void des_blocks(const uint32_t (*ks)[2], int nrounds, uint8_t *blocks, size_t n)
+{
+	int j, m;
+	uint64_t x;
+	uint32_t l[DES_BATCH], r[DES_BATCH];
+
+	for (; n; n -= m, blocks += 8 * m) {
+		m = n < DES_BATCH ? n : DES_BATCH;
+		for (j=0; j<m; j++) {
+			memcpy(&x, blocks + 8 * j, sizeof(x));
+			swap_u64(&x);
+			l[j] = x >> 32;
+			r[j] = x;
+			des_ip(&l[j], &r[j]);
+		}
+		if (m == DES_BATCH)
+			des_rounds(ks, nrounds, l, r, DES_BATCH);
 		else
-			f = x ^ keyset48[i];
-		/* x is 32 bits after sbox */
-		sbox(&f, &x);
-		permutation(&x, &f, p);
-		/* f is the Feistel function output, 32 bits */
-		x = l;
-		l = r;
-		r = x ^ f;
+			for (j=0; j<m; j++)
+				des_rounds(ks, nrounds, l + j, r + j, 1);
+		for (j=0; j<m; j++) {
+			des_fp(&l[j], &r[j]);
+			x = (uint64_t)l[j] << 32 | r[j];
+			swap_u64(&x);
+			memcpy(blocks + 8 * j, &x, sizeof(x));
+		}
 	}
+}
 
-	x = r | l >> 32;
+/* the decrypt round keys are the encrypt ones backwards */
+static void reverse_keys(uint32_t (*dst)[2], const uint32_t (*src)[2])
+{
+	int i;
 
-	permutation(&x, block, fp);
+	for (i=0; i<16; i++) {
+		dst[i][0] = src[15-i][0];
+		dst[i][1] = src[15-i][1];
+	}
 }
 
 static int key_check(uint64_t *key64)
@@ -271,46 +401,23 @@ static void swap_u64(uint64_t *u64)
 
 static void des_encrypt(des_ctx_t *ctx, uint8_t block[], size_t n)
 {
-	while (n--) {
-		swap_u64((uint64_t *)block);
-		cipher(ctx->keyset48, (uint64_t *)block, DES_ENCRYPT);
-		swap_u64((uint64_t *)block);
-		block += 8;
-	}
+	des_blocks(ctx->ks[DES_ENCRYPT], 16, block, n);
 }
 
 static void des_decrypt(des_ctx_t *ctx, uint8_t block[], size_t n)
 {
-	while (n--) {
-		swap_u64((uint64_t *)block);
-		cipher(ctx->keyset48, (uint64_t *)block, DES_DECRYPT);
-		swap_u64((uint64_t *)block);
-		block += 8;
-	}
+	des_blocks(ctx->ks[DES_DECRYPT], 16, block, n);
 }
 
+/* EDE: the rounds of key 1, key 2 backwards and key 3 in one pass */
 static void tdes_encrypt(tdes_ctx_t *ctx, uint8_t block[], size_t nblocks)
 {
-	while (nblocks--) {
-		swap_u64((uint64_t *)block);
-		cipher(ctx->keyset48[0], (uint64_t *)block, DES_ENCRYPT);
-		cipher(ctx->keyset48[1], (uint64_t *)block, DES_DECRYPT);
-		cipher(ctx->keyset48[2], (uint64_t *)block, DES_ENCRYPT);
-		swap_u64((uint64_t *)block);
-		block += 8;
-	}
+	des_blocks(ctx->ks[DES_ENCRYPT], 48, block, nblocks);
 }
 
 static void tdes_decrypt(tdes_ctx_t *ctx, uint8_t block[], size_t nblocks)
 {
-	while (nblocks--) {
-		swap_u64((uint64_t *)block);
-		cipher(ctx->keyset48[2], (uint64_t *)block, DES_DECRYPT);
-		cipher(ctx->keyset48[1], (uint64_t *)block, DES_ENCRYPT);
-		cipher(ctx->keyset48[0], (uint64_t *)block, DES_DECRYPT);
-		swap_u64((uint64_t *)block);
-		block += 8;
-	}
+	des_blocks(ctx->ks[DES_DECRYPT], 48, block, nblocks);
 }
 
 int  des_init(des_ctx_t *ctx, uint8_t *key)
@@ -326,7 +433,8 @@ int  des_init(des_ctx_t *ctx, uint8_t *key)
 	if (key_check((uint64_t *)key)) return -1;
 	memcpy(ctx->key, key, ctx->keylen/8);
 	swap_u64((uint64_t *)key);
-	key_schedule((uint64_t *)key, ctx->keyset48);
+	key_schedule((uint64_t *)key, ctx->ks[DES_ENCRYPT]);
+	reverse_keys(ctx->ks[DES_DECRYPT], ctx->ks[DES_ENCRYPT]);
 	return 0;
 }
 
@@ -334,6 +442,7 @@ int tdes_init(tdes_ctx_t *ctx, uint8_t *keys, int keylen)
 {
 	int i;
 	uint64_t key64;
+	uint32_t ks[3][16][2];
 	assert(ctx);
 	assert(keys);
 
@@ -368,7 +477,15 @@ int tdes_init(tdes_ctx_t *ctx, uint8_t *keys, int keylen)
 	for (i=0; i<3; i++) {
 		memcpy(&key64, ctx->key[i], sizeof(uint64_t));
 		swap_u64((uint64_t *)&key64);
-		key_schedule(&key64, ctx->keyset48[i]);
+		key_schedule(&key64, ks[i]);
 	}
+	/* encrypt: E(k1), D(k2), E(k3), decrypt: D(k3), E(k2), D(k1) */
+	memcpy(ctx->ks[DES_ENCRYPT], ks[0], sizeof(ks[0]));
+	reverse_keys(ctx->ks[DES_ENCRYPT] + 16, ks[1]);
+	memcpy(ctx->ks[DES_ENCRYPT] + 32, ks[2], sizeof(ks[2]));
+	reverse_keys(ctx->ks[DES_DECRYPT], ks[2]);
+	memcpy(ctx->ks[DES_DECRYPT] + 16, ks[1], sizeof(ks[1]));
+	reverse_keys(ctx->ks[DES_DECRYPT] + 32, ks[0]);
+	memset(ks, 0, sizeof(ks));
 	return 0;
 }
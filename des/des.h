@@ -34,7 +34,7 @@ struct des_ctx {
 	void (*decrypt)(des_ctx_t *ctx, uint8_t *blocks, size_t nblocks);
 	int  keylen, blklen; /* all length in bits */
 	uint8_t key[8];
-	uint64_t keyset48[16];
+	uint32_t ks[2][16][2]; /* round keys in encrypt and decrypt order */
 };
 
 typedef struct tdes_ctx tdes_ctx_t;
@@ -45,7 +45,7 @@ struct tdes_ctx {
 	void (*decrypt)(tdes_ctx_t *ctx, uint8_t *blocks, size_t nblocks);
 	int  keylen, blklen;
 	uint8_t key[3][8];
-	uint64_t keyset48[3][16];
+	uint32_t ks[2][48][2]; /* the 3 keys' rounds in EDE order, and for decrypt */
 };
 
 int  des_init(des_ctx_t *ctx, uint8_t *key);
@@ -27,6 +27,7 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include "des.h"
+#include "cipher-mode.h"
 
 /*
  * usage:
@@ -52,14 +53,122 @@ void print_block(char *msg, uint8_t *blk)
 	printf("\n");
 }
 
+/*
+ * bytes 0..55 as 7 blocks, an odd count so the blocks go through the
+ * rounds in pairs and one alone at the end:
+ * openssl enc -des-ecb -K 133457799bbcdff1 -nopad
+ * openssl enc -des-cbc -K 133457799bbcdff1 -iv f0e1d2c3b4a59687 -nopad
+ */
+#define KAT_BLOCKS 7
+
+static const uint8_t des_ecb_ct[] = {
+	0xde, 0x60, 0x5c, 0xc9, 0xf0, 0x8f, 0x67, 0x6f,
+	0x67, 0xd2, 0x4a, 0xf8, 0xbf, 0xcf, 0xa1, 0xf3,
+	0x75, 0x57, 0x0f, 0x81, 0x06, 0xe3, 0x1d, 0x0e,
+	0xbe, 0x79, 0x25, 0xeb, 0x39, 0x53, 0xf7, 0xec,
+	0x72, 0xd1, 0x89, 0xf9, 0x9c, 0x6e, 0x18, 0x10,
+	0x61, 0x6e, 0x4d, 0xba, 0x1e, 0xe0, 0x95, 0xb2,
+	0x6c, 0xbd, 0x22, 0x85, 0x8b, 0xce, 0xdb, 0x79
+};
+static const uint8_t des_cbc_ct[] = {
+	0xef, 0xe2, 0x7e, 0xe7, 0x6d, 0x75, 0xb6, 0x14,
+	0x05, 0xa1, 0xf6, 0x3d, 0x25, 0x69, 0xcc, 0x6e,
+	0x5f, 0x29, 0x20, 0xbb, 0x1d, 0x2d, 0xb4, 0x48,
+	0xfb, 0x7c, 0xf8, 0x36, 0x8d, 0x0c, 0x78, 0x17,
+	0x09, 0xa8, 0x8c, 0x45, 0x24, 0x6d, 0xd4, 0x3d,
+	0x14, 0xec, 0xa9, 0xa5, 0x87, 0x1b, 0x26, 0x82,
+	0xd0, 0x58, 0xd9, 0xe5, 0x80, 0x30, 0x39, 0xa1
+};
+
+/*
+ * 3DES EDE, 3 keys and 2 keys (key 3 = key 1), the same blocks and iv:
+ * openssl enc -des-ede3 -K 0123456789abcdef23456789abcdef01456789abcdef0123 -nopad
+ * openssl enc -des-ede3-cbc -K <same> -iv f0e1d2c3b4a59687 -nopad
+ * openssl enc -des-ede -K 0123456789abcdef23456789abcdef01 -nopad
+ * openssl enc -des-ede-cbc -K <same> -iv f0e1d2c3b4a59687 -nopad
+ */
+static const uint8_t tdes3_ecb_ct[] = {
+	0x30, 0x32, 0x92, 0x53, 0xbd, 0x29, 0x65, 0x40,
+	0x2e, 0xa4, 0x37, 0xbe, 0x92, 0x66, 0x17, 0x8c,
+	0x39, 0x8c, 0x0e, 0x06, 0xc0, 0x09, 0x6a, 0xe8,
+	0x5d, 0x12, 0x5f, 0x56, 0xb9, 0x41, 0x84, 0xbb,
+	0x17, 0x07, 0xe4, 0xc4, 0x96, 0xcc, 0xf3, 0x30,
+	0x7e, 0xed, 0xae, 0xc2, 0xd8, 0x4d, 0x4d, 0x25,
+	0xf0, 0x4c, 0x6c, 0x80, 0x6a, 0x23, 0xe5, 0x9f
+};
+static const uint8_t tdes3_cbc_ct[] = {
+	0x1d, 0x48, 0x8b, 0xcc, 0x48, 0x9c, 0xe4, 0xc4,
+	0x23, 0x96, 0x45, 0x04, 0x38, 0x65, 0xb7, 0xc3,
+	0xc3, 0xa7, 0x00, 0x42, 0xeb, 0x47, 0xf1, 0x3d,
+	0xa4, 0x38, 0x9f, 0xe0, 0x44, 0x53, 0x54, 0x97,
+	0xcd, 0x63, 0xa3, 0x5f, 0x3b, 0xdf, 0x0e, 0xdc,
+	0x59, 0xe3, 0x51, 0x8c, 0x58, 0xb7, 0x22, 0xde,
+	0x9a, 0xb6, 0x2c, 0x28, 0xc8, 0xfe, 0xc9, 0xe7
+};
+static const uint8_t tdes2_ecb_ct[] = {
+	0x23, 0x61, 0xac, 0xe6, 0xc5, 0x17, 0x10, 0x51,
+	0x45, 0xf0, 0xb4, 0x49, 0xfb, 0x18, 0x5f, 0xfd,
+	0x48, 0x31, 0xba, 0x5d, 0x63, 0x14, 0x3d, 0xf3,
+	0xea, 0xde, 0x34, 0xa2, 0x4b, 0x1d, 0xae, 0x9a,
+	0x66, 0x8a, 0x01, 0xf9, 0xb8, 0x01, 0x79, 0x48,
+	0x0a, 0x9d, 0xbb, 0xad, 0xa6, 0x79, 0xaa, 0x04,
+	0xea, 0x86, 0xdb, 0x9d, 0xec, 0xb7, 0xcf, 0x19
+};
+static const uint8_t tdes2_cbc_ct[] = {
+	0xde, 0x44, 0xb2, 0xdd, 0xc3, 0x67, 0xe0, 0x4b,
+	0x64, 0x4f, 0x80, 0xa3, 0x0f, 0xec, 0xae, 0xe4,
+	0x00, 0x9b, 0x54, 0xb6, 0xae, 0x8c, 0xb1, 0xc4,
+	0x18, 0xef, 0x98, 0x46, 0x6c, 0x92, 0x32, 0x80,
+	0x02, 0xac, 0xb0, 0x2d, 0x5b, 0xcc, 0x5f, 0xc5,
+	0xb9, 0x11, 0x12, 0x64, 0x4f, 0x63, 0x9c, 0xdb,
+	0xfc, 0xae, 0xc6, 0xcc, 0x09, 0x5b, 0x3d, 0x24
+};
+
+static const uint8_t tdes_keys[24] = {
+	0x01, 0x23, 0x45, 0x67, 0x89, 0xab, 0xcd, 0xef,
+	0x23, 0x45, 0x67, 0x89, 0xab, 0xcd, 0xef, 0x01,
+	0x45, 0x67, 0x89, 0xab, 0xcd, 0xef, 0x01, 0x23
+};
+static const uint8_t des_key[8] = {0x13, 0x34, 0x57, 0x79, 0x9b, 0xbc, 0xdf, 0xf1};
+static const uint8_t kat_iv[8] = {0xf0, 0xe1, 0xd2, 0xc3, 0xb4, 0xa5, 0x96, 0x87};
+
+/* ECB on the block cipher itself and CBC through cbc_init(), both ways */
+static int kat_check(blk_ctx_t *blk, const uint8_t *ecb_ct, const uint8_t *cbc_ct)
+{
+	cipher_ctx_t ctx;
+	uint8_t pt[KAT_BLOCKS * 8], buf[KAT_BLOCKS * 8];
+	int i, fail = 0;
+
+	for (i=0; i<sizeof(pt); i++)
+		pt[i] = i;
+
+	memcpy(buf, pt, sizeof(buf));
+	blk->encrypt(blk, buf, KAT_BLOCKS);
+	fail |= memcmp(buf, ecb_ct, sizeof(buf));
+	blk->decrypt(blk, buf, KAT_BLOCKS);
+	fail |= memcmp(buf, pt, sizeof(buf));
+
+	memcpy(buf, pt, sizeof(buf));
+	cbc_init(&ctx, blk, NULL, (uint8_t *)kat_iv);
+	ctx.encrypt(&ctx, buf, sizeof(buf));
+	fail |= memcmp(buf, cbc_ct, sizeof(buf));
+	cbc_init(&ctx, blk, NULL, (uint8_t *)kat_iv);
+	ctx.decrypt(&ctx, buf, sizeof(buf));
+	fail |= memcmp(buf, pt, sizeof(buf));
+	return fail;
+}
+
 int main(int argc, char *argv[])
 {
 	des_ctx_t ctx;
+	tdes_ctx_t tdes;
 	int      n, fd;
 	uint8_t  key64[] = {0x4c, 0x73, 0xab, 0xe6, 0x9b, 0xbc, 0xfe, 0xf1};
 	uint8_t  data64[] = {0xd2, 0xc3, 0x5d, 0x12, 0x87, 0xd4, 0x60, 0xee};
 	uint8_t  cipher64[8] = { 0 };
 	uint8_t  blk64[8];
+	uint8_t  key[8];
+	int      fail;
 
 	memcpy(blk64, data64, 8);
 	/* create a input file */
@@ -99,6 +208,21 @@ int main(int argc, char *argv[])
 	fd = open("des-decrypt.bin", O_WRONLY | O_CREAT, 0644);
 	n = write(fd, blk64, sizeof(uint64_t));
 	close(fd);
-	return 0;
+
+	printf("--------- %d BLOCKS ---------\n", KAT_BLOCKS);
+	memcpy(key, des_key, sizeof(key));  /* des_init() swaps the key in place */
+	des_init(&ctx, key);
+	fail = kat_check((blk_ctx_t *)&ctx, des_ecb_ct, des_cbc_ct);
+	printf("DES ECB/CBC %s\n", fail ? "FAILED" : "SUCCEEDED");
+
+	n = tdes_init(&tdes, (uint8_t *)tdes_keys, 192);
+	n = n || kat_check((blk_ctx_t *)&tdes, tdes3_ecb_ct, tdes3_cbc_ct);
+	printf("3DES 3 keys ECB/CBC %s\n", n ? "FAILED" : "SUCCEEDED");
+	fail |= n;
+	n = tdes_init(&tdes, (uint8_t *)tdes_keys, 128);
+	n = n || kat_check((blk_ctx_t *)&tdes, tdes2_ecb_ct, tdes2_cbc_ct);
+	printf("3DES 2 keys ECB/CBC %s\n", n ? "FAILED" : "SUCCEEDED");
+	fail |= n;
+	return fail ? -1 : 0;
 }
 
@@ -28,11 +28,15 @@ void elg_keygen(elg_prvkey_t *prv)
 	/* http://web.mit.edu/crypto/src/gnupg-1.0.5/cipher/elgamal.c */
 }
 
-void elg_encrypt(uint8_t *msg, elg_pubkey_t *pub, uint8_t *ke, uint8_t *cipher)
+int  elg_encrypt(uint8_t *msg, elg_pubkey_t *pub, uint8_t *ke, uint8_t *cipher)
 {
-	bn_t key, MSG, KE, km, enc;
+	bn_t key, MSG, KE, km, enc, pm1;
 
-	bn_gen_random(MAXBITLEN/2, key);
+	/* ephemeral key in [1, p-2] */
+	bn_cpy(pub->p, pm1);
+	bn_subx(1, pm1);
+	if (bn_rand_range(pm1, key))
+		return -1;
 
 	bn_hex2bn(msg, MSG);
 	bn_expmod(pub->g, key, pub->p, KE);
@@ -40,6 +44,7 @@ void elg_encrypt(uint8_t *msg, elg_pubkey_t *pub, uint8_t *ke, uint8_t *cipher)
 	bn_mulmod(MSG, km, pub->p, enc);
 	bn_bn2hex(KE, ke);
 	bn_bn2hex(enc, cipher);
+	return 0;
 }
 
 void elg_decrypt(uint8_t *ke, uint8_t *cipher, elg_prvkey_t *prv, uint8_t *msg)
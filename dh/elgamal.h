@@ -37,7 +37,7 @@ typedef struct {
 } elg_prvkey_t;
 
 void elg_keygen(elg_prvkey_t *prv);
-void elg_encrypt(uint8_t *msg, elg_pubkey_t *prv, uint8_t *ke, uint8_t *cipher);
+int  elg_encrypt(uint8_t *msg, elg_pubkey_t *prv, uint8_t *ke, uint8_t *cipher);  /* -1 if no random ephemeral key */
 void elg_decrypt(uint8_t *ke, uint8_t *cipher, elg_prvkey_t *prv, uint8_t *msg);
 
 #endif /* __ELGAMAL_H__ */
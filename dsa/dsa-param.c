@@ -75,9 +75,9 @@ int get_dsa_param(uint32_t keylen, dsa_param_t *dsa)
 
 	if (keylen == 2048) {
 		dsa->keylen = keylen;
-		bn_ba2bn(dsap_2048, strlen(dsap_2048), dsa->p);
-		bn_ba2bn(dsaq_2048, strlen(dsaq_2048), dsa->q);
-		bn_ba2bn(dsag_2048, strlen(dsag_2048), dsa->g);
+		bn_ba2bn(dsap_2048, sizeof(dsap_2048), dsa->p);
+		bn_ba2bn(dsaq_2048, sizeof(dsaq_2048), dsa->q);
+		bn_ba2bn(dsag_2048, sizeof(dsag_2048), dsa->g);
 		return 0;
 	}
 	return -1;
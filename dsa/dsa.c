@@ -22,15 +22,12 @@
 #include "dsa.h"
 #include "bn.h"
 #include "random.h"
+#include "rfc6979.h"
 #include "primality.h"
 #include "sha1.h"
 
 extern int get_dsa_param(uint32_t keylen, dsa_param_t *dsa);
 
-#ifdef DSA_TESTVECT
-bn_t test_d;
-bn_t test_k;
-#endif
 /*
  * a^k mod p = 1
  * order = k;
@@ -86,9 +83,9 @@ static void gen_prime(int plen, int qlen, bn_t pout, bn_t qout)
 	printf("prime found");
 }
 
-void dsa_keygen(uint32_t keylen, dsa_key_t *key)
+int  dsa_keygen(uint32_t keylen, dsa_key_t *key)
 {
-	int len, qlen, rc;
+	int qlen, rc;
 	bn_t p, rem, res;
 	dsa_param_t *params;
 
@@ -106,18 +103,15 @@ void dsa_keygen(uint32_t keylen, dsa_key_t *key)
 		bn_subx(1, p);
 		bn_div(p, params->q, res, rem);
 		ord(params->p, params->q, params->g);
-		len = bn_getmsbposn(params->q);
 	}
-	/* generate private key */
-	do {
-		bn_gen_random(len, key->prv);
-	} while (bn_cmp(params->q, key->prv) > 0);
-#ifdef DSA_TESTVECT
-	printf("copy test private key\n");
-	bn_cpy(test_d, key->prv);
-#endif
+	/* generate private key, x in [1, q-1] */
+	if (bn_rand_range(params->q, key->prv)) {
+		bn_clear(key->prv);
+		return -1;
+	}
 	/* generate public key */
 	bn_expmod(params->g, key->prv, params->p, key->pub);
+	return 0;
 }
 
 void dsa_sign(dsa_key_t *key, uint8_t *hash, uint32_t hlen, dsa_sig_t *sign)
@@ -125,17 +119,9 @@ void dsa_sign(dsa_key_t *key, uint8_t *hash, uint32_t hlen, dsa_sig_t *sign)
 	int len, shift;
 	bn_t dr, hdr, invk, dgst, k;
 	dsa_param_t *params;
+	rfc6979_ctx_t nonce;
 
 	params = &key->dsa;
-	do {
-		bn_gen_random(params->keylen/2, k);
-	} while(bn_cmp(params->g, k));
-#ifdef DSA_TESTVECT
-	printf("copy test k\n");
-	bn_cpy(test_k, k);
-#endif
-	bn_expmod(params->g, k, params->p, sign->r);
-	bn_mod(sign->r, params->q, sign->r);
 	bn_ba2bn(hash, hlen, dgst);
 	len = bn_getmsbposn(params->q);
 	shift = hlen*8-len;
@@ -143,10 +129,21 @@ void dsa_sign(dsa_key_t *key, uint8_t *hash, uint32_t hlen, dsa_sig_t *sign)
 		bn_rshift(dgst, shift, dgst);
 	}
 
-	bn_mulmod(key->prv, sign->r, params->q, dr);
-	bn_addmod(dgst, dr, params->q, hdr);
-	bn_invmod(k, params->q, invk);
-	bn_mulmod(invk, hdr, params->q, sign->sig);
+	/* per-message secret, deterministic k in [1, q-1], RFC 6979 */
+	rfc6979_init(&nonce, params->q, key->prv, hash, hlen);
+	do {
+		nonce.generate(&nonce, k);
+		bn_expmod(params->g, k, params->p, sign->r);
+		bn_mod(sign->r, params->q, sign->r);
+
+		bn_mulmod(key->prv, sign->r, params->q, dr);
+		bn_addmod(dgst, dr, params->q, hdr);
+		bn_invmod(k, params->q, invk);
+		bn_mulmod(invk, hdr, params->q, sign->sig);
+	} while (bn_iszero(sign->r) || bn_iszero(sign->sig));
+	bn_clear(k);
+	bn_clear(invk);
+	memset(&nonce, 0, sizeof(nonce));
 }
 
 bool dsa_verify (dsa_key_t *key, uint8_t * hash, uint32_t hlen, dsa_sig_t *sign)
@@ -43,7 +43,8 @@ typedef struct {
 	bn_t r;	  /* (g^Ke mod p)mod q */
 } dsa_sig_t;
 
-void dsa_keygen(uint32_t keylen, dsa_key_t *key);
+/* 0, -1 if no random private key could be drawn */
+int  dsa_keygen(uint32_t keylen, dsa_key_t *key);
 void dsa_sign(dsa_key_t *key, uint8_t *hash, uint32_t hlen, dsa_sig_t *sign);
 bool dsa_verify(dsa_key_t *key, uint8_t *hash, uint32_t hlen, dsa_sig_t *sign);
 
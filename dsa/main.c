@@ -27,13 +27,48 @@
 #include "sha-common.h"
 #include "sha1.h"
 
-#ifdef DSA_TESTVECT
-extern bn_t test_d;
-extern bn_t test_k;
-#else
-bn_t test_d;
-bn_t test_k;
-#endif
+/*
+ * a generated key: 0 < x < q, y = g^x mod p and y has order q.
+ * only L=2048 has built-in parameters, other sizes search for primes
+ */
+static int keygen_test(void)
+{
+	dsa_key_t key;
+	dsa_sig_t signature;
+	sha_ctx_t ctx;
+	bn_t t;
+	uint8_t digest[SHA_DIGEST_LENGTH / 8];
+
+	if (dsa_keygen(2048, &key)) {
+		printf("Keygen FAILED - no random private key\n");
+		return -1;
+	}
+	if (bn_iszero(key.prv) || bn_cmp(key.prv, key.dsa.q) >= 0) {
+		printf("Keygen FAILED - private key out of range\n");
+		return -1;
+	}
+	bn_expmod(key.dsa.g, key.prv, key.dsa.p, t);
+	if (bn_cmp(t, key.pub)) {
+		printf("Keygen FAILED - public key mismatch\n");
+		return -1;
+	}
+	bn_expmod(key.pub, key.dsa.q, key.dsa.p, t);
+	if (!bn_isone(t)) {
+		printf("Keygen FAILED - public key is not in the subgroup\n");
+		return -1;
+	}
+
+	hash_init(eHASH_SHA256, &ctx);
+	ctx.update(&ctx, (uint8_t *)"abc", 3);
+	ctx.final(&ctx, digest);
+	dsa_sign(&key, digest, ctx.md_len / 8, &signature);
+	if (!dsa_verify(&key, digest, ctx.md_len / 8, &signature)) {
+		printf("Keygen FAILED - signature with the new key doesn't verify\n");
+		return -1;
+	}
+	printf("Keygen PASSED\n");
+	return 0;
+}
 
 int main(int argc, char *argv[])
 {
@@ -44,8 +79,8 @@ int main(int argc, char *argv[])
 		"downloads/186-2dsatestvectors/SigGen.txt",
 	};
 	dsa_key_t key;
-	dsa_sig_t signature;
-	bn_t keycmp, r, s;
+	dsa_sig_t signature, sigcmp;
+	bn_t keycmp;
 
 	uint8_t buf[1024];
 	uint32_t plen;
@@ -56,6 +91,9 @@ int main(int argc, char *argv[])
 	enum hash_id hash_id;
 	uint8_t digest[SHA_DIGEST_LENGTH / 8];
 
+	if (keygen_test())
+		return -1;
+
 	line = 0;
 	memset(&buf, 0, sizeof(buf));
 	for (i = 0; i < ARRAY_SIZE(filename); i++) {
@@ -93,18 +131,18 @@ int main(int argc, char *argv[])
 				if(strstr(buf, "G = "))  bn_hex2bn(buf+4, key.dsa.g);
 
 				if (strstr(buf, "Msg = "))    {value |= 0x02; mlen = hex2ba(buf + 6, msg, sizeof(msg));}
-				else if (strstr(buf, "X = ")) {	value |= 0x04; bn_hex2bn(buf+4, test_d);}
+				else if (strstr(buf, "X = ")) {	value |= 0x04; bn_hex2bn(buf+4, key.prv);}
 				else if (strstr(buf, "Y = ")) {	value |= 0x08; bn_hex2bn(buf+4, keycmp);}
-				else if (strstr(buf, "K = ")) {	value |= 0x10; bn_hex2bn(buf+4, test_k);}
-				else if (strstr(buf, "R = ")) {	value |= 0x20; bn_hex2bn(buf + 4, r);}
-				else if (strstr(buf, "S = ")) {	value |= 0x40; bn_hex2bn(buf + 4, s);}
-				else if (strlen(buf) <= 2 && value == 0x7E) break; /* \r\n */
+				else if (strstr(buf, "R = ")) {	value |= 0x20; bn_hex2bn(buf + 4, sigcmp.r);}
+				else if (strstr(buf, "S = ")) {	value |= 0x40; bn_hex2bn(buf + 4, sigcmp.sig);}
+				else if (strlen(buf) <= 2 && value == 0x6E) break; /* \r\n */
 			}
-			if (value != 0x7E) break; /* end of file */
+			if (value != 0x6E) break; /* end of file */
 
-			dsa_keygen(plen, &key);
+			/* public key */
+			bn_expmod(key.dsa.g, key.prv, key.dsa.p, key.pub);
 			if (bn_cmp(key.pub, keycmp)) {
-				printf("Keygen FAILED- Line: %d\n", line);
+				printf("Public key FAILED- Line: %d\n", line);
 				return -1;
 			}
 
@@ -113,14 +151,17 @@ int main(int argc, char *argv[])
 			ctx.update(&ctx, msg, mlen);
 			ctx.final(&ctx, digest);
 
-			/*signature gen*/
-			dsa_sign(&key, digest, ctx.md_len / 8, &signature);
-			if (bn_cmp(signature.sig, s)) {
-				printf("Signature - S - creation FAILED - Line: %d\n", line);
+			/* the vector's K isn't used, dsa_sign() takes K from RFC 6979 */
+			if (!dsa_verify(&key, digest, ctx.md_len / 8, &sigcmp)) {
+				printf("Test vector Signature Verify FAILED - Line: %d\n", line);
 				return -1;
 			}
-			if (bn_cmp(signature.r, r)) {
-				printf("Signature - R - creation FAILED - Line: %d\n", line);
+
+			/*signature gen*/
+			dsa_sign(&key, digest, ctx.md_len / 8, &signature);
+			dsa_sign(&key, digest, ctx.md_len / 8, &sigcmp);
+			if (bn_cmp(signature.r, sigcmp.r) || bn_cmp(signature.sig, sigcmp.sig)) {
+				printf("Signature is not deterministic - Line: %d\n", line);
 				return -1;
 			}
 
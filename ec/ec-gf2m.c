@@ -20,6 +20,7 @@
 #include <assert.h>
 #include <stdio.h>
 #include "random.h"
+#include "rfc6979.h"
 #include "gf2m.h"
 #include "ec-gf2m.h"
 #include "ec-param.h"
@@ -30,7 +31,10 @@ int ec_keygen_gf2m(char *name, ec_keyblob_t * keys)
 	int res;
 	res = ec_getcurve(name, &keys->ec);
 	if (res > 0) {
-		bn_gen_random(keys->ec.keylen, keys->private);
+		if (bn_rand_range(keys->ec.order, keys->private)) {
+			bn_clear(keys->private);
+			return -1;
+		}
 		gf2m_mulmod(&keys->ec.g, keys->private, &keys->ec, &keys->public);
 	}
 	return res;
@@ -64,14 +68,12 @@ void ecdh_gf2m(ec_keyblob_t *mykey, gfp_point_t *peer_pub, gfp_point_t *my_secre
  * https://nvlpubs.nist.gov/nistpubs/FIPS/NIST.FIPS.186-5-draft.pdf
  *
  */
-#ifdef EC_TESTVECT
-	bn_t ectest_k;
-#endif
 void ecdsa_sign_gf2m(ec_keyblob_t *key, uint8_t *hash, uint32_t hlen, gfp_point_t *signature)
 {
 	gfp_point_t pnt;
 	bn_t k, invk, z, rd, dgst;
 	int rlen, shift;
+	rfc6979_ctx_t nonce;
 
 	bn_ba2bn(hash, hlen, dgst);
 
@@ -82,13 +84,10 @@ void ecdsa_sign_gf2m(ec_keyblob_t *key, uint8_t *hash, uint32_t hlen, gfp_point_
 		bn_rshift(dgst, shift, dgst);
 	}
 
+	/* deterministic k, RFC 6979 */
+	rfc6979_init(&nonce, key->ec.order, key->private, hash, hlen);
 	do {
-		bn_gen_random(rlen, k);
-#ifdef EC_TESTVECT
-		printf("copy test k\n");
-		bn_cpy(ectest_k, k);
-#endif
-		bn_mod(k, key->ec.order, k);
+		nonce.generate(&nonce, k);
 		gf2m_mulmod(&key->ec.g, k, &key->ec, &pnt);
 		bn_mod(pnt.x, key->ec.order, pnt.x);
 
@@ -99,7 +98,8 @@ void ecdsa_sign_gf2m(ec_keyblob_t *key, uint8_t *hash, uint32_t hlen, gfp_point_
 		bn_mulmod(invk, z, key->ec.order, signature->y);
 		bn_clear(invk);
 		bn_cpy(pnt.x, signature->x);
-	} while(bn_iszero(signature->x) || bn_iszero(signature->y)); 
+	} while(bn_iszero(signature->x) || bn_iszero(signature->y));
+	memset(&nonce, 0, sizeof(nonce));
 }
 
 /* RFC6090 5.4.3 Signature Verification */
@@ -26,7 +26,7 @@
 #include "ec-gfp.h"
 
 
-/* generate private/public key pair from the specific curve */
+/* generate private/public key pair from the specific curve, <= 0 on failure */
 int  ec_keygen_gf2m(char *name, ec_keyblob_t * keys);
 /* calculate the secret from my prvkey and peer's public key */
 void ecdh_gf2m(ec_keyblob_t *mykey, gfp_point_t *peer_pub, gfp_point_t *my_secret);
@@ -19,6 +19,7 @@
 
 #include <stdio.h>
 #include "random.h"
+#include "rfc6979.h"
 #include "gfp.h"
 #include "ec-gfp.h"
 #include "ec-param.h"
@@ -30,7 +31,10 @@ int ec_keygen_gfp(char *name, ec_keyblob_t * keys)
 	int len;
 	len = ec_getcurve(name, &keys->ec);
 	if (len > 0) {
-		bn_gen_random(keys->ec.keylen, keys->private);
+		if (bn_rand_range(keys->ec.order, keys->private)) {
+			bn_clear(keys->private);
+			return -1;
+		}
 		gfp_mulmod(&keys->ec.g, keys->private, &keys->ec, &keys->public);
 	}
 	return len;
@@ -42,15 +46,13 @@ void ecdh_gfp(ec_keyblob_t *mykey, gfp_point_t *peer_pub, gfp_point_t *my_secret
 	gfp_mulmod(peer_pub, mykey->private, &mykey->ec, my_secret);
 }
 
-#ifdef EC_TESTVECT
-	bn_t ectest_k;
-#endif
 /* RFC6090 5.4.2  KT-I Signature Creation */
 void ecdsa_sign_gfp(ec_keyblob_t *key, uint8_t *hash, uint32_t hlen, gfp_point_t *signature)
 {
 	gfp_point_t pnt;
 	bn_t k, invk, z, rd, dgst;
 	int rlen, shift;
+	rfc6979_ctx_t nonce;
 
 	bn_ba2bn(hash, hlen, dgst);
 
@@ -61,12 +63,10 @@ void ecdsa_sign_gfp(ec_keyblob_t *key, uint8_t *hash, uint32_t hlen, gfp_point_t
 		bn_rshift(dgst, shift, dgst);
 	}
 
+	/* deterministic k, RFC 6979 */
+	rfc6979_init(&nonce, key->ec.order, key->private, hash, hlen);
 	do {
-		bn_gen_random(key->ec.keylen, k);
-#ifdef EC_TESTVECT
-		bn_cpy(ectest_k, k);
-#endif
-		bn_mod(k, key->ec.order, k);
+		nonce.generate(&nonce, k);
 		gfp_mulmod(&key->ec.g, k, &key->ec, &pnt);
 		bn_mod(pnt.x, key->ec.order, pnt.x);
 		bn_invmod(k, key->ec.order, invk);
@@ -77,6 +77,7 @@ void ecdsa_sign_gfp(ec_keyblob_t *key, uint8_t *hash, uint32_t hlen, gfp_point_t
 		bn_clear(invk);
 		bn_cpy(pnt.x, signature->x);
 	} while (bn_iszero(signature->x) || bn_iszero(signature->y));
+	memset(&nonce, 0, sizeof(nonce));
 }
 
 /* RFC6090 5.4.3 Signature Verification */
@@ -30,7 +30,7 @@ typedef struct ec_keyblob {
     gfp_curve_t  ec;
 } ec_keyblob_t;
 
-/* generate private/public key pair from the specific curve */
+/* generate private/public key pair from the specific curve, <= 0 on failure */
 int  ec_keygen_gfp(char *name, ec_keyblob_t * keys);
 /* calculate the secret from my prvkey and peer's public key */
 void ecdh_gfp(ec_keyblob_t *mykey, gfp_point_t *peer_pub, gfp_point_t *my_secret);
@@ -25,12 +25,6 @@
 #include "ec-gf2m.h"
 #include "sha-common.h"
 
-#ifdef EC_TESTVECT
-extern bn_t ectest_k;
-#else
-bn_t ectest_k; /* only allow linking. this prog won't run correctly if EC_TESTVECT not defined */
-#endif
-
 int main(int argc, char *argv[])
 {
 	bool ok;
@@ -47,7 +41,6 @@ int main(int argc, char *argv[])
 	uint8_t d[]   = "01df252a11ff97b4421b3a2361db94e908e8243cd50d9179f9e03e331f1";
 	uint8_t Qx[]  = "129f011fd5fedf3526f0437ae800a110435db907af60e16912d58523202";
 	uint8_t Qy[]  = "08026ed86afa7ec80277f322dfc8cf693089968ed9ceb8c95c930415a23";
-	uint8_t k[]   = "04fce14bc83be6f862f06680a32e9a51d1a569fdf1d9b10a89eb9fef4bf";
 	uint8_t R[]   = "04d7b8d19dd9cabc3c2245a9d2c8431c3151eeb6f49676a865e78c26c2f";
 	uint8_t S[]   = "0373e69da1fe35ce41ff344447fa7ffe6fc71e28dc68244372745739fc2";
 	char curve[]  = "sect233k1";
@@ -58,7 +51,6 @@ int main(int argc, char *argv[])
 	uint8_t d[]   = "101c5ed48231a56ca0ea85eb45de0e395e6df2efd4987a226ae36489dd8b2dfbf7c465c";
 	uint8_t Qx[]  = "7011260f504d809baefb54af48c890f94fa5984c8bf228baa4b6ea14d46372390d1a8ac";
 	uint8_t Qy[]  = "2bbfabb680659aa2611435c4058ed773467a41cdda8250f3490e4f491f1bbae452c5c36";
-	uint8_t k[]   = "12a3c7f0b3d64614ff97133873d75c7c1406e316e8cf60d22139dba462055baffe6c8f5";
 	uint8_t R[]   = "0a9933496d60716a39e1c3f3bf22a7da546eafebef80dc6f25d0c109ecbc430fdb3e80a";
 	uint8_t S[]   = "0be56197a0098b022a7914c10f40207da58403d6c7d04edaf7efc96de740cd71f67e0de";
 	char curve[]  = "sect283k1";
@@ -69,7 +61,6 @@ int main(int argc, char *argv[])
 	uint8_t d[]   = "19cf4f4d06825499949f9e0b442586fe1bfe3459813a2b92cd8de0f775a4735e02655702ead8e60824180761808d9e816d60bdb0238e1e8039ca7bb63c92e1cf8433ef447e64ead";
 	uint8_t Qx[]  = "07b9cb1728cba80367b62872a986e4fc7f90f269453634d9946f79b1fedf42ca67af93e97ee0601bb3166e85357e8b044e39dcc19e608eaaa8a0066ffc48aa480c0e1e8d5569cbf";
 	uint8_t Qy[]  = "580858ab9223c2b2ea58df506d703d64b387a78ef43846894e7a2e47c02252bd2c1e3d21ada7c21d50a08cef0f9a189c4e850c058cc57c37918251b5aaaff2321d7355b6b555644";
-	uint8_t k[]   = "0726d5e317f888dddc94c73acb14b320ff509908052868f8c6b14e531ca467c1f7c8287476674efd0d636ca94c24a69d15210bb43a368a11d3453d69ca80430cbfb8b6e45d8f21a";
 	uint8_t R[]   = "04ec6205bdd8f7eab414110ed620dd3fbbda4cb3ad9e5559a114ca9344782847621961a3577cbbe43d94eff6ffc8dd7dd09c049239f026a928301ffcddcc910bf196853edc86d31";
 	uint8_t S[]   = "16535b1af98a75b9bc0f122ca3ce23a01800fa33b43584a94fd8a8d6f40077eb739f07c9f0e179a157a28023735fc8da2e2ebbee5f7308925900e657fae7c3b321f14fc45346f89";
 	char curve[]  = "sect571k1";
@@ -77,15 +68,10 @@ int main(int argc, char *argv[])
 #endif
 	uint8_t msg[1024];
 	int mlen;
-	gfp_point_t sign;
-
-#ifndef EC_TESTVECT
-	printf("This test requires compile as: make clean all CPPFLAGS=\"-DMAXBITLEN=571 -DEC_TESTVECT\"\n");
-	return -1;
-#endif
+	gfp_point_t sign, sign2;
 
 	if (MAXBITLEN < 571) {
-		printf("compile this test program with: make clean all CPPFLAGS=\"-DMAXBITLEN=571 -DEC_TESTCECT\"\n");
+		printf("compile this test program with: make clean all CPPFLAGS=\"-DMAXBITLEN=571\"\n");
 		return -1;
 	}
 	printf("%s\n", test);
@@ -114,7 +100,6 @@ int main(int argc, char *argv[])
 	bn_hex2bn(d, alice.private);
 	bn_hex2bn(Qx, alice.public.x);
 	bn_hex2bn(Qy, alice.public.y);
-	bn_hex2bn(k, ectest_k);
 	bn_hex2bn(R, sign.x);
 	bn_hex2bn(S, sign.y);
 
@@ -122,22 +107,22 @@ int main(int argc, char *argv[])
 	hash_init(hash_id, &sha);
 	sha.update(&sha, msg, mlen);
 	sha.final(&sha, hash);
+	/* R, S were made with the vector's own k, they can only be verified */
+	ok = ecdsa_verify_gf2m(&bob, &alice.public, hash, sha.md_len/8, &sign);
+	printf("ECDSA verify test vector: %s\n", ok ? "SUCCEED" : "FAILED");
+	if (!ok) return -1;
+
 	ecdsa_sign_gf2m(&alice, hash, sha.md_len/8, &signature);
 	gfp_print("alice's signature:", &signature);
-	if (!bn_cmp(sign.x, signature.x)) printf("sing.x is equal\n");
-	else {
-		bn_print("x=", sign.x);
-		bn_print("X=", signature.x);
-	}
-	if (!bn_cmp(sign.y, signature.y)) printf("sing.y is equal\n");
+	ecdsa_sign_gf2m(&alice, hash, sha.md_len/8, &sign2);
+	if (gfp_isequal(&sign2, &signature)) printf("ECDSA sign SUCCEEDED\n");
 	else {
-		bn_print("y=", sign.y);
-		bn_print("Y=", signature.y);
+		printf("ECDSA sign FAILED, signature is not deterministic\n");
+		return -1;
 	}
-	if (gfp_isequal(&sign, &signature)) printf("ECDSA sign SUCCEEDED\n");
-	else printf("ECDSA sign FAILED\n");
 	ok = ecdsa_verify_gf2m(&bob, &alice.public, hash, sha.md_len/8, &signature);
 	printf("ECDSA verify: sign.x %s verify.x : verify %s\n", ok ? "==" : "!=", ok ? "SUCCEED" : "FAILED");
+	if (!ok) return -1;
 
 	return 0;
 }
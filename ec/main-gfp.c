@@ -25,12 +25,6 @@
 #include "ec-pem.h"
 #include "sha-common.h"
 
-#ifdef EC_TESTVECT
-extern bn_t ectest_k;
-#else
-bn_t ectest_k; /* only allow linking. this prog won't run correctly if EC_TESTVECT not defined */
-#endif
-
 int main(int argc, char *argv[])
 {
 	int res = 0;
@@ -86,11 +80,11 @@ int main(int argc, char *argv[])
 	}
 	if (!ok) return -1;
 
-#ifdef EC_TESTVECT
 	printf("\nRFC4754 Test Case\n");
 	if (MAXBITLEN < 256) {
 		printf("You have to use this command to compile test code:\n");
-		printf("    make clean all CPPFLAGS=\"-DMAXBITLEN=256 -DEC_TESTVECT\"\n");
+		printf("    make clean all CPPFLAGS=\"-DMAXBITLEN=256\"\n");
+		return -1;
 	}
 	res |= ec_keygen_gfp("prime256v1", &alice);
 	res |= ec_keygen_gfp("prime256v1", &bob);
@@ -106,18 +100,8 @@ int main(int argc, char *argv[])
 	/* hash of "abc" from RFC4754 */
 	int hlen = hex2ba("0xBA7816BF8F01CFEA414140DE5DAE2223B00361A396177A9CB410FF61F20015AD", hash, sizeof(hash));
 	printf("hash length=%d\n", hlen);
-	bn_hex2bn("0x9E56F509196784D963D1C0A401510EE7ADA3DCC5DEE04B154BF61AF1D5A6DECE", ectest_k);
-
-	ecdsa_sign_gfp(&alice, hash, hlen, &signature);
-	gfp_print("signature:", &signature);
-	bn_t r, s;
-	bn_hex2bn("0xCB28E0999B9C7715FD0A80D8E47A77079716CBBF917DD72E97566EA1C066957C", r);
-	bn_hex2bn("0x86FA3BB4E26CAD5BF90B7F81899256CE7594BB1EA0C89212748BFF3B3D5B0315", s);
-	bn_print("R=", r);
-	bn_print("S=", s);
-	assert(!bn_cmp(r, signature.x));
-	assert(!bn_cmp(s, signature.y));
 
+	/* the RFC4754 signature uses a random k, only verify it */
 	gfp_point_t verify;
 	bn_hex2bn("0xCB28E0999B9C7715FD0A80D8E47A77079716CBBF917DD72E97566EA1C066957C", verify.x);
 	bn_hex2bn("0x86FA3BB4E26CAD5BF90B7F81899256CE7594BB1EA0C89212748BFF3B3D5B0315", verify.y);
@@ -129,17 +113,54 @@ int main(int argc, char *argv[])
 	printf("ecdsa verify: %s\n", ok ? "SUCCEED, It should FAIL!!!" : "FAILED, It should FAIL!!!");
 
 	if (ok) return -2;
-#endif
 
+	/* RFC6979 A.2.5 ECDSA, 256 Bits (Prime Field), deterministic k */
+	printf("\nRFC6979 Test Case\n");
+	struct {
+		char *msg;
+		char *r;
+		char *s;
+	} rfc6979[] = {
+		{"sample",
+		 "0xEFD48B2AACB6A8FD1140DD9CD45E81D69D2C877B56AAF991C34D0EA84EAF3716",
+		 "0xF7CB1C942D657C41D436C7A1B6E29F65F3E900DBB9AFF4064DC4AB2F843ACDA8"},
+		{"test",
+		 "0xF1ABB023518351CD71D881567B1EA663ED3EFCF6C5132B354F28D3B0B7D38367",
+		 "0x019F4113742A2B14BD25926B49C649155F267E60D3814B4C0CC84250E46F0083"},
+	};
+	sha_ctx_t sha256;
+	bn_t r, s;
+	int i;
+
+	bn_hex2bn("0xC9AFA9D845BA75166B5C215767B1D6934E50C3DB36E89B127B8A622B120F6721", alice.private);
+	gfp_mulmod(&alice.ec.g, alice.private, &alice.ec, &alice.public);
+	bn_hex2bn("0x60FED4BA255A9D31C961EB74C6356D68C049B8923B61FA6CE669622E60F29FB6", gwx);
+	bn_hex2bn("0x7903FE1008B8BC99A41AE9E95628BC64F2F1B20C2D7E9F5177A3C294D4462299", gwy);
+	assert(!bn_cmp(gwx, alice.public.x));
+	assert(!bn_cmp(gwy, alice.public.y));
+	for (i=0; i<ARRAY_SIZE(rfc6979); i++) {
+		hash_init(eHASH_SHA256, &sha256);
+		sha256.update(&sha256, (uint8_t *)rfc6979[i].msg, strlen(rfc6979[i].msg));
+		sha256.final(&sha256, hash);
+		ecdsa_sign_gfp(&alice, hash, sha256.md_len/8, &signature);
+		gfp_print("signature:", &signature);
+		bn_hex2bn(rfc6979[i].r, r);
+		bn_hex2bn(rfc6979[i].s, s);
+		if (bn_cmp(r, signature.x) || bn_cmp(s, signature.y)) {
+			printf("RFC6979 \"%s\" signature FAILED\n", rfc6979[i].msg);
+			return -2;
+		}
+		ok = ecdsa_verify_gfp(&bob, &alice.public, hash, sha256.md_len/8, &signature);
+		printf("RFC6979 \"%s\" ecdsa verify: %s\n", rfc6979[i].msg, ok ? "SUCCEED" : "FAILED");
+		if (!ok) return -2;
+	}
 
-#ifdef EC_TESTVECT
 #if 0
 	uint8_t test[] = "[P-256]";
 	uint8_t Msg[] = "5ff1fa17c2a67ce599a34688f6fb2d4a8af17532d15fa1868a598a8e6a0daf9b11edcc483d11ae003ed645c0aaccfb1e51cf448b737376d531a6dcf0429005f5e7be626b218011c6218ff32d00f30480b024ec9a3370d1d30a9c70c9f1ce6c61c9abe508d6bc4d3f2a167756613af1778f3a94e7771d5989fe856fa4df8f8ae5";
 	uint8_t d[]   = "002a10b1b5b9fa0b78d38ed29cd9cec18520e0fe93023e3550bb7163ab4905c6";
 	uint8_t Qx[]  = "e9cd2e8f15bd90cb0707e05ed3b601aace7ef57142a64661ea1dd7199ebba9ac";
 	uint8_t Qy[]  = "c96b0115bed1c134b68f89584b040a194bfad94a404fdb37adad107d5a0b4c5e";
-	uint8_t k[]   = "00c2815763d7fcb2480b39d154abc03f616f0404e11272d624e825432687092a";
 	uint8_t R[]   = "15bf46937c7a1e2fa7adc65c89fe03ae602dd7dfa6722cdafa92d624b32b156e";
 	uint8_t S[]   = "59c591792ee94f0b202e7a590e70d01dd8a9774884e2b5ba9945437cfed01686";
 	char curve[]  = "prime256v1";
@@ -151,7 +172,6 @@ int main(int argc, char *argv[])
 	uint8_t d[]   = "b6faf2c8922235c589c27368a3b3e6e2f42eb6073bf9507f19eed0746c79dced";
 	uint8_t Qx[]  = "e0e7b99bc62d8dd67883e39ed9fa0657789c5ff556cc1fd8dd1e2a55e9e3f243";
 	uint8_t Qy[]  = "63fbfd0232b95578075c903a4dbf85ad58f8350516e1ec89b0ee1f5e1362da69";
-	uint8_t k[]   = "9980b9cdfcef3ab8e219b9827ed6afdd4dbf20bd927e9cd01f15762703487007";
 	uint8_t R[]   = "f5087878e212b703578f5c66f434883f3ef414dc23e2e8d8ab6a8d159ed5ad83";
 	uint8_t S[]   = "306b4c6c20213707982dffbb30fba99b96e792163dd59dbe606e734328dd7c8a";
 	char curve[]  = "prime256v1";
@@ -162,7 +182,6 @@ int main(int argc, char *argv[])
 	uint8_t d[]   = "1d7bb864c5b5ecae019296cf9b5c63a166f5f1113942819b1933d889a96d12245777a99428f93de4fc9a18d709bf91889d7f8dddd522b4c364aeae13c983e9fae46";
 	uint8_t Qx[]  = "1a7596d38aac7868327ddc1ef5e8178cf052b7ebc512828e8a45955d85bef49494d15278198bbcc5454358c12a2af9a3874e7002e1a2f02fcb36ff3e3b4bc0c69e7";
 	uint8_t Qy[]  = "184902e515982bb225b8c84f245e61b327c08e94d41c07d0b4101a963e02fe52f6a9f33e8b1de2394e0cb74c40790b4e489b5500e6804cabed0fe8c192443d4027b";
-	uint8_t k[]   = "141f679033b27ec29219afd8aa123d5e535c227badbe2c86ff6eafa5116e9778000f538579a80ca4739b1675b8ff8b6245347852aa524fe9aad781f9b672e0bb3ff";
 	uint8_t R[]   = "06b973a638bde22d8c1c0d804d94e40538526093705f92c0c4dac2c72e7db013a9c89ffc5b12a396886305ddf0cbaa7f10cdd4cd8866334c8abfc800e5cca365391";
 	uint8_t S[]   = "0b0a01eca07a3964dd27d9ba6f3750615ea36434979dc73e153cd8ed1dbcde2885ead5757ebcabba117a64fcff9b5085d848f107f0c9ecc83dfa2fa09ada3503028";
 	char curve[]  = "secp521r1";
@@ -175,7 +194,7 @@ int main(int argc, char *argv[])
 
 	if (MAXBITLEN < 571) {
 		printf("You have to use this command to compile test code:\n");
-		printf("    make clean all CPPFLAGS=\"-DMAXBITLEN=571 -DEC_TESTVECT\"\n");
+		printf("    make clean all CPPFLAGS=\"-DMAXBITLEN=571\"\n");
 		return -1;
 	}
 
@@ -188,7 +207,6 @@ int main(int argc, char *argv[])
 	bn_hex2bn(d, alice.private);
 	bn_hex2bn(Qx, alice.public.x);
 	bn_hex2bn(Qy, alice.public.y);
-	bn_hex2bn(k, ectest_k);
 	bn_hex2bn(R, sign.x);
 	bn_hex2bn(S, sign.y);
 
@@ -196,26 +214,17 @@ int main(int argc, char *argv[])
 	sha.update(&sha, msg, mlen);
 	sha.final(&sha, hash);
 
+	/* the test vector signature uses a random k, only verify it */
+	ok = ecdsa_verify_gfp(&bob, &alice.public, hash, sha.md_len/8, &sign);
+	printf("ECDSA verify test vector: %s\n", ok ? "SUCCEED" : "FAILED");
+	if (!ok) return -3;
+
 	ecdsa_sign_gfp(&alice, hash, sha.md_len/8, &signature);
 	gfp_print("alice's signature:", &signature);
-	if (!bn_cmp(sign.x, signature.x)) printf("sing.x is equal\n");
-	else {
-		bn_print("x=", sign.x);
-		bn_print("X=", signature.x);
-	}
-	if (!bn_cmp(sign.y, signature.y)) printf("sing.y is equal\n");
-	else {
-		bn_print("y=", sign.y);
-		bn_print("Y=", signature.y);
-	}
-	if (gfp_isequal(&sign, &signature)) printf("ECDSA sign SUCCEEDED\n");
-	else printf("ECDSA sign FAILED\n");
 	ok = ecdsa_verify_gfp(&bob, &alice.public, hash, sha.md_len/8, &signature);
 	printf("ECDSA verify: sign.x %s verify.x : verify %s\n", ok ? "==" : "!=", ok ? "SUCCEED" : "FAILED");
 
 	if (!ok) return -3;
-#endif
 
 	return 0;
 }
-
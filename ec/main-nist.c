@@ -59,12 +59,6 @@ int get_curvename(char *key_id, char *name)
 	return rc;
 }
 
-#ifdef EC_TESTVECT
-extern bn_t ectest_k;
-#else
-bn_t ectest_k;
-#endif
-
 int main(int argc, char *argv[])
 {
 	FILE *fp;
@@ -73,7 +67,7 @@ int main(int argc, char *argv[])
 	int line, value, i, mlen;
 	char name[64];
 	ec_keyblob_t keya, keyb;
-	gfp_point_t signcmp,sign;
+	gfp_point_t signcmp, sign, sign2;
 	uint8_t buf[1024], msg[256], digest[SHA_DIGEST_LENGTH / 8];
 	sha_ctx_t ctx;
 	enum hash_id hash_id;
@@ -131,12 +125,12 @@ int main(int argc, char *argv[])
 				else if (strstr(buf, "d = ")) {  value |= 0x04; bn_hex2bn(buf + 4, keya.private);}
 				else if (strstr(buf, "Qx = ")) { value |= 0x08; bn_hex2bn(buf + 5, keya.public.x);}
 				else if (strstr(buf, "Qy = ")) { value |= 0x10; bn_hex2bn(buf + 5, keya.public.y);}
-				else if (strstr(buf, "k = ")) {  value |= 0x20; bn_hex2bn(buf + 4, ectest_k);}
+				/* "k = " is skipped, ecdsa_sign() derives k by RFC 6979 */
 				else if (strstr(buf, "R = ")) {  value |= 0x40; bn_hex2bn(buf + 4, signcmp.x);}
 				else if (strstr(buf, "S = ")) {  value |= 0x80; bn_hex2bn(buf + 4, signcmp.y);}
-				else if (strlen(buf) <= 2 && value == 0xFF) break; /* \r\n */
+				else if (strlen(buf) <= 2 && value == 0xDF) break; /* \r\n */
 			}
-			if (value != 0xFF) break; /* end of file */
+			if (value != 0xDF) break; /* end of file */
 
 			keyb = keya;
 			bn_clear(keyb.private);
@@ -144,11 +138,17 @@ int main(int argc, char *argv[])
 			ctx.init(&ctx);
 			ctx.update(&ctx, msg, mlen);
 			ctx.final(&ctx, digest);
+			/* verify the signature from the test vector */
+			if (!ecdsa_verify(&keya, &keyb.public, digest, ctx.md_len / 8, &signcmp)) {
+				printf("test vector signature verify FAILED, line number: %d\n", line);
+				fclose(fp);
+				return -1;
+			}
 			/*sign*/
 			ecdsa_sign(&keya, digest, ctx.md_len / 8, &sign);
-
-			if (!gfp_isequal(&sign, &signcmp)) {
-				printf("incorrect signature, line number: %d\n", line);
+			ecdsa_sign(&keya, digest, ctx.md_len / 8, &sign2);
+			if (!gfp_isequal(&sign, &sign2)) {
+				printf("signature is not deterministic, line number: %d\n", line);
 				fclose(fp);
 				return -1;
 			}
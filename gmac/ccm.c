@@ -0,0 +1,183 @@
+/*
+   Copyright 2020 Andrew Li, Gavin Li
+
+   li.andrew.mail@gmail.com
+   gavinux@gmail.com
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+/*
+ * CCM, NIST SP 800-38C: CBC-MAC over B0 || encoded AAD || payload,
+ * the payload and the MAC are encrypted by CTR with counter blocks
+ * flags || nonce || i. the counter blocks are encrypted CCM_BATCH at
+ * a time by one multi-block call, CBC-MAC is serial by nature
+ */
+#include <assert.h>
+#include <string.h>
+#include "util.h"
+#include "ccm.h"
+
+#define CCM_BATCH 8  /* counter blocks per cipher call */
+
+/* y = CBC-MAC of y and len bytes of x, the last partial block padded with zeros */
+static void cbc_mac(ccm_ctx_t *ctx, uint8_t y[16], const uint8_t *x, size_t len)
+{
+	size_t i, n;
+
+	while (len) {
+		n = len < 16 ? len : 16;
+		for (i=0; i<n; i++)
+			y[i] ^= x[i];
+		ctx->cipher->encrypt(ctx->cipher, y, 1);
+		x += n;
+		len -= n;
+	}
+}
+
+/* the low L bytes of the counter block are i, big endian */
+static void set_ctr(uint8_t *cb, int L, uint64_t i)
+{
+	int j;
+
+	for (j=0; j<L; j++, i>>=8)
+		cb[15-j] = i;
+}
+
+/*
+ * x ^= keystream of counters 1, 2, ..., s0 = E(counter 0) for the tag,
+ * counter 0 goes in the first batch
+ */
+static void ccm_ctr(ccm_ctx_t *ctx, const uint8_t ctr0[16], uint8_t *x, size_t len, uint8_t s0[16])
+{
+	size_t i, n, nblocks;
+	uint64_t ctr = 0;
+	int L = 15 - ctx->nonce_len;
+	uint8_t ks[CCM_BATCH * 16], *k;
+
+	do {
+		nblocks = (len + 15) / 16 + !ctr;  /* + counter 0 */
+		if (nblocks > CCM_BATCH) nblocks = CCM_BATCH;
+		for (i=0; i<nblocks; i++) {
+			memcpy(ks + 16*i, ctr0, 16);
+			set_ctr(ks + 16*i, L, ctr++);
+		}
+		ctx->cipher->encrypt(ctx->cipher, ks, nblocks);
+
+		k = ks;
+		if (ctr == nblocks) {  /* the first batch */
+			memcpy(s0, ks, 16);
+			k += 16;
+			nblocks--;
+		}
+		n = nblocks * 16 < len ? nblocks * 16 : len;
+		xor_keystream(x, k, n);
+		x += n;
+		len -= n;
+	} while (len);
+	memset(ks, 0, sizeof(ks));
+}
+
+/* B0 and the AAD into the CBC-MAC y, counter block 0 to ctr0 */
+static int ccm_start(ccm_ctx_t *ctx, uint8_t *nonce, uint8_t *aad, size_t aad_len, size_t xn, uint8_t y[16], uint8_t ctr0[16])
+{
+	int i, m, n, L = 15 - ctx->nonce_len;
+	uint8_t b[16];
+
+	/* the payload length has to fit in L bytes */
+	if (L < 8 && (uint64_t)xn >> (8 * L)) return -1;
+	assert(nonce);
+	assert(aad || !aad_len);
+
+	memset(y, 0, 16);
+	y[0] = (aad_len ? 0x40 : 0) | (ctx->tag_len - 2) / 2 << 3 | (L - 1);
+	memcpy(y + 1, nonce, ctx->nonce_len);
+	set_ctr(y, L, xn);
+	ctx->cipher->encrypt(ctx->cipher, y, 1);
+
+	memset(ctr0, 0, 16);
+	ctr0[0] = L - 1;
+	memcpy(ctr0 + 1, nonce, ctx->nonce_len);
+
+	if (!aad_len) return 0;
+	/* the AAD length is encoded in 2, 2 + 4 or 2 + 8 bytes, then the AAD follows */
+	memset(b, 0, sizeof(b));
+	if (aad_len < 0xff00) {
+		n = 2;
+		m = 2;
+	} else {
+		b[0] = 0xff;
+		b[1] = (uint64_t)aad_len >> 32 ? 0xff : 0xfe;
+		m = (uint64_t)aad_len >> 32 ? 8 : 4;
+		n = 2 + m;
+	}
+	for (i=0; i<m; i++)
+		b[n-1-i] = (uint64_t)aad_len >> (8*i);
+	memcpy(b + n, aad, aad_len < 16 - n ? aad_len : 16 - n);
+	cbc_mac(ctx, y, b, 16);
+	if (aad_len > 16 - n)
+		cbc_mac(ctx, y, aad + 16 - n, aad_len - (16 - n));
+	return 0;
+}
+
+static int ccm_encrypt(ccm_ctx_t *ctx, uint8_t *nonce, uint8_t *aad, size_t aad_len, uint8_t x[], size_t xn, uint8_t tag[])
+{
+	int i;
+	uint8_t y[16], ctr0[16], s0[16];
+
+	if (ccm_start(ctx, nonce, aad, aad_len, xn, y, ctr0)) return -1;
+	cbc_mac(ctx, y, x, xn);
+	ccm_ctr(ctx, ctr0, x, xn, s0);
+	for (i=0; i<ctx->tag_len; i++)
+		tag[i] = y[i] ^ s0[i];
+	memset(y, 0, sizeof(y));
+	memset(s0, 0, sizeof(s0));
+	return 0;
+}
+
+/* the MAC is over the plaintext, so x is decrypted first and encrypted back on a mismatch */
+static int ccm_decrypt(ccm_ctx_t *ctx, uint8_t *nonce, uint8_t *aad, size_t aad_len, uint8_t x[], size_t xn, uint8_t tag[])
+{
+	int i, ret;
+	uint8_t y[16], ctr0[16], s0[16];
+
+	if (ccm_start(ctx, nonce, aad, aad_len, xn, y, ctr0)) return -1;
+	ccm_ctr(ctx, ctr0, x, xn, s0);
+	cbc_mac(ctx, y, x, xn);
+	for (i=0; i<ctx->tag_len; i++)
+		y[i] ^= s0[i];
+	ret = ct_memcmp(y, tag, ctx->tag_len);
+	if (ret)
+		ccm_ctr(ctx, ctr0, x, xn, s0);
+	memset(y, 0, sizeof(y));
+	memset(s0, 0, sizeof(s0));
+	return ret;
+}
+
+int  ccm_init(ccm_ctx_t *ctx, blk_ctx_t *cipher, int nonce_len, int tag_len)
+{
+	assert(ctx);
+	assert(cipher);
+	if (cipher->blklen != 128) return -1;
+	if (nonce_len < 7 || nonce_len > 13) return -1;
+	if (tag_len < 4 || tag_len > 16 || tag_len % 2) return -1;
+
+	memset(ctx, 0, sizeof(*ctx));
+	ctx->init      = ccm_init;
+	ctx->encrypt   = ccm_encrypt;
+	ctx->decrypt   = ccm_decrypt;
+	ctx->cipher    = cipher;
+	ctx->nonce_len = nonce_len;
+	ctx->tag_len   = tag_len;
+	return 0;
+}
@@ -0,0 +1,45 @@
+/*
+   Copyright 2020 Andrew Li, Gavin Li
+
+   li.andrew.mail@gmail.com
+   gavinux@gmail.com
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef __CCM_H__
+#define __CCM_H__
+
+#include <stdint.h>
+#include "cipher-mode.h"
+
+typedef struct ccm_ctx ccm_ctx_t;
+
+/*
+ * CCM, NIST SP 800-38C, on a 128-bit block cipher. one message per
+ * encrypt/decrypt call, in place, the nonce is nonce_len bytes.
+ * decrypt returns 0 if the tag matches, otherwise -1 with x left
+ * as the ciphertext
+ */
+struct ccm_ctx {
+	int  (*init)(ccm_ctx_t *ctx, blk_ctx_t *cipher, int nonce_len, int tag_len);
+	int  (*encrypt)(ccm_ctx_t *ctx, uint8_t *nonce, uint8_t *aad, size_t aad_len, uint8_t x[], size_t xn, uint8_t tag[]);
+	int  (*decrypt)(ccm_ctx_t *ctx, uint8_t *nonce, uint8_t *aad, size_t aad_len, uint8_t x[], size_t xn, uint8_t tag[]);
+	blk_ctx_t *cipher;
+	int  nonce_len; /* 7..13 bytes */
+	int  tag_len;   /* 4, 6, ..., 16 bytes */
+};
+
+int  ccm_init(ccm_ctx_t *ctx, blk_ctx_t *cipher, int nonce_len, int tag_len);
+
+#endif /* __CCM_H__ */
@@ -0,0 +1,223 @@
+/*
+   Copyright 2020 Andrew Li, Gavin Li
+
+   li.andrew.mail@gmail.com
+   gavinux@gmail.com
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+/*
+ * AES-GCM-SIV, RFC 8452. POLYVAL is run on the GHASH code of gmac.c:
+ *     POLYVAL(H, X1, ..., Xn) =
+ *         ByteReverse(GHASH(mulX_GHASH(ByteReverse(H)), ByteReverse(X1), ...))
+ * (appendix A). the uint128_t GHASH state is the byte-reversed GHASH block,
+ * so it is the POLYVAL block itself, and the PCLMULQDQ code takes the POLYVAL
+ * blocks as they are. the other GHASH implementations get the blocks reversed
+ */
+#include <assert.h>
+#include <string.h>
+#include "sha-common.h"
+#include "util.h"
+#include "gcm-siv.h"
+
+/* ghash-clmul.c */
+extern int  clmul_supported(void);
+extern void polyval_clmul(const gcm_key_t *key, uint8_t *x, size_t nblocks, uint128_t *y);
+
+#define SIV_BATCH    8   /* counter blocks per cipher call */
+#define SIV_CHUNK    32  /* blocks reversed at a time for the portable GHASH */
+#define SIV_MAX_LEN  ((uint64_t)1 << 36)
+
+/* the GHASH key of the POLYVAL key h: mulX_GHASH(ByteReverse(h)) */
+static void polyval_key(gcm_key_t *key, const uint8_t h[16])
+{
+	const uint128_t R = (uint128_t)0xE1 << 120;
+	uint128_t v;
+
+	memcpy(&v, h, 16);
+	v = (v >> 1) ^ (R & -(v & 1));
+	v = swap128(v);
+	gcm_key_init_h(key, (uint8_t *)&v);
+	memset(&v, 0, sizeof(v));
+}
+
+/* POLYVAL over len bytes of x, the last partial block is padded with zeros */
+static void polyval_run(const gcm_key_t *key, int clmul, const uint8_t *x, size_t len, uint128_t *y)
+{
+	size_t i, n;
+	uint128_t b[SIV_CHUNK];
+
+	if (clmul) {
+		polyval_clmul(key, (uint8_t *)x, len / 16, y);
+		x += len / 16 * 16;
+		len %= 16;
+	}
+	while (len) {
+		n = len < sizeof(b) ? len : sizeof(b);
+		b[(n - 1) / 16] = 0;
+		memcpy(b, x, n);
+		for (i=0; i<(n + 15) / 16; i++)
+			b[i] = swap128(b[i]);
+		key->ghash(key, (uint8_t *)b, (n + 15) / 16, y);
+		x += n;
+		len -= n;
+	}
+}
+
+void polyval(uint8_t h[16], uint8_t *x, size_t len, uint8_t out[16])
+{
+	gcm_key_t key;
+	uint128_t y = 0;
+
+	assert(len % 16 == 0);
+	polyval_key(&key, h);
+	polyval_run(&key, clmul_supported(), x, len, &y);
+	memcpy(out, &y, 16);
+	memset(&key, 0, sizeof(key));
+}
+
+/*
+ * the per-nonce keys, the first 8 bytes of E(K, LE32(i) || nonce):
+ * i = 0, 1 the POLYVAL key, i = 2..3 or 2..5 the AES key
+ */
+static void siv_keys(gcm_siv_ctx_t *ctx, const uint8_t *nonce, gcm_key_t *auth, aes_ctx_t *enc)
+{
+	int i, n = 2 + ctx->cipher->keylen / 64;
+	uint8_t b[6 * 16], k[6 * 8];
+
+	for (i=0; i<n; i++) {
+		memset(b + 16*i, 0, 4);
+		b[16*i] = i;
+		memcpy(b + 16*i + 4, nonce, GCM_SIV_NONCE_LEN);
+	}
+	ctx->cipher->encrypt(ctx->cipher, b, n);
+	for (i=0; i<n; i++)
+		memcpy(k + 8*i, b + 16*i, 8);
+
+	polyval_key(auth, k);
+	aes_init(enc, k + 16, ctx->cipher->keylen);
+	memset(b, 0, sizeof(b));
+	memset(k, 0, sizeof(k));
+}
+
+/* tag = E(enc, POLYVAL(AAD || x || lengths) ^ nonce, msb cleared) */
+static void siv_tag(gcm_siv_ctx_t *ctx, const gcm_key_t *auth, aes_ctx_t *enc, const uint8_t *nonce,
+		const uint8_t *aad, size_t aad_len, const uint8_t *x, size_t xn, uint8_t tag[16])
+{
+	int i;
+	uint64_t lens[2];
+	uint128_t y = 0;
+
+	polyval_run(auth, ctx->clmul, aad, aad_len, &y);
+	polyval_run(auth, ctx->clmul, x, xn, &y);
+	lens[0] = (uint64_t)aad_len * 8;  /* little endian */
+	lens[1] = (uint64_t)xn * 8;
+	polyval_run(auth, ctx->clmul, (uint8_t *)lens, 16, &y);
+
+	memcpy(tag, &y, 16);
+	for (i=0; i<GCM_SIV_NONCE_LEN; i++)
+		tag[i] ^= nonce[i];
+	tag[15] &= 0x7f;
+	enc->encrypt(enc, tag, 1);
+}
+
+/*
+ * CTR from the tag with the msb set, the first 32 bits are a little
+ * endian counter that wraps without carry, SIV_BATCH blocks per call
+ */
+static void siv_ctr(aes_ctx_t *enc, const uint8_t tag[16], uint8_t *x, size_t len)
+{
+	size_t i, n, nblocks;
+	uint32_t ctr;
+	uint8_t cb[16], ks[SIV_BATCH * 16];
+
+	memcpy(cb, tag, 16);
+	cb[15] |= 0x80;
+	ctr = cb[0] | cb[1] << 8 | cb[2] << 16 | (uint32_t)cb[3] << 24;
+	while (len) {
+		nblocks = (len + 15) / 16;
+		if (nblocks > SIV_BATCH) nblocks = SIV_BATCH;
+		for (i=0; i<nblocks; i++, ctr++) {
+			memcpy(ks + 16*i, cb, 16);
+			ks[16*i]   = ctr;
+			ks[16*i+1] = ctr >> 8;
+			ks[16*i+2] = ctr >> 16;
+			ks[16*i+3] = ctr >> 24;
+		}
+		enc->encrypt(enc, ks, nblocks);
+
+		n = nblocks * 16 < len ? nblocks * 16 : len;
+		xor_keystream(x, ks, n);
+		x += n;
+		len -= n;
+	}
+	memset(ks, 0, sizeof(ks));
+}
+
+static int gcm_siv_encrypt(gcm_siv_ctx_t *ctx, uint8_t *nonce, uint8_t *aad, size_t aad_len, uint8_t x[], size_t xn, uint8_t tag[])
+{
+	gcm_key_t auth;
+	aes_ctx_t enc;
+
+	assert(nonce);
+	assert(aad || !aad_len);
+	if ((uint64_t)aad_len > SIV_MAX_LEN || (uint64_t)xn > SIV_MAX_LEN) return -1;
+
+	siv_keys(ctx, nonce, &auth, &enc);
+	siv_tag(ctx, &auth, &enc, nonce, aad, aad_len, x, xn, tag);
+	siv_ctr(&enc, tag, x, xn);
+	memset(&auth, 0, sizeof(auth));
+	memset(&enc, 0, sizeof(enc));
+	return 0;
+}
+
+/* the tag is over the plaintext, so x is decrypted first and encrypted back on a mismatch */
+static int gcm_siv_decrypt(gcm_siv_ctx_t *ctx, uint8_t *nonce, uint8_t *aad, size_t aad_len, uint8_t x[], size_t xn, uint8_t tag[])
+{
+	int ret;
+	gcm_key_t auth;
+	aes_ctx_t enc;
+	uint8_t s[16];
+
+	assert(nonce);
+	assert(aad || !aad_len);
+	if ((uint64_t)aad_len > SIV_MAX_LEN || (uint64_t)xn > SIV_MAX_LEN) return -1;
+
+	siv_keys(ctx, nonce, &auth, &enc);
+	siv_ctr(&enc, tag, x, xn);
+	siv_tag(ctx, &auth, &enc, nonce, aad, aad_len, x, xn, s);
+	ret = ct_memcmp(s, tag, GCM_SIV_TAG_LEN);
+	if (ret)
+		siv_ctr(&enc, tag, x, xn);
+	memset(&auth, 0, sizeof(auth));
+	memset(&enc, 0, sizeof(enc));
+	memset(s, 0, sizeof(s));
+	return ret;
+}
+
+int  gcm_siv_init(gcm_siv_ctx_t *ctx, blk_ctx_t *cipher)
+{
+	assert(ctx);
+	assert(cipher);
+	if (cipher->blklen != 128) return -1;
+	if (cipher->keylen != 128 && cipher->keylen != 256) return -1;
+
+	memset(ctx, 0, sizeof(*ctx));
+	ctx->init    = gcm_siv_init;
+	ctx->encrypt = gcm_siv_encrypt;
+	ctx->decrypt = gcm_siv_decrypt;
+	ctx->cipher  = cipher;
+	ctx->clmul   = clmul_supported();
+	return 0;
+}
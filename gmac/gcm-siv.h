@@ -0,0 +1,54 @@
+/*
+   Copyright 2020 Andrew Li, Gavin Li
+
+   li.andrew.mail@gmail.com
+   gavinux@gmail.com
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef __GCM_SIV_H__
+#define __GCM_SIV_H__
+
+#include <stdint.h>
+#include "cipher-mode.h"
+#include "aes.h"
+#include "gmac.h"
+
+#define GCM_SIV_NONCE_LEN 12
+#define GCM_SIV_TAG_LEN   16
+
+typedef struct gcm_siv_ctx gcm_siv_ctx_t;
+
+/*
+ * AES-GCM-SIV, RFC 8452, nonce misuse resistant: repeating a nonce only
+ * shows whether the same message was sent again. cipher is the AES-128
+ * or AES-256 key-generating key, the per-nonce keys are derived in each
+ * call. one message per encrypt/decrypt call, in place, the length of
+ * x and of the AAD is up to 2^36 bytes. decrypt returns 0 if the tag
+ * matches, otherwise -1 with x left as the ciphertext
+ */
+struct gcm_siv_ctx {
+	int  (*init)(gcm_siv_ctx_t *ctx, blk_ctx_t *cipher);
+	int  (*encrypt)(gcm_siv_ctx_t *ctx, uint8_t *nonce, uint8_t *aad, size_t aad_len, uint8_t x[], size_t xn, uint8_t tag[]);
+	int  (*decrypt)(gcm_siv_ctx_t *ctx, uint8_t *nonce, uint8_t *aad, size_t aad_len, uint8_t x[], size_t xn, uint8_t tag[]);
+	blk_ctx_t *cipher;
+	int  clmul;  /* POLYVAL with PCLMULQDQ */
+};
+
+int  gcm_siv_init(gcm_siv_ctx_t *ctx, blk_ctx_t *cipher);
+
+/* POLYVAL(H, X) of RFC 8452 over len bytes, len is a multiple of 16 */
+void polyval(uint8_t h[16], uint8_t *x, size_t len, uint8_t out[16]);
+
+#endif /* __GCM_SIV_H__ */
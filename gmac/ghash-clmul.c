@@ -0,0 +1,266 @@
+/*
+   Copyright 2020 Andrew Li, Gavin Li
+
+   li.andrew.mail@gmail.com
+   gavinux@gmail.com
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+/*
+ * GHASH with PCLMULQDQ, based on
+ * Intel Carry-Less Multiplication Instruction and its Usage for Computing the GCM Mode,
+ * Shay Gueron, Michael E. Kounavis, white paper 323640
+ *
+ * a uint128_t block in gmac.c is the byte-reflected block (swap128), which is
+ * what the white paper's gfmul works on, so H and Y are shared with the portable code.
+ * up to GHASH_CLMUL_AGGR blocks are multiplied by H^n..H^1 and reduced once:
+ *     Y = (Y ^ X1) * H^n ^ X2 * H^(n-1) ^ ... ^ Xn * H
+ * gcm_aesni_clmul() stitches this with AES-NI CTR, polyval_clmul() is the
+ * same hash on POLYVAL blocks for GCM-SIV
+ */
+#include <string.h>
+#include "sha-common.h"
+#include "gmac.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <emmintrin.h>
+#include <tmmintrin.h>
+#include <wmmintrin.h>
+
+#define CLMUL_TARGET __attribute__((target("pclmul,ssse3,sse2")))
+#define STITCH_TARGET __attribute__((target("aes,pclmul,ssse3,sse2")))
+
+int  clmul_supported(void)
+{
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("ssse3");
+}
+
+/* 256-bit carry-less product a * b, accumulated to (lo, hi) */
+CLMUL_TARGET
+static inline void clmul_acc(__m128i a, __m128i b, __m128i *lo, __m128i *hi)
+{
+	__m128i t0, t1, t2, t3;
+
+	t0 = _mm_clmulepi64_si128(a, b, 0x00);
+	t1 = _mm_clmulepi64_si128(a, b, 0x10);
+	t2 = _mm_clmulepi64_si128(a, b, 0x01);
+	t3 = _mm_clmulepi64_si128(a, b, 0x11);
+	t1 = _mm_xor_si128(t1, t2);
+	*lo = _mm_xor_si128(*lo, _mm_xor_si128(t0, _mm_slli_si128(t1, 8)));
+	*hi = _mm_xor_si128(*hi, _mm_xor_si128(t3, _mm_srli_si128(t1, 8)));
+}
+
+/*
+ * (hi, lo) is the product of two bit-reflected values, shift it left
+ * by one bit, then reduce modulo x^128 + x^7 + x^2 + x + 1
+ */
+CLMUL_TARGET
+static inline __m128i clmul_reduce(__m128i lo, __m128i hi)
+{
+	__m128i t2, t4, t5, t7, t8, t9;
+
+	t7 = _mm_srli_epi32(lo, 31);
+	t8 = _mm_srli_epi32(hi, 31);
+	lo = _mm_slli_epi32(lo, 1);
+	hi = _mm_slli_epi32(hi, 1);
+	t9 = _mm_srli_si128(t7, 12);
+	t8 = _mm_slli_si128(t8, 4);
+	t7 = _mm_slli_si128(t7, 4);
+	lo = _mm_or_si128(lo, t7);
+	hi = _mm_or_si128(hi, t8);
+	hi = _mm_or_si128(hi, t9);
+
+	t7 = _mm_slli_epi32(lo, 31);
+	t8 = _mm_slli_epi32(lo, 30);
+	t9 = _mm_slli_epi32(lo, 25);
+	t7 = _mm_xor_si128(t7, t8);
+	t7 = _mm_xor_si128(t7, t9);
+	t8 = _mm_srli_si128(t7, 4);
+	t7 = _mm_slli_si128(t7, 12);
+	lo = _mm_xor_si128(lo, t7);
+
+	t2 = _mm_srli_epi32(lo, 1);
+	t4 = _mm_srli_epi32(lo, 2);
+	t5 = _mm_srli_epi32(lo, 7);
+	t2 = _mm_xor_si128(t2, t4);
+	t2 = _mm_xor_si128(t2, t5);
+	t2 = _mm_xor_si128(t2, t8);
+	lo = _mm_xor_si128(lo, t2);
+	return _mm_xor_si128(hi, lo);
+}
+
+CLMUL_TARGET
+static inline __m128i gfmul(__m128i a, __m128i b)
+{
+	__m128i lo = _mm_setzero_si128(), hi = _mm_setzero_si128();
+
+	clmul_acc(a, b, &lo, &hi);
+	return clmul_reduce(lo, hi);
+}
+
+/* key->hpow[i] = H^(i+1) */
+CLMUL_TARGET
+void ghash_clmul_init(gcm_key_t *key)
+{
+	int i;
+	__m128i h, p;
+
+	h = p = _mm_loadu_si128((__m128i *)&key->h);
+	_mm_storeu_si128((__m128i *)&key->hpow[0], h);
+	for (i=1; i<GHASH_CLMUL_AGGR; i++) {
+		p = gfmul(p, h);
+		_mm_storeu_si128((__m128i *)&key->hpow[i], p);
+	}
+}
+
+/*
+ * reflect is 0 for POLYVAL, whose blocks are the byte-reversed GHASH blocks
+ * (RFC 8452 appendix A), so they are loaded as they are
+ */
+CLMUL_TARGET
+static inline void clmul_hash(const gcm_key_t *key, uint8_t *x, size_t nblocks, uint128_t *y, int reflect)
+{
+	int i, n;
+	const __m128i bswap = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+	__m128i Y, X, lo, hi;
+
+	Y = _mm_loadu_si128((__m128i *)y);
+	for (; nblocks; nblocks -= n, x += 16*n) {
+		n = nblocks < GHASH_CLMUL_AGGR ? nblocks : GHASH_CLMUL_AGGR;
+		lo = hi = _mm_setzero_si128();
+		for (i=0; i<n; i++) {
+			X = _mm_loadu_si128((__m128i *)(x + 16*i));
+			if (reflect) X = _mm_shuffle_epi8(X, bswap);
+			if (!i) X = _mm_xor_si128(X, Y);
+			clmul_acc(X, _mm_loadu_si128((__m128i *)&key->hpow[n-1-i]), &lo, &hi);
+		}
+		Y = clmul_reduce(lo, hi);
+	}
+	_mm_storeu_si128((__m128i *)y, Y);
+}
+
+CLMUL_TARGET
+void ghash_clmul(const gcm_key_t *key, uint8_t *x, size_t nblocks, uint128_t *y)
+{
+	clmul_hash(key, x, nblocks, y, 1);
+}
+
+CLMUL_TARGET
+void polyval_clmul(const gcm_key_t *key, uint8_t *x, size_t nblocks, uint128_t *y)
+{
+	clmul_hash(key, x, nblocks, y, 0);
+}
+
+/*
+ * stitched AES-NI CTR + GHASH, 8 blocks per iteration. the GHASH of one
+ * group of 8 ciphertext blocks is interleaved with the AES rounds of the
+ * next group (of the same group when decrypting), one carry-less multiply
+ * per round, so the AES and the PCLMULQDQ units work side by side.
+ * ctr is the counter block of the first block, it is advanced past the
+ * processed blocks. only multiples of 8 blocks are processed, the number
+ * of processed blocks is returned
+ */
+STITCH_TARGET
+size_t gcm_aesni_clmul(const gcm_key_t *key, uint8_t *ctr, uint8_t *x, size_t nblocks, int decrypt, uint128_t *y)
+{
+	int i, j, nround;
+	size_t done;
+	const aes_ctx_t *aes = (const aes_ctx_t *)key->cipher;
+	const __m128i bswap = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+	/* swaps the bytes of the 32-bit counter, so it can be added to */
+	const __m128i bswap_ctr = _mm_set_epi8(12, 13, 14, 15, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+	__m128i rk[15], hp[8], b[8], c, Y, lo, hi, X;
+	uint8_t *g;
+
+	nblocks &= ~(size_t)7;
+	if (!nblocks) return 0;
+
+	nround = aes->keylen / 32 + 6;
+	for (i=0; i<=nround; i++)
+		rk[i] = _mm_loadu_si128((const __m128i *)(aes->rk.ni[0] + 16*i));
+	for (i=0; i<8; i++)
+		hp[i] = _mm_loadu_si128((const __m128i *)&key->hpow[7-i]);  /* H^8..H^1 */
+	c = _mm_shuffle_epi8(_mm_loadu_si128((__m128i *)ctr), bswap_ctr);
+	Y = _mm_loadu_si128((__m128i *)y);
+
+	for (done=0; done<nblocks; done+=8, x+=8*16) {
+		/* the ciphertext to hash in this iteration */
+		g = decrypt ? x : (done ? x - 8*16 : NULL);
+		lo = hi = _mm_setzero_si128();
+		_Pragma("GCC unroll 8")
+		for (j=0; j<8; j++) {
+			b[j] = _mm_shuffle_epi8(_mm_add_epi32(c, _mm_set_epi32(j, 0, 0, 0)), bswap_ctr);
+			b[j] = _mm_xor_si128(b[j], rk[0]);
+		}
+		c = _mm_add_epi32(c, _mm_set_epi32(8, 0, 0, 0));
+		/* nround >= 10, so rounds 1..8 take one block each */
+		_Pragma("GCC unroll 8")
+		for (i=1; i<=8; i++) {
+			_Pragma("GCC unroll 8")
+			for (j=0; j<8; j++)
+				b[j] = _mm_aesenc_si128(b[j], rk[i]);
+			if (g) {
+				X = _mm_shuffle_epi8(_mm_loadu_si128((__m128i *)(g + 16*(i-1))), bswap);
+				if (i == 1) X = _mm_xor_si128(X, Y);
+				clmul_acc(X, hp[i-1], &lo, &hi);
+			}
+		}
+		for (; i<nround; i++) {
+			_Pragma("GCC unroll 8")
+			for (j=0; j<8; j++)
+				b[j] = _mm_aesenc_si128(b[j], rk[i]);
+		}
+		if (g)
+			Y = clmul_reduce(lo, hi);
+		_Pragma("GCC unroll 8")
+		for (j=0; j<8; j++) {
+			b[j] = _mm_aesenclast_si128(b[j], rk[nround]);
+			b[j] = _mm_xor_si128(b[j], _mm_loadu_si128((__m128i *)(x + 16*j)));
+			_mm_storeu_si128((__m128i *)(x + 16*j), b[j]);
+		}
+	}
+	_mm_storeu_si128((__m128i *)y, Y);
+	/* the last group of ciphertext is still to be hashed */
+	if (!decrypt)
+		ghash_clmul(key, x - 8*16, 8, y);
+	_mm_storeu_si128((__m128i *)ctr, _mm_shuffle_epi8(c, bswap_ctr));
+	return nblocks;
+}
+
+#else /* no PCLMULQDQ on this architecture */
+
+int  clmul_supported(void)
+{
+	return 0;
+}
+
+void ghash_clmul_init(gcm_key_t *key)
+{
+}
+
+void ghash_clmul(const gcm_key_t *key, uint8_t *x, size_t nblocks, uint128_t *y)
+{
+}
+
+void polyval_clmul(const gcm_key_t *key, uint8_t *x, size_t nblocks, uint128_t *y)
+{
+}
+
+size_t gcm_aesni_clmul(const gcm_key_t *key, uint8_t *ctr, uint8_t *x, size_t nblocks, int decrypt, uint128_t *y)
+{
+	return 0;
+}
+
+#endif
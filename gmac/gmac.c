@@ -22,35 +22,28 @@
 #include <stdint.h>
 #include <string.h>
 #include "sha-common.h"
+#include "util.h"
 #include "cipher-mode.h"
+#include "pool.h"
 #include "gmac.h"
 
-#define MSB  (*(uint128_t *)"\x0\x0\x0\x0\x0\x0\x0\x0\x0\x0\x0\x0\x0\x0\x0\x80")
+/* ghash-clmul.c */
+extern int  clmul_supported(void);
+extern void ghash_clmul_init(gcm_key_t *key);
+extern void ghash_clmul(const gcm_key_t *key, uint8_t *x, size_t nblocks, uint128_t *y);
+extern size_t gcm_aesni_clmul(const gcm_key_t *key, uint8_t *ctr, uint8_t *x, size_t nblocks, int decrypt, uint128_t *y);
 
-static void inc_ctr32(uint8_t *ctr)
-{
-	register uint32_t u32;
-
-	u32 = swap32(*(uint32_t *)ctr);
-	*(uint32_t *)ctr = swap32(++u32);
-}
+#define MSB  (*(uint128_t *)"\x0\x0\x0\x0\x0\x0\x0\x0\x0\x0\x0\x0\x0\x0\x0\x80")
 
 static void xor128(uint128_t *src, uint128_t *dst)
 {
 	*dst ^= *src;
 }
 
-static void lshift128(uint128_t *u128)
-{
-	*u128 <<= 1;
-}
-
-static void rshift128(uint128_t *u128)
-{
-	*u128 >>= 1;
-}
-
-/* Multiplication in GF(2^128) */
+/*
+ * Multiplication in GF(2^128), Algorithm 1 of SP 800-38D.
+ * the branches are replaced by masks, so it runs in constant time
+ */
 static void mult128(uint128_t *x, uint128_t *y, uint128_t *z)
 {
 	const uint128_t R = *(uint128_t *)"\x0\x0\x0\x0\x0\x0\x0\x0\x0\x0\x0\x0\x0\x0\x0\xE1";
@@ -61,133 +54,547 @@ static void mult128(uint128_t *x, uint128_t *y, uint128_t *z)
 	X  = *x;
 	v  = *y;   /* V[0] = Y */
 	for (i = 0; i < 128; i++) {
-		if (X & MSB) {
-			/* Z[i + 1] = Z[i] XOR V[i] */
-			xor128(&v, &Z);
-		} else {
-			/* Z[i + 1] = Z[i] */
-		}
-		lshift128(&X);
-		if (v & 1) {
-			/* V[i + 1] = (V[i] >> 1) XOR R */
-			rshift128(&v);
-			xor128((uint128_t *)&R, &v);
-		} else {
-			/* V[i + 1] = V[i] >> 1 */
-			rshift128(&v);
-		}
+		/* Z[i + 1] = Z[i] XOR V[i] if x[i] is 1 */
+		Z ^= v & -(X >> 127);
+		X <<= 1;
+		/* V[i + 1] = (V[i] >> 1) XOR R if lsb of V[i] is 1 */
+		v = (v >> 1) ^ (R & -(v & 1));
 	}
 	*z = Z;
 }
 
-static void ghash(uint128_t *h, uint8_t *x, uint128_t *y)
+#ifdef GHASH_CONSTTIME
+/* Y = (Y ^ X) * H, bit by bit */
+static void ghash_1bit(const gcm_key_t *key, uint8_t *x, size_t nblocks, uint128_t *y)
 {
 	uint128_t X;
 
-	X = swap128(*(uint128_t *)x);
-	xor128(&X, y);
-	mult128(h, y, y);
+	for (; nblocks--; x += 16) {
+		X = swap128(*(uint128_t *)x);
+		xor128(&X, y);
+		mult128((uint128_t *)&key->h, y, y);
+	}
 }
+#else
+/*
+ * Shoup's 4-bit table method.
+ * bit 127 of a uint128_t is the coefficient of x^0, so multiplying by x^4
+ * is a right shift by 4, and the 4 bits shifted out are reduced by
+ * rem_4bit[], the top 16 bits of (those bits) * (x^128 mod P)
+ */
+static const uint16_t rem_4bit[16] = {
+	0x0000, 0x1C20, 0x3840, 0x2460, 0x7080, 0x6CA0, 0x48C0, 0x54E0,
+	0xE100, 0xFD20, 0xD940, 0xC560, 0x9180, 0x8DA0, 0xA9C0, 0xB5E0
+};
+
+/* htable[i] = i * H, where the bits 3,2,1,0 of i are the coefficients of x^0..x^3 */
+static void ghash_4bit_table(gcm_key_t *key)
+{
+	int i, j;
+	uint128_t v = key->h;
 
-static void gctr(gmac_ctx_t *ctx, uint8_t *x)
+	key->htable[0] = 0;
+	for (i=8; i; i>>=1) {
+		key->htable[i] = v;
+		v = (v >> 1) ^ (((uint128_t)0xE1 << 120) & -(v & 1));
+	}
+	for (i=2; i<16; i<<=1)
+		for (j=1; j<i; j++)
+			key->htable[i+j] = key->htable[i] ^ key->htable[j];
+}
+
+/*
+ * Horner's rule over the 32 nibbles of Y, from x^124..x^127 down to x^0..x^3,
+ * the table index depends on the data, use GHASH_CONSTTIME to avoid it
+ */
+static void ghash_4bit(const gcm_key_t *key, uint8_t *x, size_t nblocks, uint128_t *y)
+{
+	int i;
+	uint128_t Y, Z = *y;
+
+	for (; nblocks--; x += 16) {
+		Y = Z ^ swap128(*(uint128_t *)x);
+		Z = 0;
+		for (i=0; i<32; i++) {
+			Z = (Z >> 4) ^ ((uint128_t)rem_4bit[Z & 0xf] << 112);
+			Z ^= key->htable[Y & 0xf];
+			Y >>= 4;
+		}
+	}
+	*y = Z;
+}
+#endif
+
+/*
+ * the data is processed in GMAC_CHUNK pieces: CTR over the piece with the
+ * multi-block cipher call, then GHASH over the same piece while it is in cache
+ *
+ * multi-threaded GCM: every job of the worker pool does the above over its run
+ * of blocks with the counter advanced to the run, and GHASHes the run's ciphertext
+ * starting from zero. with m blocks in a run,
+ *     Y = Y_prev * H^m ^ Y_run
+ * so the partial hashes are chained in order by the calling thread
+ */
+#define GMAC_CHUNK         (2 * 1024)   /* bytes, multiple of 16 */
+#define GMAC_BATCH         8            /* counter blocks per cipher call */
+
+/* stream states */
+enum {
+	eGCM_AAD,      /* taking AAD, partial holds an incomplete AAD block */
+	eGCM_ENCRYPT,  /* taking plaintext, partial holds ciphertext bytes */
+	eGCM_DECRYPT,  /* taking ciphertext */
+	eGCM_FINAL,    /* tag produced, only init is allowed */
+};
+
+/* what a pass over the data does */
+enum {
+	eGCM_OP_ENCRYPT,  /* CTR, then GHASH the ciphertext */
+	eGCM_OP_DECRYPT,  /* GHASH the ciphertext, then CTR */
+	eGCM_OP_HASH,     /* GHASH only */
+	eGCM_OP_CTR,      /* CTR only */
+};
+
+struct gmac_job {
+	gmac_ctx_t *ctx;
+	uint8_t    *x;
+	size_t      len;      /* whole blocks */
+	int         op;
+	uint8_t     ctr[16];  /* counter block of the next block of the run */
+	uint128_t   y;        /* GHASH of the run */
+};
+
+static void inc_ctr32(uint8_t *ctr, uint32_t n)
 {
-	uint8_t  ivctr[16];
+	register uint32_t u32;
 
-	inc_ctr32(ctx->j0 + 12);
-	memcpy(ivctr, ctx->j0, 16);
+	u32 = swap32(*(uint32_t *)(ctr + 12));
+	*(uint32_t *)(ctr + 12) = swap32(u32 + n);
+}
 
-	ctx->cipher->encrypt(ctx->cipher, ivctr, 1);
-	xor128((uint128_t *)ivctr, (uint128_t *)x);
+/*
+ * CTR over whole blocks with inc32() of SP 800-38D: the last 32 bits
+ * of the counter block wrap without carrying, unlike ctr_init()'s CTR
+ */
+static void gcm_ctr(const gcm_key_t *key, uint8_t ctr[16], uint8_t *x, size_t len)
+{
+	size_t i, n;
+	uint8_t ks[GMAC_BATCH * 16];
+
+	for (; len; x += n, len -= n) {
+		n = len < sizeof(ks) ? len : sizeof(ks);
+		for (i=0; i<n; i+=16) {
+			memcpy(ks + i, ctr, 16);
+			inc_ctr32(ctr, 1);
+		}
+		key->cipher->encrypt(key->cipher, ks, n / 16);
+		xor_keystream(x, ks, n);
+	}
+	memset(ks, 0, sizeof(ks));
 }
 
-static void gmac_encrypt(gmac_ctx_t *ctx, uint8_t x[], size_t xn, uint8_t tag[])
+/* H^n by square and multiply */
+static uint128_t hpow(uint128_t h, size_t n)
+{
+	uint128_t r = MSB;  /* 1 in GF(2^128) */
+
+	for (; n; n >>= 1) {
+		if (n & 1) mult128(&r, &h, &r);
+		mult128(&h, &h, &h);
+	}
+	return r;
+}
+
+/* GHASH of len bytes, the last partial block is padded with zeros */
+static void ghash_run(const gcm_key_t *key, uint8_t *x, size_t len, uint128_t *y)
+{
+	uint8_t s[16];
+
+	key->ghash(key, x, len / 16, y);
+	if (len % 16) {
+		memset(s, 0, 16);
+		memcpy(s, x + len / 16 * 16, len % 16);
+		key->ghash(key, s, 1, y);
+	}
+}
+
+static void gmac_worker(void *arg)
+{
+	struct gmac_job *job = arg;
+	const gcm_key_t *key = job->ctx->key;
+	uint8_t *x = job->x;
+	size_t  n, len = job->len;
+
+	/* the stitched kernel takes whole groups of blocks and advances the counter */
+	if (key->stitch && (job->op == eGCM_OP_ENCRYPT || job->op == eGCM_OP_DECRYPT)) {
+		n = 16 * key->stitch(key, job->ctr, x, len / 16, job->op == eGCM_OP_DECRYPT, &job->y);
+		x   += n;
+		len -= n;
+	}
+	for (; len; x += n, len -= n) {
+		n = len < GMAC_CHUNK ? len : GMAC_CHUNK;
+		if (job->op == eGCM_OP_DECRYPT || job->op == eGCM_OP_HASH)
+			key->ghash(key, x, n / 16, &job->y);
+		if (job->op != eGCM_OP_HASH)
+			gcm_ctr(key, job->ctr, x, n);
+		if (job->op == eGCM_OP_ENCRYPT)
+			key->ghash(key, x, n / 16, &job->y);
+	}
+}
+
+/* CTR and/or GHASH over whole blocks, continuing from ctx->ctr and ctx->y */
+static void gmac_crypt(gmac_ctx_t *ctx, uint8_t x[], size_t xn, int op, int nthreads)
+{
+	int t;
+	size_t nblocks, per, off;
+	uint128_t y, hper, hlast;
+	struct gmac_job job[POOL_MAX_THREADS];
+
+	nthreads = pool_threads(nthreads, xn);
+
+	nblocks = xn / 16;
+	per = (nblocks + nthreads - 1) / nthreads;
+	for (t=0; t<nthreads; t++) {
+		off = t * per * 16;
+		if (off > xn) off = xn;
+		job[t].ctx = ctx;
+		job[t].x   = x + off;
+		job[t].len = xn - off < per * 16 ? xn - off : per * 16;
+		job[t].op  = op;
+		job[t].y   = t ? 0 : ctx->y;
+		memcpy(job[t].ctr, ctx->ctr, 16);
+		inc_ctr32(job[t].ctr, t * per);
+	}
+	run_jobs(gmac_worker, job, sizeof(job[0]), nthreads);
+
+	/* all runs but the last have per blocks */
+	y = job[0].y;
+	if (nthreads > 1 && op != eGCM_OP_CTR) {
+		hper  = hpow(ctx->key->h, per);
+		hlast = hpow(ctx->key->h, job[nthreads-1].len / 16);
+		for (t=1; t<nthreads; t++) {
+			mult128(&y, t == nthreads - 1 ? &hlast : &hper, &y);
+			y ^= job[t].y;
+		}
+	}
+	ctx->y = y;
+	if (op != eGCM_OP_HASH)
+		inc_ctr32(ctx->ctr, nblocks);
+	memset(job, 0, sizeof(job));
+}
+
+/* the AAD is complete, pad its last block */
+static void gcm_start(gmac_ctx_t *ctx, int state)
+{
+	if (ctx->plen) {
+		memset(ctx->partial + ctx->plen, 0, 16 - ctx->plen);
+		ctx->key->ghash(ctx->key, ctx->partial, 1, &ctx->y);
+		ctx->plen = 0;
+	}
+	ctx->state = state;
+}
+
+/* moves bytes between the caller's buffer and the partial block */
+static size_t gcm_partial(gmac_ctx_t *ctx, uint8_t *x, size_t len, int decrypt)
+{
+	size_t i, n;
+
+	n = 16 - ctx->plen < len ? 16 - ctx->plen : len;
+	for (i=0; i<n; i++) {
+		if (decrypt) ctx->partial[ctx->plen + i] = x[i];
+		x[i] ^= ctx->ks[ctx->plen + i];
+		if (!decrypt) ctx->partial[ctx->plen + i] = x[i];
+	}
+	ctx->plen += n;
+	if (ctx->plen == 16) {
+		ctx->key->ghash(ctx->key, ctx->partial, 1, &ctx->y);
+		ctx->plen = 0;
+	}
+	return n;
+}
+
+int  gcm_aad(gmac_ctx_t *ctx, uint8_t *aad, size_t len)
 {
-	uint8_t s[16], j0[16];
 	size_t n;
-	uint128_t y = ctx->aad;
 
-	memcpy(j0, ctx->j0, 16);
-	ctx->cipher->encrypt(ctx->cipher, j0, 1);
+	if (ctx->state != eGCM_AAD) return -1;
+	ctx->aad_len += len;
+	if (ctx->plen) {
+		n = 16 - ctx->plen < len ? 16 - ctx->plen : len;
+		memcpy(ctx->partial + ctx->plen, aad, n);
+		ctx->plen += n;
+		aad += n;
+		len -= n;
+		if (ctx->plen < 16) return 0;
+		ctx->key->ghash(ctx->key, ctx->partial, 1, &ctx->y);
+		ctx->plen = 0;
+	}
+	ctx->key->ghash(ctx->key, aad, len / 16, &ctx->y);
+	memcpy(ctx->partial, aad + len / 16 * 16, len % 16);
+	ctx->plen = len % 16;
+	return 0;
+}
 
-	n = xn / 16;
-	while (n--) {
-		gctr(ctx, x);
-		ghash(&ctx->h, x, &y);
-		x += 16;
+static int gcm_update_mt(gmac_ctx_t *ctx, uint8_t *x, size_t len, int decrypt, int nthreads)
+{
+	size_t n;
+	int state = decrypt ? eGCM_DECRYPT : eGCM_ENCRYPT;
+
+	if (ctx->state == eGCM_AAD)
+		gcm_start(ctx, state);
+	if (ctx->state != state) return -1;
+	ctx->msg_len += len;
+
+	/* finish the keystream block left by the previous call */
+	if (ctx->plen) {
+		n = gcm_partial(ctx, x, len, decrypt);
+		x   += n;
+		len -= n;
 	}
-	if (xn % 16) {
-		memcpy(s, x, xn % 16);
-		gctr(ctx, s);
-		memcpy(x, s, xn % 16);
-		memset(s + xn % 16, 0, 16 - xn % 16);
-		ghash(&ctx->h, s, &y);
+	n = len / 16 * 16;
+	if (n)
+		gmac_crypt(ctx, x, n, decrypt ? eGCM_OP_DECRYPT : eGCM_OP_ENCRYPT, nthreads);
+	x   += n;
+	len -= n;
+	/* a new keystream block for the tail */
+	if (len) {
+		memcpy(ctx->ks, ctx->ctr, 16);
+		ctx->key->cipher->encrypt(ctx->key->cipher, ctx->ks, 1);
+		inc_ctr32(ctx->ctr, 1);
+		gcm_partial(ctx, x, len, decrypt);
 	}
+	return 0;
+}
 
+int  gcm_update(gmac_ctx_t *ctx, uint8_t *x, size_t len, int decrypt)
+{
+	return gcm_update_mt(ctx, x, len, decrypt, 1);
+}
+
+/* s = E(K, J0) ^ GHASH(A || C || len(A) || len(C)) */
+static void gcm_tag(gmac_ctx_t *ctx, uint8_t s[16])
+{
+	uint8_t j0[16];
+
+	if (ctx->plen) {
+		memset(ctx->partial + ctx->plen, 0, 16 - ctx->plen);
+		ctx->key->ghash(ctx->key, ctx->partial, 1, &ctx->y);
+		ctx->plen = 0;
+	}
 	*(uint64_t *)s = swap64(ctx->aad_len * 8);
-	*(uint64_t *)(s+8) = swap64(xn * 8);
-	ghash(&ctx->h, s, &y);
-	*(uint128_t *)s = swap128(y);
+	*(uint64_t *)(s+8) = swap64(ctx->msg_len * 8);
+	ctx->key->ghash(ctx->key, s, 1, &ctx->y);
+	*(uint128_t *)s = swap128(ctx->y);
 
+	memcpy(j0, ctx->j0, 16);
+	ctx->key->cipher->encrypt(ctx->key->cipher, j0, 1);
 	xor128((uint128_t *)j0, (uint128_t *)s);
-	if (tag)
+	memset(ctx->ks, 0, sizeof(ctx->ks));
+	ctx->state = eGCM_FINAL;
+}
+
+int  gcm_final(gmac_ctx_t *ctx, uint8_t tag[], int decrypt)
+{
+	int ret = 0;
+	uint8_t s[16];
+
+	if (ctx->state == eGCM_AAD)
+		gcm_start(ctx, decrypt ? eGCM_DECRYPT : eGCM_ENCRYPT);
+	if (ctx->state != (decrypt ? eGCM_DECRYPT : eGCM_ENCRYPT)) return -1;
+
+	gcm_tag(ctx, s);
+	if (decrypt)
+		ret = ct_memcmp(tag, s, ctx->tag_len);
+	else if (tag)
 		memcpy(tag, s, ctx->tag_len);
+	return ret;
 }
 
-static int gmac_decrypt(gmac_ctx_t *ctx, uint8_t x[], size_t xn, uint8_t tag[])
+int  gmac_encrypt_mt(gmac_ctx_t *ctx, uint8_t x[], size_t xn, uint8_t tag[], int nthreads)
 {
-	uint8_t s[16], j0[16];
-	size_t n;
-	uint128_t y = ctx->aad;
+	if (gcm_update_mt(ctx, x, xn, 0, nthreads))
+		return -1;
+	return gcm_final(ctx, tag, 0);
+}
 
-	memcpy(j0, ctx->j0, 16);
-	ctx->cipher->encrypt(ctx->cipher, j0, 1);
+/*
+ * out of place over iovec lists: each run that is contiguous in both
+ * the input and the output element is copied and en/decrypted there
+ * by gcm_update(), which carries blocks across the runs
+ */
+static ssize_t gcm_iov(gmac_ctx_t *ctx, const struct iovec *in, int nin, struct iovec *out, int nout, uint8_t tag[], int decrypt)
+{
+	int i, o;
+	size_t n, ioff, ooff, total = 0, room = 0;
+	uint8_t *p;
+
+	assert(in || !nin);
+	assert(out || !nout);
+	for (i=0; i<nin; i++)
+		total += in[i].iov_len;
+	for (o=0; o<nout; o++)
+		room += out[o].iov_len;
+	if (room < total) return -1;
+
+	for (i=o=0, ioff=ooff=0; i<nin; ) {
+		if (ioff == in[i].iov_len) {
+			i++;
+			ioff = 0;
+			continue;
+		}
+		if (ooff == out[o].iov_len) {
+			o++;
+			ooff = 0;
+			continue;
+		}
+		n = in[i].iov_len - ioff;
+		if (n > out[o].iov_len - ooff) n = out[o].iov_len - ooff;
+		p = (uint8_t *)out[o].iov_base + ooff;
+		memmove(p, (uint8_t *)in[i].iov_base + ioff, n);
+		if (gcm_update(ctx, p, n, decrypt)) return -1;
+		ioff += n;
+		ooff += n;
+	}
+	if (gcm_final(ctx, tag, decrypt)) {
+		/* no plaintext of a forged message is left behind */
+		for (o=0, n=total; n; o++) {
+			ooff = n < out[o].iov_len ? n : out[o].iov_len;
+			memset(out[o].iov_base, 0, ooff);
+			n -= ooff;
+		}
+		return -1;
+	}
+	return total;
+}
+
+ssize_t gcm_encrypt_iov(gmac_ctx_t *ctx, const struct iovec *in, int nin, struct iovec *out, int nout, uint8_t tag[])
+{
+	return gcm_iov(ctx, in, nin, out, nout, tag, 0);
+}
+
+ssize_t gcm_decrypt_iov(gmac_ctx_t *ctx, const struct iovec *in, int nin, struct iovec *out, int nout, uint8_t tag[])
+{
+	return gcm_iov(ctx, in, nin, out, nout, tag, 1);
+}
+
+/*
+ * verify, then decrypt: the first pass only GHASHes the ciphertext,
+ * x is decrypted by a CTR pass after the tag matched, and is left
+ * untouched by a forged message
+ */
+int  gmac_decrypt_mt(gmac_ctx_t *ctx, uint8_t x[], size_t xn, uint8_t tag[], int nthreads)
+{
+	size_t i, n = xn / 16 * 16;
+	uint8_t s[16];
 
-	n = xn / 16;
-	while (n--) {
-		ghash(&ctx->h, x, &y);
-		gctr(ctx, x);
-		x += 16;
+	if (ctx->state == eGCM_AAD)
+		gcm_start(ctx, eGCM_DECRYPT);
+	if (ctx->state != eGCM_DECRYPT || ctx->plen || ctx->msg_len) return -1;
+
+	ctx->msg_len = xn;
+	gmac_crypt(ctx, x, n, eGCM_OP_HASH, nthreads);
+	ghash_run(ctx->key, x + n, xn - n, &ctx->y);
+	gcm_tag(ctx, s);
+	if (ct_memcmp(tag, s, ctx->tag_len))
+		return -1;
+
+	gmac_crypt(ctx, x, n, eGCM_OP_CTR, nthreads);
+	if (xn - n) {
+		memcpy(s, ctx->ctr, 16);
+		ctx->key->cipher->encrypt(ctx->key->cipher, s, 1);
+		for (i=n; i<xn; i++)
+			x[i] ^= s[i - n];
+		memset(s, 0, sizeof(s));
 	}
-	if (xn % 16) {
-		memcpy(s, x, xn % 16);
-		memset(s + xn % 16, 0, 16 - xn % 16);
-		ghash(&ctx->h, s, &y);
-		gctr(ctx, s);
-		memcpy(x, s, xn % 16);
+	return 0;
+}
+
+static int  gmac_encrypt(gmac_ctx_t *ctx, uint8_t x[], size_t xn, uint8_t tag[])
+{
+	return gmac_encrypt_mt(ctx, x, xn, tag, 1);
+}
+
+static int gmac_decrypt(gmac_ctx_t *ctx, uint8_t x[], size_t xn, uint8_t tag[])
+{
+	return gmac_decrypt_mt(ctx, x, xn, tag, 1);
+}
+
+/* the GHASH implementation and its tables for key->h */
+static void gcm_key_setup(gcm_key_t *key)
+{
+	/* PCLMULQDQ is constant time too */
+	if (clmul_supported()) {
+		ghash_clmul_init(key);
+		key->ghash = ghash_clmul;
+	} else {
+#ifdef GHASH_CONSTTIME
+		key->ghash = ghash_1bit;
+#else
+		ghash_4bit_table(key);
+		key->ghash = ghash_4bit;
+#endif
 	}
+}
 
-	*(uint64_t *)s = swap64(ctx->aad_len * 8);
-	*(uint64_t *)(s+8) = swap64(xn * 8);
-	ghash(&ctx->h, s, &y);
-	*(uint128_t *)s = swap128(y);
+/*
+ * the key context: H, the GHASH tables and the H powers are computed once
+ * per key, the block cipher context must stay valid while key is used
+ */
+int  gcm_key_init(gcm_key_t *key, blk_ctx_t *cipher)
+{
+	assert(key);
+	assert(cipher);
+	assert(cipher->init);
 
-	xor128((uint128_t *)j0, (uint128_t *)s);
-	return memcmp(tag, s, ctx->tag_len);
+	memset(key, 0, sizeof(*key));
+	key->init   = gcm_key_init;
+	key->cipher = cipher;
+	/* get hash subkey */
+	key->h = 0;
+	cipher->encrypt(cipher, (uint8_t *)&key->h, 1);
+	key->h = swap128(key->h);
+	gcm_key_setup(key);
+	/* AES-NI round keys are there, CTR and GHASH can run in one pass */
+	if (key->ghash == ghash_clmul && cipher->init == (void *)aes_init
+	    && ((aes_ctx_t *)cipher)->impl == eAES_AESNI)
+		key->stitch = gcm_aesni_clmul;
+	return 0;
 }
 
-/* the aes_ctr->init must be set before call gmac_init() */
-int  gmac_init(gmac_ctx_t *ctx, uint8_t *iv, size_t iv_len, uint8_t *aad, size_t aad_len, int tag_len, blk_ctx_t *cipher)
+/* GHASH only key context, the hash subkey is given */
+int  gcm_key_init_h(gcm_key_t *key, const uint8_t h[16])
+{
+	assert(key);
+	assert(h);
+
+	memset(key, 0, sizeof(*key));
+	memcpy(&key->h, h, 16);
+	key->h = swap128(key->h);
+	gcm_key_setup(key);
+	return 0;
+}
+
+/*
+ * per-message state, no block cipher call for a 96-bit IV.
+ * aad may be NULL and be given later by gcm_aad()
+ */
+int  gcm_init(gmac_ctx_t *ctx, const gcm_key_t *key, uint8_t *iv, size_t iv_len, uint8_t *aad, size_t aad_len, int tag_len)
 {
 	uint8_t s[16];
 	uint128_t y;
 
 	assert(ctx);
+	assert(key);
 	assert(iv);
-	assert(aad);
-	assert(cipher);
-	assert(cipher->init);
+	assert(aad || !aad_len);
 
-	memset(ctx, 0, sizeof(*ctx));
+	/* the key context of gmac_init() at the end is left alone */
+	memset(ctx, 0, offsetof(gmac_ctx_t, own_key));
 	ctx->init    = gmac_init;
 	ctx->encrypt = gmac_encrypt;
 	ctx->decrypt = gmac_decrypt;
-	ctx->cipher  = cipher;
+	ctx->key     = key;
 	/* save length of tag */
 	ctx->tag_len = tag_len;
-	/* get hash subkey */
-	ctx->h = 0;
-	cipher->encrypt(cipher, (uint8_t *)&ctx->h, 1);
-	ctx->h = swap128(ctx->h);
 	/* prepare J0, the ICB  */
 	ctx->iv_len = iv_len;
 	if (iv_len == 12) { /* 96 bits */
@@ -196,35 +603,31 @@ int  gmac_init(gmac_ctx_t *ctx, uint8_t *iv, size_t iv_len, uint8_t *aad, size_t
 		memcpy(ctx->j0, iv, iv_len);
 	}
 	else {
-		iv_len /= 16;
 		y = 0;
-		while (iv_len--) {
-			ghash(&ctx->h, iv, &y);
-			iv += 16;
-		}
-		if (ctx->iv_len % 16) {
-			memset(s, 0, 16);
-			memcpy(s, iv, ctx->iv_len % 16);
-			ghash(&ctx->h, s, &y);
-		}
+		ghash_run(key, iv, iv_len, &y);
 		memset(s, 0, 16);
 		*(uint64_t *)(s + 8) = swap64(ctx->iv_len * 8);
-		ghash(&ctx->h, s, &y);
+		key->ghash(key, s, 1, &y);
 		*(uint128_t *)ctx->j0 = swap128(y);
 	}
+	/* the first data block uses inc32(J0) */
+	memcpy(ctx->ctr, ctx->j0, 16);
+	inc_ctr32(ctx->ctr, 1);
 	/* hash auth_data */
-	ctx->aad_len = aad_len;
-	aad_len /= 16;
-	y = 0;
-	while (aad_len--) {
-		ghash(&ctx->h, aad, &y);
-		aad += 16;
-	}
-	if (ctx->aad_len % 16) {
-		memset(s, 0, 16);
-		memcpy(s, aad, ctx->aad_len % 16);
-		ghash(&ctx->h, s, &y);
-	}
-	ctx->aad = y;
+	ctx->state = eGCM_AAD;
+	if (aad_len)
+		gcm_aad(ctx, aad, aad_len);
+	return 0;
 }
 
+/*
+ * the aes_ctr->init must be set before call gmac_init()
+ * the key context is set up in ctx itself, for one message
+ */
+int  gmac_init(gmac_ctx_t *ctx, uint8_t *iv, size_t iv_len, uint8_t *aad, size_t aad_len, int tag_len, blk_ctx_t *cipher)
+{
+	assert(ctx);
+
+	gcm_key_init(&ctx->own_key, cipher);
+	return gcm_init(ctx, &ctx->own_key, iv, iv_len, aad, aad_len, tag_len);
+}
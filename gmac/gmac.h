@@ -24,23 +24,102 @@
 #include "cipher-mode.h"
 #include "aes.h"
 
+#define GHASH_CLMUL_AGGR 8  /* blocks per reduction in the PCLMULQDQ GHASH */
+
+typedef struct gcm_key gcm_key_t;
 typedef struct gmac_ctx gmac_ctx_t;
 
+/* everything that depends only on the key, read-only once set up */
+struct gcm_key {
+	int  (*init)(gcm_key_t *key, blk_ctx_t *cipher);
+	/* y = (y ^ x) * H for each of the nblocks 16-byte blocks of x */
+	void (*ghash)(const gcm_key_t *key, uint8_t *x, size_t nblocks, uint128_t *y);
+	/*
+	 * optional one-pass CTR + GHASH over whole blocks of x, ctr is the counter
+	 * block of the first one. returns the number of blocks done, it is NULL
+	 * unless the cipher is AES-NI and GHASH uses PCLMULQDQ
+	 */
+	size_t (*stitch)(const gcm_key_t *key, uint8_t *ctr, uint8_t *x, size_t nblocks, int decrypt, uint128_t *y);
+	blk_ctx_t *cipher;
+	uint128_t h; /* hash_subkey */
+	uint128_t htable[16]; /* multiples of h for the 4-bit table GHASH */
+	uint128_t hpow[GHASH_CLMUL_AGGR]; /* H^1..H^8 for the PCLMULQDQ GHASH */
+};
+
+/* one message */
 struct gmac_ctx {
 	/* return the bytes of message digest */
 	int  (*init)(gmac_ctx_t *ctx, uint8_t *iv, size_t iv_len, uint8_t *aad, size_t aad_len, int tag_len, blk_ctx_t *cipher);
-	void (*encrypt)(gmac_ctx_t *ctx, uint8_t x[], size_t xn, uint8_t tag[]);
+	/* 0, -1 if ctx is finished or in the other direction, tag is not written then */
+	int  (*encrypt)(gmac_ctx_t *ctx, uint8_t x[], size_t xn, uint8_t tag[]);
 	int  (*decrypt)(gmac_ctx_t *ctx, uint8_t x[], size_t xn, uint8_t tag[]);
-	blk_ctx_t *cipher;
+	const gcm_key_t *key;
 	int    tag_len;
 	int    iv_len;
-	size_t aad_len;
 	uint8_t   j0[16];
-	uint128_t aad; /* authentication data */
-	uint128_t h; /* hash_subkey */
+	/* stream state */
+	int       state;
+	size_t    aad_len;
+	size_t    msg_len;
+	uint128_t y;           /* running GHASH */
+	uint8_t   ctr[16];     /* counter block of the next keystream block */
+	uint8_t   ks[16];      /* keystream of the partial block */
+	uint8_t   partial[16]; /* incomplete AAD or ciphertext block */
+	int       plen;        /* bytes in partial */
+	gcm_key_t own_key;     /* used by gmac_init() only */
 };
 
+/*
+ * key setup once, then any number of messages:
+ *     gcm_key_init(&key, cipher);
+ *     gcm_init(&ctx, &key, iv, ...); ctx.encrypt(&ctx, ...);
+ *     gcm_init(&ctx, &key, iv, ...); ...
+ * a key context can be shared by threads
+ */
+int  gcm_key_init(gcm_key_t *key, blk_ctx_t *cipher);
+int  gcm_init(gmac_ctx_t *ctx, const gcm_key_t *key, uint8_t *iv, size_t iv_len, uint8_t *aad, size_t aad_len, int tag_len);
+
+/*
+ * key->ghash() with the hash subkey h instead of E(K, 0^128), for other
+ * GF(2^128) hashes such as POLYVAL. the key has no cipher, no gcm_init()
+ */
+int  gcm_key_init_h(gcm_key_t *key, const uint8_t h[16]);
+
+/* gcm_key_init() and gcm_init() in one, for a single message */
 int  gmac_init(gmac_ctx_t *ctx, uint8_t *iv, size_t iv_len, uint8_t *aad, size_t aad_len, int tag_len, blk_ctx_t *cipher);
 
+/*
+ * streaming GCM, after gmac_init():
+ *     gcm_aad()    any number of times, any length
+ *     gcm_update() any number of times, any length, in place
+ *     gcm_final()  encrypt: writes tag_len bytes of tag
+ *                  decrypt: returns 0 if tag matches
+ * a streamed decryption hands out plaintext before the tag is checked,
+ * ctx->decrypt checks the tag first and leaves x alone if it doesn't match
+ * decrypt is 0 or 1 and must be the same in every call of a message.
+ * the result is the same as one ctx->encrypt/decrypt over the concatenation
+ */
+int  gcm_aad(gmac_ctx_t *ctx, uint8_t *aad, size_t len);
+int  gcm_update(gmac_ctx_t *ctx, uint8_t *x, size_t len, int decrypt);
+int  gcm_final(gmac_ctx_t *ctx, uint8_t tag[], int decrypt);
+
+/*
+ * one message out of place, from the in iovecs to the out iovecs after
+ * gmac_init()/gcm_init(), blocks may span elements. in and out may be
+ * the same buffers but must not overlap otherwise. returns the length,
+ * -1 if out is too short; decrypt returns -1 and wipes the output if
+ * the tag doesn't match
+ */
+ssize_t gcm_encrypt_iov(gmac_ctx_t *ctx, const struct iovec *in, int nin, struct iovec *out, int nout, uint8_t tag[]);
+ssize_t gcm_decrypt_iov(gmac_ctx_t *ctx, const struct iovec *in, int nin, struct iovec *out, int nout, uint8_t tag[]);
+
+/*
+ * same as ctx->encrypt/decrypt with the CTR and GHASH work split across
+ * nthreads threads, nthreads <= 0 uses all online CPUs, capped like
+ * ctr_encrypt_mt()
+ */
+int  gmac_encrypt_mt(gmac_ctx_t *ctx, uint8_t x[], size_t xn, uint8_t tag[], int nthreads);
+int  gmac_decrypt_mt(gmac_ctx_t *ctx, uint8_t x[], size_t xn, uint8_t tag[], int nthreads);
+
 #endif /* __GMAC_H__ */
 
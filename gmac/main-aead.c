@@ -0,0 +1,174 @@
+/*
+   Copyright 2020 Andrew Li, Gavin Li
+
+   li.andrew.mail@gmail.com
+   gavinux@gmail.com
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "sha-common.h"
+#include "aes.h"
+#include "ccm.h"
+#include "gcm-siv.h"
+
+struct aead_vect {
+	char *key, *nonce, *aad, *pt, *ct;  /* ct is the ciphertext || tag */
+	int  tag_len;
+};
+
+/* NIST SP 800-38C appendix C examples 1..3 */
+static struct aead_vect ccm_vects[] = {
+	{"404142434445464748494a4b4c4d4e4f", "10111213141516", "0001020304050607",
+	 "20212223", "7162015b4dac255d", 4},
+	{"404142434445464748494a4b4c4d4e4f", "1011121314151617", "000102030405060708090a0b0c0d0e0f",
+	 "202122232425262728292a2b2c2d2e2f", "d2a1f0e051ea5f62081a7792073d593d1fc64fbfaccd", 6},
+	{"404142434445464748494a4b4c4d4e4f", "101112131415161718191a1b", "000102030405060708090a0b0c0d0e0f10111213",
+	 "202122232425262728292a2b2c2d2e2f3031323334353637",
+	 "e3b201a9f5b71a7a9b1ceaeccd97e70b6176aad9a4428aa5484392fbc1b09951", 8},
+};
+
+/* RFC 8452 appendix C.1 and C.2 */
+static struct aead_vect siv_vects[] = {
+	{"01000000000000000000000000000000", "030000000000000000000000", "",
+	 "", "dc20e2d83f25705bb49e439eca56de25", 16},
+	{"01000000000000000000000000000000", "030000000000000000000000", "",
+	 "0100000000000000", "b5d839330ac7b786578782fff6013b815b287c22493a364c", 16},
+	{"01000000000000000000000000000000", "030000000000000000000000", "",
+	 "010000000000000000000000", "7323ea61d05932260047d942a4978db357391a0bc4fdec8b0d106639", 16},
+	{"01000000000000000000000000000000", "030000000000000000000000", "01",
+	 "0200000000000000", "1e6daba35669f4273b0a1a2560969cdf790d99759abd1508", 16},
+	{"0100000000000000000000000000000000000000000000000000000000000000", "030000000000000000000000", "",
+	 "", "07f5f4169bbf55a8400cd47ea6fd400f", 16},
+};
+
+static int run_vect(struct aead_vect *v, int siv)
+{
+	aes_ctx_t aes;
+	ccm_ctx_t ccm;
+	gcm_siv_ctx_t gs;
+	uint8_t key[32], nonce[16], aad[32], pt[32], ct[48], buf[32];
+	int keylen, nlen, alen, plen, ret;
+
+	keylen = hex2ba(v->key, key, sizeof(key));
+	nlen = hex2ba(v->nonce, nonce, sizeof(nonce));
+	alen = hex2ba(v->aad, aad, sizeof(aad));
+	plen = hex2ba(v->pt, pt, sizeof(pt));
+	hex2ba(v->ct, ct, sizeof(ct));
+	aes_init(&aes, key, keylen * 8);
+
+	memcpy(buf, pt, plen);
+	if (siv) {
+		gcm_siv_init(&gs, (blk_ctx_t *)&aes);
+		gs.encrypt(&gs, nonce, aad, alen, buf, plen, buf + plen);
+	} else {
+		ccm_init(&ccm, (blk_ctx_t *)&aes, nlen, v->tag_len);
+		ccm.encrypt(&ccm, nonce, aad, alen, buf, plen, buf + plen);
+	}
+	ret = memcmp(buf, ct, plen + v->tag_len);
+	if (siv)
+		ret |= gs.decrypt(&gs, nonce, aad, alen, buf, plen, buf + plen);
+	else
+		ret |= ccm.decrypt(&ccm, nonce, aad, alen, buf, plen, buf + plen);
+	return ret || memcmp(buf, pt, plen);
+}
+
+/* round trips of random messages, a wrong tag is rejected and x stays the ciphertext */
+static int run_random(int siv, int tests)
+{
+	aes_ctx_t aes;
+	ccm_ctx_t ccm;
+	gcm_siv_ctx_t gs;
+	static uint8_t aad[70000], pt[3000], buf[3000];
+	uint8_t key[32], nonce[13], tag[16];
+	size_t i, alen, plen;
+	int test, nlen, tlen, fail = 0;
+
+	for (test=0; test<tests; test++) {
+		for (i=0; i<sizeof(key); i++) key[i] = rand();
+		for (i=0; i<sizeof(nonce); i++) nonce[i] = rand();
+		for (i=0; i<sizeof(pt); i++) pt[i] = rand();
+		alen = test % 50 ? rand() % 100 : rand() % sizeof(aad);
+		plen = rand() % sizeof(pt);
+		for (i=0; i<alen; i++) aad[i] = rand();
+		aes_init(&aes, key, test % 2 ? 256 : 128);
+		nlen = 7 + test % 7;
+		tlen = siv ? 16 : 4 + test % 7 * 2;
+
+		memcpy(buf, pt, plen);
+		if (siv) {
+			gcm_siv_init(&gs, (blk_ctx_t *)&aes);
+			gs.encrypt(&gs, nonce, aad, alen, buf, plen, tag);
+		} else {
+			ccm_init(&ccm, (blk_ctx_t *)&aes, nlen, tlen);
+			ccm.encrypt(&ccm, nonce, aad, alen, buf, plen, tag);
+		}
+		tag[test % tlen] ^= 1;
+		if (!(siv ? gs.decrypt(&gs, nonce, aad, alen, buf, plen, tag)
+		          : ccm.decrypt(&ccm, nonce, aad, alen, buf, plen, tag))
+		    || (plen && !memcmp(buf, pt, plen))) {
+			printf("%s: bad tag accepted or plaintext released, test %d\n", siv ? "GCM-SIV" : "CCM", test);
+			fail = 1;
+		}
+		tag[test % tlen] ^= 1;
+		if ((siv ? gs.decrypt(&gs, nonce, aad, alen, buf, plen, tag)
+		         : ccm.decrypt(&ccm, nonce, aad, alen, buf, plen, tag))
+		    || memcmp(buf, pt, plen)) {
+			printf("%s: round trip failed, test %d\n", siv ? "GCM-SIV" : "CCM", test);
+			fail = 1;
+		}
+	}
+	return fail;
+}
+
+int main(int argc, char *argv[])
+{
+	uint8_t h[16], x[32], out[16], ref[16];
+	int i, fail = 0;
+
+	for (i=0; i<ARRAY_SIZE(ccm_vects); i++) {
+		if (run_vect(&ccm_vects[i], 0)) {
+			printf("CCM SP 800-38C example %d failed\n", i + 1);
+			fail = 1;
+		}
+	}
+
+	/* RFC 8452 appendix A */
+	hex2ba("25629347589242761d31f826ba4b757b", h, sizeof(h));
+	hex2ba("4f4f95668c83dfb6401762bb2d01a262d1a24ddd2721d006bbe45f20d3c9f362", x, sizeof(x));
+	hex2ba("f7a3b47b846119fae5b7866cf5e5b77e", ref, sizeof(ref));
+	polyval(h, x, sizeof(x), out);
+	if (memcmp(out, ref, sizeof(ref))) {
+		printf("POLYVAL RFC 8452 appendix A failed\n");
+		fail = 1;
+	}
+
+	for (i=0; i<ARRAY_SIZE(siv_vects); i++) {
+		if (run_vect(&siv_vects[i], 1)) {
+			printf("GCM-SIV RFC 8452 vector %d failed\n", i + 1);
+			fail = 1;
+		}
+	}
+
+	srand(3);
+	fail |= run_random(0, 500);
+	fail |= run_random(1, 500);
+
+	if (fail) exit(-1);
+	printf("ALL CCM/GCM-SIV TESTS PASSED!\n");
+	return 0;
+}
@@ -0,0 +1,182 @@
+/*
+   Copyright 2020 Andrew Li, Gavin Li
+
+   li.andrew.mail@gmail.com
+   gavinux@gmail.com
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "sha-common.h"
+#include "aes.h"
+#include "cipher-mode.h"
+#include "gmac.h"
+
+#define BUF_SIZE  (4 * 1024 * 1024 + 13)  /* not a multiple of the block size */
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * callers running at the same time share the worker pool, each one
+ * must still get its own result
+ */
+#define NCALLERS 4
+
+struct caller {
+	aes_ctx_t *aes;
+	uint8_t   *iv, *aad, *pt, *ref, *tag;
+	uint8_t   *buf;
+	int        fail;
+};
+
+static void *caller(void *arg)
+{
+	struct caller *c = arg;
+	gmac_ctx_t gcm;
+	uint8_t tag[16];
+	int i;
+
+	for (i=0; i<8; i++) {
+		memcpy(c->buf, c->pt, BUF_SIZE);
+		gmac_init(&gcm, c->iv, 12, c->aad, 20, 16, (blk_ctx_t *)c->aes);
+		gmac_encrypt_mt(&gcm, c->buf, BUF_SIZE, tag, 4);
+		if (memcmp(c->buf, c->ref, BUF_SIZE) || memcmp(tag, c->tag, 16))
+			c->fail = 1;
+	}
+	return NULL;
+}
+
+/*
+ * the multi-threaded CTR and GCM paths must produce exactly the bytes
+ * and tags of the single-threaded ones, for any thread count
+ */
+int main(int argc, char *argv[])
+{
+	aes_ctx_t    aes;
+	cipher_ctx_t ctr;
+	gmac_ctx_t   gcm;
+	uint8_t key[32], iv[16], aad[20], tag[16], newtag[16];
+	uint8_t *pt, *ref, *buf;
+	size_t  i, len;
+	int     t, fail = 0;
+	struct caller c[NCALLERS];
+	pthread_t tid[NCALLERS];
+	int     started[NCALLERS];
+	double  dt, base = 0;
+	int     threads[] = {1, 2, 3, 4, 7, 8, 0};
+	size_t  lens[] = {0, 100, 64 * 1024 * 3 + 5, BUF_SIZE};
+	double  t0;
+
+	pt  = malloc(BUF_SIZE);
+	ref = malloc(BUF_SIZE);
+	buf = malloc(BUF_SIZE);
+	srand(1);
+	for (i=0; i<BUF_SIZE; i++) pt[i] = rand();
+	for (i=0; i<sizeof(key); i++) key[i] = rand();
+	for (i=0; i<sizeof(aad); i++) aad[i] = rand();
+	for (i=0; i<sizeof(iv); i++) iv[i] = rand();
+	/* the 32-bit counter wraps within the buffer */
+	memset(iv + 12, 0xff, 3);
+	aes_init(&aes, key, 256);
+
+	for (i=0; i<ARRAY_SIZE(lens); i++) {
+		len = lens[i];
+
+		memcpy(ref, pt, len);
+		ctr_init(&ctr, (blk_ctx_t *)&aes, NULL, iv);
+		ctr.encrypt(&ctr, ref, len);
+		for (t=0; t<ARRAY_SIZE(threads); t++) {
+			memcpy(buf, pt, len);
+			ctr_init(&ctr, (blk_ctx_t *)&aes, NULL, iv);
+			ctr_encrypt_mt(&ctr, buf, len, threads[t]);
+			if (memcmp(buf, ref, len)) {
+				printf("ctr_encrypt_mt failed, len %zu threads %d\n", len, threads[t]);
+				fail = 1;
+			}
+		}
+
+		memcpy(ref, pt, len);
+		gmac_init(&gcm, iv, 12, aad, sizeof(aad), 16, (blk_ctx_t *)&aes);
+		gcm.encrypt(&gcm, ref, len, tag);
+		for (t=0; t<ARRAY_SIZE(threads); t++) {
+			memcpy(buf, pt, len);
+			gmac_init(&gcm, iv, 12, aad, sizeof(aad), 16, (blk_ctx_t *)&aes);
+			gmac_encrypt_mt(&gcm, buf, len, newtag, threads[t]);
+			if (memcmp(buf, ref, len) || memcmp(tag, newtag, 16)) {
+				printf("gmac_encrypt_mt failed, len %zu threads %d\n", len, threads[t]);
+				fail = 1;
+			}
+			gmac_init(&gcm, iv, 12, aad, sizeof(aad), 16, (blk_ctx_t *)&aes);
+			if (gmac_decrypt_mt(&gcm, buf, len, tag, threads[t]) || memcmp(buf, pt, len)) {
+				printf("gmac_decrypt_mt failed, len %zu threads %d\n", len, threads[t]);
+				fail = 1;
+			}
+		}
+	}
+	if (fail) exit(-1);
+	printf("multi-threaded CTR/GCM match single-threaded\n");
+
+	/* ref and tag still hold the single-threaded GCM of BUF_SIZE bytes */
+	for (t=0; t<NCALLERS; t++) {
+		c[t].aes  = &aes;
+		c[t].iv   = iv;
+		c[t].aad  = aad;
+		c[t].pt   = pt;
+		c[t].ref  = ref;
+		c[t].tag  = tag;
+		c[t].buf  = malloc(BUF_SIZE);
+		c[t].fail = 0;
+		started[t] = !pthread_create(&tid[t], NULL, caller, &c[t]);
+	}
+	for (t=0; t<NCALLERS; t++) {
+		if (started[t])
+			pthread_join(tid[t], NULL);
+		else
+			caller(&c[t]);
+		fail |= c[t].fail;
+		free(c[t].buf);
+	}
+	if (fail) {
+		printf("concurrent gmac_encrypt_mt callers failed\n");
+		exit(-1);
+	}
+	printf("%d concurrent callers match single-threaded\n", NCALLERS);
+
+	/* best of 5, the speedup is against 1 thread */
+	for (t=0; t<ARRAY_SIZE(threads); t++) {
+		for (i=0, dt=1e9; i<5; i++) {
+			gmac_init(&gcm, iv, 12, aad, sizeof(aad), 16, (blk_ctx_t *)&aes);
+			t0 = now();
+			gmac_encrypt_mt(&gcm, buf, BUF_SIZE, newtag, threads[t]);
+			t0 = now() - t0;
+			if (t0 < dt) dt = t0;
+		}
+		if (!base) base = dt;
+		printf("GCM %d threads: %.1f MB/s, %.2fx\n", threads[t], BUF_SIZE / dt / 1e6, base / dt);
+	}
+	free(pt);
+	free(ref);
+	free(buf);
+	return 0;
+}
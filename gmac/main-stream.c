@@ -0,0 +1,179 @@
+/*
+   Copyright 2020 Andrew Li, Gavin Li
+
+   li.andrew.mail@gmail.com
+   gavinux@gmail.com
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "sha-common.h"
+#include "aes.h"
+#include "gmac.h"
+
+#define MAX_LEN 2000
+
+/* feeds len bytes in random pieces, 0 bytes pieces included */
+static size_t piece(size_t left)
+{
+	size_t n = rand() % 4 ? rand() % 40 : rand() % 400;
+	return n < left ? n : left;
+}
+
+/* cuts len bytes of buf into random pieces, at most n iovecs */
+static int split_iov(uint8_t *buf, size_t len, struct iovec *v, int n)
+{
+	int i;
+
+	for (i=0; i<n-1 && len; i++) {
+		v[i].iov_base = buf;
+		v[i].iov_len  = piece(len);
+		buf += v[i].iov_len;
+		len -= v[i].iov_len;
+	}
+	v[i].iov_base = buf;
+	v[i].iov_len  = len;
+	return i + 1;
+}
+
+/*
+ * gcm_aad/gcm_update/gcm_final with random chunking must give
+ * the same ciphertext and tag as one ctx.encrypt/decrypt call,
+ * with gmac_init() or with a reused gcm_key_init() key context,
+ * a one shot decrypt with a wrong tag must leave the ciphertext as is,
+ * a finished context must refuse to encrypt again and leave tag alone.
+ * gcm_encrypt_iov/gcm_decrypt_iov on random iovecs too
+ */
+int main(int argc, char *argv[])
+{
+	aes_ctx_t    aes;
+	gmac_ctx_t   ctx;
+	gcm_key_t    gkey;
+	uint8_t key[32], iv[60], aad[MAX_LEN], pt[MAX_LEN], ref[MAX_LEN], buf[MAX_LEN];
+	uint8_t tag[16], newtag[16], out[MAX_LEN];
+	struct iovec vin[64], vout[64];
+	int     nin, nout;
+	size_t  i, n, ivlen, aadlen, len;
+	int     test, fail = 0;
+
+	srand(2);
+	for (test=0; test<2000; test++) {
+		for (i=0; i<sizeof(key); i++) key[i] = rand();
+		for (i=0; i<sizeof(iv); i++) iv[i] = rand();
+		for (i=0; i<MAX_LEN; i++) aad[i] = rand(), pt[i] = rand();
+		ivlen  = test % 3 ? 12 : 1 + rand() % sizeof(iv);
+		aadlen = rand() % 3 ? rand() % 70 : rand() % MAX_LEN;
+		len    = rand() % 3 ? rand() % 70 : rand() % MAX_LEN;
+		aes_init(&aes, key, 128 + 64 * (test % 3));
+
+		/* one shot */
+		memcpy(ref, pt, len);
+		gmac_init(&ctx, iv, ivlen, aad, aadlen, 16, (blk_ctx_t *)&aes);
+		ctx.encrypt(&ctx, ref, len, tag);
+
+		/* streaming encrypt, part of the AAD may come with init */
+		memcpy(buf, pt, len);
+		n = rand() % 2 ? piece(aadlen) : 0;
+		gmac_init(&ctx, iv, ivlen, aad, n, 16, (blk_ctx_t *)&aes);
+		for (i=n; i<aadlen; i+=n)
+			gcm_aad(&ctx, aad + i, n = piece(aadlen - i));
+		for (i=0; i<len; i+=n)
+			gcm_update(&ctx, buf + i, n = piece(len - i), 0);
+		gcm_final(&ctx, newtag, 0);
+		if (memcmp(buf, ref, len) || memcmp(tag, newtag, 16)) {
+			printf("streaming encrypt failed, test %d\n", test);
+			fail = 1;
+		}
+
+		/* out of place on iovecs */
+		gmac_init(&ctx, iv, ivlen, aad, aadlen, 16, (blk_ctx_t *)&aes);
+		nin  = split_iov(pt, len, vin, 64);
+		nout = split_iov(out, len, vout, 64);
+		if (gcm_encrypt_iov(&ctx, vin, nin, vout, nout, newtag) != len
+		    || memcmp(out, ref, len) || memcmp(tag, newtag, 16)) {
+			printf("iovec encrypt failed, test %d\n", test);
+			fail = 1;
+		}
+		gmac_init(&ctx, iv, ivlen, aad, aadlen, 16, (blk_ctx_t *)&aes);
+		nin  = split_iov(ref, len, vin, 64);
+		nout = split_iov(out, len, vout, 64);
+		if (gcm_decrypt_iov(&ctx, vin, nin, vout, nout, tag) != len || memcmp(out, pt, len)) {
+			printf("iovec decrypt failed, test %d\n", test);
+			fail = 1;
+		}
+		newtag[0] ^= 1;
+		gmac_init(&ctx, iv, ivlen, aad, aadlen, 16, (blk_ctx_t *)&aes);
+		n = gcm_decrypt_iov(&ctx, vin, nin, vout, nout, newtag) != -1;
+		for (i=0; i<len; i++)
+			n |= out[i];
+		if (n) {
+			printf("iovec decrypt with bad tag failed, test %d\n", test);
+			fail = 1;
+		}
+
+		/* streaming decrypt, with a key context set up separately */
+		gcm_key_init(&gkey, (blk_ctx_t *)&aes);
+		gcm_init(&ctx, &gkey, iv, ivlen, NULL, 0, 16);
+		for (i=0; i<aadlen; i+=n)
+			gcm_aad(&ctx, aad + i, n = piece(aadlen - i));
+		for (i=0; i<len; i+=n)
+			gcm_update(&ctx, buf + i, n = piece(len - i), 1);
+		if (gcm_final(&ctx, tag, 1) || memcmp(buf, pt, len)) {
+			printf("streaming decrypt failed, test %d\n", test);
+			fail = 1;
+		}
+
+		/* one shot decrypt checks the tag before it decrypts */
+		memcpy(buf, ref, len);
+		gcm_init(&ctx, &gkey, iv, ivlen, aad, aadlen, 16);
+		if (ctx.decrypt(&ctx, buf, len, tag) || memcmp(buf, pt, len)) {
+			printf("one shot decrypt failed, test %d\n", test);
+			fail = 1;
+		}
+
+		/* a wrong tag is rejected, the key context is reused */
+		tag[test % 16] ^= 1;
+		memcpy(buf, ref, len);
+		gcm_init(&ctx, &gkey, iv, ivlen, aad, aadlen, 16);
+		if (!ctx.decrypt(&ctx, buf, len, tag) || memcmp(buf, ref, len)) {
+			printf("bad tag accepted or plaintext released, test %d\n", test);
+			fail = 1;
+		}
+		gcm_init(&ctx, &gkey, iv, ivlen, aad, aadlen, 16);
+		gcm_update(&ctx, ref, len, 1);
+		if (!gcm_final(&ctx, tag, 1)) {
+			printf("bad tag accepted, test %d\n", test);
+			fail = 1;
+		}
+
+		/* the message is finished, another encrypt fails */
+		memcpy(buf, pt, len);
+		gmac_init(&ctx, iv, ivlen, aad, aadlen, 16, (blk_ctx_t *)&aes);
+		n = ctx.encrypt(&ctx, buf, len, newtag);
+		memset(newtag, 0xa5, sizeof(newtag));
+		n |= ctx.encrypt(&ctx, buf, len, newtag) != -1 || gmac_encrypt_mt(&ctx, buf, len, newtag, 2) != -1;
+		for (i=0; i<sizeof(newtag); i++)
+			n |= newtag[i] != 0xa5;
+		if (n) {
+			printf("encrypt on a finished context failed, test %d\n", test);
+			fail = 1;
+		}
+	}
+	if (fail) exit(-1);
+	printf("ALL GCM STREAMING TESTS PASSED!\n");
+	return 0;
+}
@@ -29,7 +29,41 @@
 
 #define DGST_BYTES (SHA1_DIGEST_LENGTH/8) /* it is ctx.md_len / 8 */
 
-int main(int argc, char *argv[])
+/* the same vectors hashed by openssl */
+static const uint8_t dgst1[DGST_BYTES] = {
+	0xda, 0x39, 0xa3, 0xee, 0x5e, 0x6b, 0x4b, 0x0d,
+	0x32, 0x55, 0xbf, 0xef, 0x95, 0x60, 0x18, 0x90,
+	0xaf, 0xd8, 0x07, 0x09
+};
+static const uint8_t dgst2[DGST_BYTES] = {
+	0xa9, 0x99, 0x3e, 0x36, 0x47, 0x06, 0x81, 0x6a,
+	0xba, 0x3e, 0x25, 0x71, 0x78, 0x50, 0xc2, 0x6c,
+	0x9c, 0xd0, 0xd8, 0x9d
+};
+static const uint8_t dgst3[DGST_BYTES] = {
+	0x3f, 0xae, 0x9a, 0x1d, 0x09, 0x8e, 0x1a, 0x1d,
+	0x9e, 0x12, 0x6b, 0xa9, 0x5c, 0x85, 0x3b, 0xb4,
+	0x5d, 0x8c, 0x15, 0xfa
+};
+static const uint8_t dgst4[DGST_BYTES] = {
+	0x84, 0x15, 0x2e, 0xea, 0xa7, 0x61, 0x82, 0x2f,
+	0x5f, 0x35, 0x3c, 0xfe, 0xa5, 0xbd, 0xa9, 0x3f,
+	0x69, 0x7d, 0x89, 0x30
+};
+static const uint8_t dgst5[DGST_BYTES] = {
+	0x34, 0xaa, 0x97, 0x3c, 0xd4, 0xc4, 0xda, 0xa4,
+	0xf6, 0x1e, 0xeb, 0x2b, 0xdb, 0xad, 0x27, 0x31,
+	0x65, 0x34, 0x01, 0x6f
+};
+static const uint8_t dgst6[DGST_BYTES] = {
+	0x82, 0x3f, 0x54, 0x38, 0x1d, 0xd9, 0xe4, 0x5b,
+	0x81, 0xa2, 0x69, 0xde, 0x72, 0x05, 0x61, 0x7e,
+	0xf1, 0x44, 0x93, 0x49
+};
+
+static uint8_t vect5[1000000];
+
+static void run_tests(void)
 {
 	int i;
 	sha1_ctx_t ctx;
@@ -38,15 +72,7 @@ int main(int argc, char *argv[])
 	uint8_t vect3[] = {"qwertyuiopasdfghjklzxcvbnmdfghjjhfsweryggfffffqsgsgrkart"};
 	uint8_t vect4a[] = {"reuowroeruouirdfnfdjfdjdfljkfflkdjfljkfjsdjldfjlfdjf"};
 	uint8_t vect4b[] = {"thisisatestvectorfortestvectorfourbwhichisanactualsentencedf"};
-	uint8_t vect5[1000000];
 	uint8_t vect6[] = {"testdksllkasdlakldlkjkdlluerymnbmvxeuwqtgfdjgfuopghdjscvxcvsgdah"};
-
-	uint8_t dgst1[DGST_BYTES];
-	uint8_t dgst2[DGST_BYTES];
-	uint8_t dgst3[DGST_BYTES];
-	uint8_t dgst4[DGST_BYTES];
-	uint8_t dgst5[DGST_BYTES];
-	uint8_t dgst6[DGST_BYTES];
 	uint8_t digest[DGST_BYTES];
 
 	memset(vect5, 'a', sizeof(vect5));
@@ -54,37 +80,53 @@ int main(int argc, char *argv[])
 
 	ctx.update(&ctx, vect1, 0);
 	ctx.final(&ctx, digest);
-	memcpy(dgst1, digest, DGST_BYTES);
 	assert(!memcmp(digest, dgst1, DGST_BYTES));
 
 	ctx.update(&ctx, vect2, strlen(vect2));
 	ctx.final(&ctx, digest);
-	memcpy(dgst2, digest, DGST_BYTES);
 	assert(!memcmp(digest, dgst2, DGST_BYTES));
 
 	ctx.update(&ctx, vect3, strlen(vect3));
 	ctx.final(&ctx, digest);
-	memcpy(dgst3, digest, DGST_BYTES);
 	assert(!memcmp(digest, dgst3, DGST_BYTES));
 
 	ctx.update(&ctx, vect4a, strlen(vect4a));
 	ctx.update(&ctx, vect4b, strlen(vect4b));
 	ctx.final(&ctx, digest);
-	memcpy(dgst4, digest, DGST_BYTES);
 	assert(!memcmp(digest, dgst4, DGST_BYTES));
 
 	ctx.update(&ctx, vect5, sizeof(vect5));
 	ctx.final(&ctx, digest);
-	memcpy(dgst5, digest, DGST_BYTES);
 	assert(!memcmp(digest, dgst5, DGST_BYTES));
 
 	for (i=0; i<16777216; i++)
 		ctx.update(&ctx, vect6, strlen(vect6));
 	ctx.final(&ctx, digest);
-	memcpy(dgst6, digest, DGST_BYTES);
 	assert(!memcmp(digest, dgst6, DGST_BYTES));
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct {
+		enum sha1_impl impl;
+		const char *name;
+	} impls[] = {
+		{ eSHA1_PORTABLE, "portable" },
+		{ eSHA1_SHA_NI,   "sha-ni" },
+	};
+	int i;
+
+	/* every block function this CPU can run */
+	for (i=0; i<ARRAY_SIZE(impls); i++) {
+		if (sha1_impl(impls[i].impl)) {
+			printf("%s: not supported by this CPU\n", impls[i].name);
+			continue;
+		}
+		run_tests();
+		printf("%s: passed\n", impls[i].name);
+	}
+	sha1_impl(eSHA1_AUTO);
 
 	printf("ALL TESTS PASSED!\n");
 	return 0;
 }
-
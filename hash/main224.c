@@ -30,7 +30,47 @@
 
 #define DGST_BYTES (SHA224_DIGEST_LENGTH/8) /* it is ctx.md_len / 8 */
 
-int main(int argc, char *argv[])
+/* the same vectors hashed by openssl */
+static const uint8_t dgst1[DGST_BYTES] = {
+	0xd1, 0x4a, 0x02, 0x8c, 0x2a, 0x3a, 0x2b, 0xc9,
+	0x47, 0x61, 0x02, 0xbb, 0x28, 0x82, 0x34, 0xc4,
+	0x15, 0xa2, 0xb0, 0x1f, 0x82, 0x8e, 0xa6, 0x2a,
+	0xc5, 0xb3, 0xe4, 0x2f
+};
+static const uint8_t dgst2[DGST_BYTES] = {
+	0x23, 0x09, 0x7d, 0x22, 0x34, 0x05, 0xd8, 0x22,
+	0x86, 0x42, 0xa4, 0x77, 0xbd, 0xa2, 0x55, 0xb3,
+	0x2a, 0xad, 0xbc, 0xe4, 0xbd, 0xa0, 0xb3, 0xf7,
+	0xe3, 0x6c, 0x9d, 0xa7
+};
+static const uint8_t dgst3[DGST_BYTES] = {
+	0xfb, 0x68, 0x69, 0xaf, 0x0b, 0xc8, 0xcc, 0x01,
+	0x6d, 0x8b, 0x19, 0xd5, 0x1e, 0xc9, 0x34, 0x6f,
+	0x80, 0x2d, 0x58, 0x03, 0xf1, 0x4a, 0x80, 0x73,
+	0x59, 0xe8, 0xb7, 0x4b
+};
+static const uint8_t dgst4[DGST_BYTES] = {
+	0x85, 0xd7, 0xe0, 0x88, 0xe6, 0x06, 0xd0, 0xc0,
+	0x08, 0x8e, 0x18, 0xb6, 0xba, 0xdf, 0xb0, 0xef,
+	0x79, 0x38, 0x5e, 0xc1, 0x7c, 0x1c, 0x5c, 0xb5,
+	0x3d, 0xe4, 0x35, 0xc8
+};
+static const uint8_t dgst5[DGST_BYTES] = {
+	0x20, 0x79, 0x46, 0x55, 0x98, 0x0c, 0x91, 0xd8,
+	0xbb, 0xb4, 0xc1, 0xea, 0x97, 0x61, 0x8a, 0x4b,
+	0xf0, 0x3f, 0x42, 0x58, 0x19, 0x48, 0xb2, 0xee,
+	0x4e, 0xe7, 0xad, 0x67
+};
+static const uint8_t dgst6[DGST_BYTES] = {
+	0x9a, 0xd2, 0x67, 0x0a, 0x77, 0x26, 0xb0, 0xad,
+	0x68, 0x31, 0x3e, 0xab, 0xc0, 0xd1, 0x39, 0xc5,
+	0x58, 0x35, 0xe0, 0xc8, 0x83, 0x0f, 0xc5, 0x04,
+	0xd7, 0x0f, 0xf1, 0x95
+};
+
+static uint8_t vect5[1000000];
+
+static void run_tests(void)
 {
 	int i;
 	sha256_ctx_t ctx;
@@ -39,15 +79,7 @@ int main(int argc, char *argv[])
 	uint8_t vect3[] = {"qwertyuiopasdfghjklzxcvbnmdfghjjhfsweryggfffffqsgsgrkart"};
 	uint8_t vect4a[] = {"reuowroeruouirdfnfdjfdjdfljkfflkdjfljkfjsdjldfjlfdjf"};
 	uint8_t vect4b[] = {"thisisatestvectorfortestvectorfourbwhichisanactualsentencedf"};
-	uint8_t vect5[1000000];
 	uint8_t vect6[] = {"testdksllkasdlakldlkjkdlluerymnbmvxeuwqtgfdjgfuopghdjscvxcvsgdah"};
-
-	uint8_t dgst1[DGST_BYTES];
-	uint8_t dgst2[DGST_BYTES];
-	uint8_t dgst3[DGST_BYTES];
-	uint8_t dgst4[DGST_BYTES];
-	uint8_t dgst5[DGST_BYTES];
-	uint8_t dgst6[DGST_BYTES];
 	uint8_t digest[DGST_BYTES];
 
 	memset(vect5, 'a', sizeof(vect5));
@@ -55,37 +87,53 @@ int main(int argc, char *argv[])
 
 	ctx.update(&ctx, vect1, 0);
 	ctx.final(&ctx, digest);
-	memcpy(dgst1, digest, DGST_BYTES);
 	assert(!memcmp(digest, dgst1, DGST_BYTES));
 
 	ctx.update(&ctx, vect2, strlen(vect2));
 	ctx.final(&ctx, digest);
-	memcpy(dgst2, digest, DGST_BYTES);
 	assert(!memcmp(digest, dgst2, DGST_BYTES));
 
 	ctx.update(&ctx, vect3, strlen(vect3));
 	ctx.final(&ctx, digest);
-	memcpy(dgst3, digest, DGST_BYTES);
 	assert(!memcmp(digest, dgst3, DGST_BYTES));
 
 	ctx.update(&ctx, vect4a, strlen(vect4a));
 	ctx.update(&ctx, vect4b, strlen(vect4b));
 	ctx.final(&ctx, digest);
-	memcpy(dgst4, digest, DGST_BYTES);
 	assert(!memcmp(digest, dgst4, DGST_BYTES));
 
 	ctx.update(&ctx, vect5, sizeof(vect5));
 	ctx.final(&ctx, digest);
-	memcpy(dgst5, digest, DGST_BYTES);
 	assert(!memcmp(digest, dgst5, DGST_BYTES));
 
 	for (i=0; i<16777216; i++)
 		ctx.update(&ctx, vect6, strlen(vect6));
 	ctx.final(&ctx, digest);
-	memcpy(dgst6, digest, DGST_BYTES);
 	assert(!memcmp(digest, dgst6, DGST_BYTES));
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct {
+		enum sha256_impl impl;
+		const char *name;
+	} impls[] = {
+		{ eSHA256_PORTABLE, "portable" },
+		{ eSHA256_SHA_NI,   "sha-ni" },
+	};
+	int i;
+
+	/* every block function this CPU can run */
+	for (i=0; i<ARRAY_SIZE(impls); i++) {
+		if (sha256_impl(impls[i].impl)) {
+			printf("%s: not supported by this CPU\n", impls[i].name);
+			continue;
+		}
+		run_tests();
+		printf("%s: passed\n", impls[i].name);
+	}
+	sha256_impl(eSHA256_AUTO);
 
 	printf("ALL TESTS PASSED!\n");
 	return 0;
 }
-
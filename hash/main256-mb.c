@@ -0,0 +1,82 @@
+/*
+   Copyright 2020 Andrew Li, Gavin Li
+
+   li.andrew.mail@gmail.com
+   gavinux@gmail.com
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sha256.h"
+
+#define DGST_BYTES (SHA256_DIGEST_LENGTH/8)
+#define MAX_MSGS   100
+#define MAX_LEN    300
+
+/*
+ * sha256_mb() with every lane width the CPU has must give the digests
+ * of sha256 one message at a time, for uneven lengths around the
+ * padding boundaries and for fewer messages than lanes
+ */
+int main(int argc, char *argv[])
+{
+	static uint8_t buf[MAX_MSGS][MAX_LEN];
+	static uint8_t digest[MAX_MSGS][DGST_BYTES], ref[MAX_MSGS][DGST_BYTES];
+	uint8_t *data[MAX_MSGS];
+	size_t   len[MAX_MSGS];
+	uint8_t  abc[] = {"abc"};
+	uint8_t  abc_md[] = {
+		0xba, 0x78, 0x16, 0xbf, 0x8f, 0x01, 0xcf, 0xea, 0x41, 0x41, 0x40, 0xde, 0x5d, 0xae, 0x22, 0x23,
+		0xb0, 0x03, 0x61, 0xa3, 0x96, 0x17, 0x7a, 0x9c, 0xb4, 0x10, 0xff, 0x61, 0xf2, 0x00, 0x15, 0xad
+	};
+	sha256_ctx_t ctx;
+	enum sha256_mb_impl impl;
+	int i, j, n, test, fail = 0;
+
+	data[0] = abc;
+	len[0]  = 3;
+	sha256_mb(data, len, 1, digest);
+	if (memcmp(digest[0], abc_md, DGST_BYTES)) {
+		printf("sha256_mb(\"abc\") failed\n");
+		fail = 1;
+	}
+
+	srand(1);
+	sha256_init(&ctx);
+	for (test=0; test<200; test++) {
+		n = test < 20 ? test : 1 + rand() % MAX_MSGS;
+		for (i=0; i<n; i++) {
+			data[i] = buf[i];
+			len[i]  = rand() % 2 ? 50 + rand() % 20 : rand() % MAX_LEN;
+			for (j=0; j<len[i]; j++)
+				buf[i][j] = rand();
+			ctx.update(&ctx, data[i], len[i]);
+			ctx.final(&ctx, ref[i]);
+		}
+		for (impl=eSHA256_MB_AUTO; impl<=eSHA256_MB_X16; impl++) {
+			memset(digest, 0, sizeof(digest));
+			if (sha256_mb_impl(data, len, n, digest, impl))
+				continue; /* the CPU can't */
+			if (memcmp(digest, ref, n * DGST_BYTES)) {
+				printf("multi-buffer failed, impl %d, test %d\n", impl, test);
+				fail = 1;
+			}
+		}
+	}
+	if (fail) exit(-1);
+	printf("ALL TESTS PASSED!\n");
+	return 0;
+}
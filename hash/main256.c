@@ -30,7 +30,47 @@
 
 #define DGST_BYTES (SHA256_DIGEST_LENGTH/8) /* it is ctx.md_len / 8 */
 
-int main(int argc, char *argv[])
+/* the same vectors hashed by openssl */
+static const uint8_t dgst1[DGST_BYTES] = {
+	0xe3, 0xb0, 0xc4, 0x42, 0x98, 0xfc, 0x1c, 0x14,
+	0x9a, 0xfb, 0xf4, 0xc8, 0x99, 0x6f, 0xb9, 0x24,
+	0x27, 0xae, 0x41, 0xe4, 0x64, 0x9b, 0x93, 0x4c,
+	0xa4, 0x95, 0x99, 0x1b, 0x78, 0x52, 0xb8, 0x55
+};
+static const uint8_t dgst2[DGST_BYTES] = {
+	0xba, 0x78, 0x16, 0xbf, 0x8f, 0x01, 0xcf, 0xea,
+	0x41, 0x41, 0x40, 0xde, 0x5d, 0xae, 0x22, 0x23,
+	0xb0, 0x03, 0x61, 0xa3, 0x96, 0x17, 0x7a, 0x9c,
+	0xb4, 0x10, 0xff, 0x61, 0xf2, 0x00, 0x15, 0xad
+};
+static const uint8_t dgst3[DGST_BYTES] = {
+	0x3f, 0x38, 0x7d, 0x6e, 0xf1, 0x23, 0x1e, 0xe7,
+	0xd8, 0xed, 0x5b, 0xcd, 0x32, 0x7e, 0x50, 0xf8,
+	0xe1, 0x6e, 0x0f, 0x31, 0x37, 0x80, 0x6e, 0x17,
+	0x02, 0x61, 0x05, 0x6e, 0x0b, 0xc6, 0xd7, 0xc8
+};
+static const uint8_t dgst4[DGST_BYTES] = {
+	0xa8, 0xb2, 0x1a, 0x3a, 0xef, 0x55, 0x16, 0xc8,
+	0x00, 0xcf, 0x41, 0x4e, 0x8c, 0xec, 0x2a, 0xed,
+	0x93, 0xc5, 0xe2, 0x31, 0xf2, 0xbb, 0x00, 0xf2,
+	0x6f, 0x11, 0xb7, 0x0e, 0x62, 0xf1, 0x3d, 0xbb
+};
+static const uint8_t dgst5[DGST_BYTES] = {
+	0xcd, 0xc7, 0x6e, 0x5c, 0x99, 0x14, 0xfb, 0x92,
+	0x81, 0xa1, 0xc7, 0xe2, 0x84, 0xd7, 0x3e, 0x67,
+	0xf1, 0x80, 0x9a, 0x48, 0xa4, 0x97, 0x20, 0x0e,
+	0x04, 0x6d, 0x39, 0xcc, 0xc7, 0x11, 0x2c, 0xd0
+};
+static const uint8_t dgst6[DGST_BYTES] = {
+	0xa4, 0xef, 0x8f, 0xb1, 0xf2, 0x26, 0x99, 0xf6,
+	0x71, 0x6c, 0xe2, 0xaf, 0x30, 0x44, 0x4c, 0xdd,
+	0x33, 0xd1, 0xce, 0x84, 0x50, 0x0b, 0xab, 0xcf,
+	0xe2, 0x07, 0xaa, 0x01, 0xa6, 0xbe, 0x63, 0x1b
+};
+
+static uint8_t vect5[1000000];
+
+static void run_tests(void)
 {
 	int i;
 	sha256_ctx_t ctx;
@@ -39,15 +79,7 @@ int main(int argc, char *argv[])
 	uint8_t vect3[] = {"qwertyuiopasdfghjklzxcvbnmdfghjjhfsweryggfffffqsgsgrkart"};
 	uint8_t vect4a[] = {"reuowroeruouirdfnfdjfdjdfljkfflkdjfljkfjsdjldfjlfdjf"};
 	uint8_t vect4b[] = {"thisisatestvectorfortestvectorfourbwhichisanactualsentencedf"};
-	uint8_t vect5[1000000];
 	uint8_t vect6[] = {"testdksllkasdlakldlkjkdlluerymnbmvxeuwqtgfdjgfuopghdjscvxcvsgdah"};
-
-	uint8_t dgst1[DGST_BYTES];
-	uint8_t dgst2[DGST_BYTES];
-	uint8_t dgst3[DGST_BYTES];
-	uint8_t dgst4[DGST_BYTES];
-	uint8_t dgst5[DGST_BYTES];
-	uint8_t dgst6[DGST_BYTES];
 	uint8_t digest[DGST_BYTES];
 
 	memset(vect5, 'a', sizeof(vect5));
@@ -55,37 +87,53 @@ int main(int argc, char *argv[])
 
 	ctx.update(&ctx, vect1, 0);
 	ctx.final(&ctx, digest);
-	memcpy(dgst1, digest, DGST_BYTES);
 	assert(!memcmp(digest, dgst1, DGST_BYTES));
 
 	ctx.update(&ctx, vect2, strlen(vect2));
 	ctx.final(&ctx, digest);
-	memcpy(dgst2, digest, DGST_BYTES);
 	assert(!memcmp(digest, dgst2, DGST_BYTES));
 
 	ctx.update(&ctx, vect3, strlen(vect3));
 	ctx.final(&ctx, digest);
-	memcpy(dgst3, digest, DGST_BYTES);
 	assert(!memcmp(digest, dgst3, DGST_BYTES));
 
 	ctx.update(&ctx, vect4a, strlen(vect4a));
 	ctx.update(&ctx, vect4b, strlen(vect4b));
 	ctx.final(&ctx, digest);
-	memcpy(dgst4, digest, DGST_BYTES);
 	assert(!memcmp(digest, dgst4, DGST_BYTES));
 
 	ctx.update(&ctx, vect5, sizeof(vect5));
 	ctx.final(&ctx, digest);
-	memcpy(dgst5, digest, DGST_BYTES);
 	assert(!memcmp(digest, dgst5, DGST_BYTES));
 
 	for (i=0; i<16777216; i++)
 		ctx.update(&ctx, vect6, strlen(vect6));
 	ctx.final(&ctx, digest);
-	memcpy(dgst6, digest, DGST_BYTES);
 	assert(!memcmp(digest, dgst6, DGST_BYTES));
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct {
+		enum sha256_impl impl;
+		const char *name;
+	} impls[] = {
+		{ eSHA256_PORTABLE, "portable" },
+		{ eSHA256_SHA_NI,   "sha-ni" },
+	};
+	int i;
+
+	/* every block function this CPU can run */
+	for (i=0; i<ARRAY_SIZE(impls); i++) {
+		if (sha256_impl(impls[i].impl)) {
+			printf("%s: not supported by this CPU\n", impls[i].name);
+			continue;
+		}
+		run_tests();
+		printf("%s: passed\n", impls[i].name);
+	}
+	sha256_impl(eSHA256_AUTO);
 
 	printf("ALL TESTS PASSED!\n");
 	return 0;
 }
-
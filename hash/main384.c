@@ -30,7 +30,59 @@
 
 #define DGST_BYTES (SHA384_DIGEST_LENGTH/8) /* it is ctx.md_len / 8 */
 
-int main(int argc, char *argv[])
+/* the same vectors hashed by openssl */
+static const uint8_t dgst1[DGST_BYTES] = {
+	0x38, 0xb0, 0x60, 0xa7, 0x51, 0xac, 0x96, 0x38,
+	0x4c, 0xd9, 0x32, 0x7e, 0xb1, 0xb1, 0xe3, 0x6a,
+	0x21, 0xfd, 0xb7, 0x11, 0x14, 0xbe, 0x07, 0x43,
+	0x4c, 0x0c, 0xc7, 0xbf, 0x63, 0xf6, 0xe1, 0xda,
+	0x27, 0x4e, 0xde, 0xbf, 0xe7, 0x6f, 0x65, 0xfb,
+	0xd5, 0x1a, 0xd2, 0xf1, 0x48, 0x98, 0xb9, 0x5b
+};
+static const uint8_t dgst2[DGST_BYTES] = {
+	0xcb, 0x00, 0x75, 0x3f, 0x45, 0xa3, 0x5e, 0x8b,
+	0xb5, 0xa0, 0x3d, 0x69, 0x9a, 0xc6, 0x50, 0x07,
+	0x27, 0x2c, 0x32, 0xab, 0x0e, 0xde, 0xd1, 0x63,
+	0x1a, 0x8b, 0x60, 0x5a, 0x43, 0xff, 0x5b, 0xed,
+	0x80, 0x86, 0x07, 0x2b, 0xa1, 0xe7, 0xcc, 0x23,
+	0x58, 0xba, 0xec, 0xa1, 0x34, 0xc8, 0x25, 0xa7
+};
+static const uint8_t dgst3[DGST_BYTES] = {
+	0x06, 0xc5, 0x58, 0x65, 0xec, 0x67, 0xd7, 0x02,
+	0x0b, 0x04, 0x3c, 0xbc, 0x0a, 0xd0, 0x5b, 0xb1,
+	0x94, 0xa7, 0x9f, 0x84, 0x03, 0x61, 0xb3, 0x41,
+	0xfb, 0x23, 0x9a, 0x0a, 0xb4, 0x70, 0xa4, 0x3c,
+	0x41, 0xb3, 0xee, 0x68, 0xb8, 0x49, 0x94, 0x63,
+	0xf3, 0x46, 0xc1, 0xd6, 0x60, 0x07, 0x9d, 0xb3
+};
+static const uint8_t dgst4[DGST_BYTES] = {
+	0x6a, 0x40, 0x8a, 0xb8, 0x2d, 0x4a, 0xb3, 0x8e,
+	0xe4, 0xc0, 0x8f, 0x60, 0xa5, 0x15, 0x01, 0x5f,
+	0xbb, 0x13, 0x6a, 0xb8, 0xa7, 0xb9, 0x87, 0x50,
+	0xf0, 0xb2, 0x00, 0xb3, 0xb3, 0x35, 0xaa, 0x30,
+	0x4c, 0xd1, 0x0b, 0x94, 0xf4, 0x1b, 0x0d, 0xb9,
+	0xb2, 0xc7, 0x17, 0x93, 0x9a, 0xf3, 0x98, 0x88
+};
+static const uint8_t dgst5[DGST_BYTES] = {
+	0x9d, 0x0e, 0x18, 0x09, 0x71, 0x64, 0x74, 0xcb,
+	0x08, 0x6e, 0x83, 0x4e, 0x31, 0x0a, 0x4a, 0x1c,
+	0xed, 0x14, 0x9e, 0x9c, 0x00, 0xf2, 0x48, 0x52,
+	0x79, 0x72, 0xce, 0xc5, 0x70, 0x4c, 0x2a, 0x5b,
+	0x07, 0xb8, 0xb3, 0xdc, 0x38, 0xec, 0xc4, 0xeb,
+	0xae, 0x97, 0xdd, 0xd8, 0x7f, 0x3d, 0x89, 0x85
+};
+static const uint8_t dgst6[DGST_BYTES] = {
+	0xa8, 0xc9, 0x9b, 0xcd, 0x73, 0x23, 0x3f, 0x9b,
+	0xad, 0x63, 0xb7, 0xe0, 0xd1, 0x05, 0xa9, 0xa9,
+	0x63, 0x41, 0xb6, 0x83, 0xc7, 0xf5, 0xfd, 0x37,
+	0x4b, 0x48, 0x1a, 0x46, 0xe9, 0x5a, 0x8d, 0xab,
+	0xaf, 0xf8, 0x70, 0x57, 0xa8, 0x9f, 0x27, 0xa7,
+	0xa7, 0x16, 0x62, 0x30, 0x3e, 0x54, 0x3d, 0x18
+};
+
+static uint8_t vect5[1000000];
+
+static void run_tests(void)
 {
 	int i;
 	sha512_ctx_t ctx;
@@ -39,15 +91,7 @@ int main(int argc, char *argv[])
 	uint8_t vect3[] = {"qwertyuiopasdfghjklzxcvbnmdfghjjhfsweryggfffffqsgsgrkart"};
 	uint8_t vect4a[] = {"reuowroeruouirdfnfdjfdjdfljkfflkdjfljkfjsdjldfjlfdjf"};
 	uint8_t vect4b[] = {"thisisatestvectorfortestvectorfourbwhichisanactualsentencedf"};
-	uint8_t vect5[1000000];
 	uint8_t vect6[] = {"testdksllkasdlakldlkjkdlluerymnbmvxeuwqtgfdjgfuopghdjscvxcvsgdah"};
-
-	uint8_t dgst1[DGST_BYTES];
-	uint8_t dgst2[DGST_BYTES];
-	uint8_t dgst3[DGST_BYTES];
-	uint8_t dgst4[DGST_BYTES];
-	uint8_t dgst5[DGST_BYTES];
-	uint8_t dgst6[DGST_BYTES];
 	uint8_t digest[DGST_BYTES];
 
 	memset(vect5, 'a', sizeof(vect5));
@@ -55,37 +99,54 @@ int main(int argc, char *argv[])
 
 	ctx.update(&ctx, vect1, 0);
 	ctx.final(&ctx, digest);
-	memcpy(dgst1, digest, DGST_BYTES);
 	assert(!memcmp(digest, dgst1, DGST_BYTES));
 
 	ctx.update(&ctx, vect2, strlen(vect2));
 	ctx.final(&ctx, digest);
-	memcpy(dgst2, digest, DGST_BYTES);
 	assert(!memcmp(digest, dgst2, DGST_BYTES));
 
 	ctx.update(&ctx, vect3, strlen(vect3));
 	ctx.final(&ctx, digest);
-	memcpy(dgst3, digest, DGST_BYTES);
 	assert(!memcmp(digest, dgst3, DGST_BYTES));
 
 	ctx.update(&ctx, vect4a, strlen(vect4a));
 	ctx.update(&ctx, vect4b, strlen(vect4b));
 	ctx.final(&ctx, digest);
-	memcpy(dgst4, digest, DGST_BYTES);
 	assert(!memcmp(digest, dgst4, DGST_BYTES));
 
 	ctx.update(&ctx, vect5, sizeof(vect5));
 	ctx.final(&ctx, digest);
-	memcpy(dgst5, digest, DGST_BYTES);
 	assert(!memcmp(digest, dgst5, DGST_BYTES));
 
 	for (i=0; i<16777216; i++)
 		ctx.update(&ctx, vect6, strlen(vect6));
 	ctx.final(&ctx, digest);
-	memcpy(dgst6, digest, DGST_BYTES);
 	assert(!memcmp(digest, dgst6, DGST_BYTES));
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct {
+		enum sha512_impl impl;
+		const char *name;
+	} impls[] = {
+		{ eSHA512_PORTABLE, "portable" },
+		{ eSHA512_AVX2,     "avx2" },
+		{ eSHA512_AVX512,   "avx-512" },
+	};
+	int i;
+
+	/* every block function this CPU can run */
+	for (i=0; i<ARRAY_SIZE(impls); i++) {
+		if (sha512_impl(impls[i].impl)) {
+			printf("%s: not supported by this CPU\n", impls[i].name);
+			continue;
+		}
+		run_tests();
+		printf("%s: passed\n", impls[i].name);
+	}
+	sha512_impl(eSHA512_AUTO);
 
 	printf("ALL TESTS PASSED!\n");
 	return 0;
 }
-
@@ -21,6 +21,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <time.h>
 #include "sha512.h"
 
 /*
@@ -30,7 +31,71 @@
 
 #define DGST_BYTES (SHA512_DIGEST_LENGTH/8) /* it is ctx.md_len / 8 */
 
-int main(int argc, char *argv[])
+/* the same vectors hashed by openssl */
+static const uint8_t dgst1[DGST_BYTES] = {
+	0xcf, 0x83, 0xe1, 0x35, 0x7e, 0xef, 0xb8, 0xbd,
+	0xf1, 0x54, 0x28, 0x50, 0xd6, 0x6d, 0x80, 0x07,
+	0xd6, 0x20, 0xe4, 0x05, 0x0b, 0x57, 0x15, 0xdc,
+	0x83, 0xf4, 0xa9, 0x21, 0xd3, 0x6c, 0xe9, 0xce,
+	0x47, 0xd0, 0xd1, 0x3c, 0x5d, 0x85, 0xf2, 0xb0,
+	0xff, 0x83, 0x18, 0xd2, 0x87, 0x7e, 0xec, 0x2f,
+	0x63, 0xb9, 0x31, 0xbd, 0x47, 0x41, 0x7a, 0x81,
+	0xa5, 0x38, 0x32, 0x7a, 0xf9, 0x27, 0xda, 0x3e
+};
+static const uint8_t dgst2[DGST_BYTES] = {
+	0xdd, 0xaf, 0x35, 0xa1, 0x93, 0x61, 0x7a, 0xba,
+	0xcc, 0x41, 0x73, 0x49, 0xae, 0x20, 0x41, 0x31,
+	0x12, 0xe6, 0xfa, 0x4e, 0x89, 0xa9, 0x7e, 0xa2,
+	0x0a, 0x9e, 0xee, 0xe6, 0x4b, 0x55, 0xd3, 0x9a,
+	0x21, 0x92, 0x99, 0x2a, 0x27, 0x4f, 0xc1, 0xa8,
+	0x36, 0xba, 0x3c, 0x23, 0xa3, 0xfe, 0xeb, 0xbd,
+	0x45, 0x4d, 0x44, 0x23, 0x64, 0x3c, 0xe8, 0x0e,
+	0x2a, 0x9a, 0xc9, 0x4f, 0xa5, 0x4c, 0xa4, 0x9f
+};
+static const uint8_t dgst3[DGST_BYTES] = {
+	0x93, 0x5d, 0xe4, 0xc7, 0x27, 0x66, 0x76, 0xe0,
+	0x5b, 0x9f, 0x4b, 0x85, 0x27, 0x98, 0xa6, 0xa6,
+	0x16, 0x3a, 0x4b, 0xfa, 0xe1, 0xc2, 0x1c, 0xb3,
+	0xed, 0x5a, 0x20, 0xa4, 0x72, 0x7d, 0x75, 0xe2,
+	0x9b, 0x5f, 0xdb, 0xd8, 0x39, 0x6e, 0xcf, 0xa5,
+	0xbd, 0x16, 0x43, 0xcf, 0xc3, 0x5d, 0xa3, 0x37,
+	0xb6, 0xc1, 0xec, 0x00, 0xc2, 0x0b, 0x25, 0x4f,
+	0xc7, 0x8d, 0x35, 0x10, 0x12, 0xdc, 0x27, 0x9f
+};
+static const uint8_t dgst4[DGST_BYTES] = {
+	0x1a, 0x64, 0xaa, 0x1a, 0xc2, 0x6d, 0x53, 0xbd,
+	0xc2, 0xad, 0x02, 0xa5, 0xce, 0xba, 0x85, 0x6c,
+	0xf7, 0x2a, 0x86, 0x97, 0xa7, 0x27, 0x6c, 0xf6,
+	0x31, 0x5e, 0x07, 0x5b, 0x0e, 0xa1, 0xb0, 0x1d,
+	0x19, 0x66, 0xde, 0x2f, 0x1b, 0x75, 0x3e, 0xf0,
+	0x96, 0xde, 0x57, 0x0d, 0xa3, 0x4e, 0x78, 0xd4,
+	0x03, 0x24, 0x4f, 0xd1, 0x53, 0x1b, 0xae, 0xb2,
+	0x5d, 0xc5, 0x97, 0x97, 0xb0, 0x13, 0x07, 0x29
+};
+static const uint8_t dgst5[DGST_BYTES] = {
+	0xe7, 0x18, 0x48, 0x3d, 0x0c, 0xe7, 0x69, 0x64,
+	0x4e, 0x2e, 0x42, 0xc7, 0xbc, 0x15, 0xb4, 0x63,
+	0x8e, 0x1f, 0x98, 0xb1, 0x3b, 0x20, 0x44, 0x28,
+	0x56, 0x32, 0xa8, 0x03, 0xaf, 0xa9, 0x73, 0xeb,
+	0xde, 0x0f, 0xf2, 0x44, 0x87, 0x7e, 0xa6, 0x0a,
+	0x4c, 0xb0, 0x43, 0x2c, 0xe5, 0x77, 0xc3, 0x1b,
+	0xeb, 0x00, 0x9c, 0x5c, 0x2c, 0x49, 0xaa, 0x2e,
+	0x4e, 0xad, 0xb2, 0x17, 0xad, 0x8c, 0xc0, 0x9b
+};
+static const uint8_t dgst6[DGST_BYTES] = {
+	0xc8, 0x93, 0xc3, 0x6b, 0xf1, 0x89, 0x1f, 0xff,
+	0x0a, 0xf1, 0x42, 0xad, 0xdf, 0xa0, 0x9e, 0x08,
+	0xd8, 0xa8, 0xb2, 0x11, 0x90, 0xe8, 0xd3, 0x78,
+	0x4f, 0xe8, 0xf5, 0xde, 0x9d, 0x4c, 0x2c, 0xd6,
+	0xbe, 0x4a, 0x9f, 0x4f, 0x9e, 0xe7, 0x9f, 0xdd,
+	0xb8, 0x80, 0xb5, 0x10, 0x1b, 0x1e, 0xdb, 0x86,
+	0x74, 0x41, 0x37, 0xdb, 0x4b, 0x22, 0xf3, 0x8c,
+	0x5e, 0x01, 0x28, 0xf5, 0xb2, 0xc7, 0x5e, 0xa4
+};
+
+static uint8_t vect5[1000000];
+
+static void run_tests(void)
 {
 	int i;
 	sha512_ctx_t ctx;
@@ -39,15 +104,7 @@ int main(int argc, char *argv[])
 	uint8_t vect3[] = {"qwertyuiopasdfghjklzxcvbnmdfghjjhfsweryggfffffqsgsgrkart"};
 	uint8_t vect4a[] = {"reuowroeruouirdfnfdjfdjdfljkfflkdjfljkfjsdjldfjlfdjf"};
 	uint8_t vect4b[] = {"thisisatestvectorfortestvectorfourbwhichisanactualsentencedf"};
-	uint8_t vect5[1000000];
 	uint8_t vect6[] = {"testdksllkasdlakldlkjkdlluerymnbmvxeuwqtgfdjgfuopghdjscvxcvsgdah"};
-
-	uint8_t dgst1[DGST_BYTES];
-	uint8_t dgst2[DGST_BYTES];
-	uint8_t dgst3[DGST_BYTES];
-	uint8_t dgst4[DGST_BYTES];
-	uint8_t dgst5[DGST_BYTES];
-	uint8_t dgst6[DGST_BYTES];
 	uint8_t digest[DGST_BYTES];
 
 	memset(vect5, 'a', sizeof(vect5));
@@ -55,37 +112,83 @@ int main(int argc, char *argv[])
 
 	ctx.update(&ctx, vect1, 0);
 	ctx.final(&ctx, digest);
-	memcpy(dgst1, digest, DGST_BYTES);
 	assert(!memcmp(digest, dgst1, DGST_BYTES));
 
 	ctx.update(&ctx, vect2, strlen(vect2));
 	ctx.final(&ctx, digest);
-	memcpy(dgst2, digest, DGST_BYTES);
 	assert(!memcmp(digest, dgst2, DGST_BYTES));
 
 	ctx.update(&ctx, vect3, strlen(vect3));
 	ctx.final(&ctx, digest);
-	memcpy(dgst3, digest, DGST_BYTES);
 	assert(!memcmp(digest, dgst3, DGST_BYTES));
 
 	ctx.update(&ctx, vect4a, strlen(vect4a));
 	ctx.update(&ctx, vect4b, strlen(vect4b));
 	ctx.final(&ctx, digest);
-	memcpy(dgst4, digest, DGST_BYTES);
 	assert(!memcmp(digest, dgst4, DGST_BYTES));
 
 	ctx.update(&ctx, vect5, sizeof(vect5));
 	ctx.final(&ctx, digest);
-	memcpy(dgst5, digest, DGST_BYTES);
 	assert(!memcmp(digest, dgst5, DGST_BYTES));
 
 	for (i=0; i<16777216; i++)
 		ctx.update(&ctx, vect6, strlen(vect6));
 	ctx.final(&ctx, digest);
-	memcpy(dgst6, digest, DGST_BYTES);
 	assert(!memcmp(digest, dgst6, DGST_BYTES));
+}
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* MB/s of the current kernel on vect5, best of 50 */
+static double speed(void)
+{
+	int i;
+	double t0, dt;
+	sha512_ctx_t ctx;
+	uint8_t digest[DGST_BYTES];
+
+	for (i=0, dt=1e9; i<50; i++) {
+		sha512_init(&ctx);
+		t0 = now();
+		ctx.update(&ctx, vect5, sizeof(vect5));
+		ctx.final(&ctx, digest);
+		t0 = now() - t0;
+		if (t0 < dt) dt = t0;
+	}
+	return sizeof(vect5) / dt / 1e6;
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct {
+		enum sha512_impl impl;
+		const char *name;
+	} impls[] = {
+		{ eSHA512_PORTABLE, "portable" },
+		{ eSHA512_AVX2,     "avx2" },
+		{ eSHA512_AVX512,   "avx-512" },
+	};
+	int i;
+	double mbps, base = 0;
+
+	/* every block function this CPU can run, the speedup is against portable */
+	for (i=0; i<ARRAY_SIZE(impls); i++) {
+		if (sha512_impl(impls[i].impl)) {
+			printf("%s: not supported by this CPU\n", impls[i].name);
+			continue;
+		}
+		run_tests();
+		mbps = speed();
+		if (!base) base = mbps;
+		printf("%s: passed, %.1f MB/s, %.2fx\n", impls[i].name, mbps, mbps / base);
+	}
+	sha512_impl(eSHA512_AUTO);
 
 	printf("ALL TESTS PASSED!\n");
 	return 0;
 }
-
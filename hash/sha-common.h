@@ -22,6 +22,7 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include <string.h>
 
 #define SHA1_DIGEST_LENGTH    160
 #define SHA224_DIGEST_LENGTH  224
@@ -87,6 +88,35 @@ uint32_t  swap32(uint32_t n);
 uint64_t  swap64(uint64_t n);
 uint128_t swap128(uint128_t n);
 
+/* big-endian words at any alignment, for the block functions */
+static inline uint32_t load_be32(const uint8_t *p)
+{
+	uint32_t x;
+
+	memcpy(&x, p, sizeof(x));
+	return __builtin_bswap32(x);
+}
+
+static inline uint64_t load_be64(const uint8_t *p)
+{
+	uint64_t x;
+
+	memcpy(&x, p, sizeof(x));
+	return __builtin_bswap64(x);
+}
+
+static inline void store_be32(uint8_t *p, uint32_t x)
+{
+	x = __builtin_bswap32(x);
+	memcpy(p, &x, sizeof(x));
+}
+
+static inline void store_be64(uint8_t *p, uint64_t x)
+{
+	x = __builtin_bswap64(x);
+	memcpy(p, &x, sizeof(x));
+}
+
 /* hex string to byte array */
 int hex2ba(uint8_t *hexstring, uint8_t *byte_array, int max_bytes);
 /*
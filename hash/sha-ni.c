@@ -0,0 +1,196 @@
+/*
+   Copyright 2020 Andrew Li, Gavin Li
+
+   li.andrew.mail@gmail.com
+   gavinux@gmail.com
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+/*
+ * SHA-1 and SHA-256 compression with the x86 SHA extensions,
+ * the round structure follows Intel's "New Instructions Supporting
+ * the Secure Hash Algorithm on Intel Architecture Processors".
+ * both take any number of 64-byte blocks, the state stays in
+ * registers from one block to the next
+ */
+#include <string.h>
+#include "sha-common.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <immintrin.h>
+
+#define SHANI_TARGET __attribute__((target("sha,sse4.1,ssse3,sse2")))
+
+int  sha_ni_supported(void)
+{
+	unsigned int a, b, c, d;
+
+	__builtin_cpu_init();
+	if (!__builtin_cpu_supports("sse4.1") || !__builtin_cpu_supports("ssse3"))
+		return 0;
+	if (!__get_cpuid_count(7, 0, &a, &b, &c, &d))
+		return 0;
+	return !!(b & bit_SHA);
+}
+
+/*
+ * rounds 4g..4g+3, mg has their message words, the schedule of the
+ * words 4 groups later is advanced on the way: mprev (g-1) gets msg1,
+ * mprev2 (g-2) the xor and mnext (g+1) msg2. g is a constant, the
+ * conditions are resolved at compile time
+ */
+#define SHA1_ROUNDS4(g, e, eo, mg, mnext, mprev, mprev2) \
+	do { \
+		if ((g) == 0) \
+			e = _mm_add_epi32(e, mg); \
+		else \
+			e = _mm_sha1nexte_epu32(e, mg); \
+		eo = abcd; \
+		if ((g) >= 3 && (g) <= 18) \
+			mnext = _mm_sha1msg2_epu32(mnext, mg); \
+		abcd = _mm_sha1rnds4_epu32(abcd, e, (g) / 5); \
+		if ((g) >= 1 && (g) <= 16) \
+			mprev = _mm_sha1msg1_epu32(mprev, mg); \
+		if ((g) >= 2 && (g) <= 17) \
+			mprev2 = _mm_xor_si128(mprev2, mg); \
+	} while (0)
+
+SHANI_TARGET
+void sha1_ni_run(uint32_t state[5], const uint8_t *data, size_t nblocks)
+{
+	__m128i abcd, abcd_save, e0, e0_save, e1, m0, m1, m2, m3;
+	const __m128i mask = _mm_set_epi64x(0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL);
+
+	abcd = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)state), 0x1b);
+	e0   = _mm_set_epi32(state[4], 0, 0, 0);
+
+	for (; nblocks--; data += 64) {
+		abcd_save = abcd;
+		e0_save   = e0;
+		m0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data +  0)), mask);
+		m1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 16)), mask);
+		m2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 32)), mask);
+		m3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 48)), mask);
+
+		SHA1_ROUNDS4( 0, e0, e1, m0, m1, m3, m2);
+		SHA1_ROUNDS4( 1, e1, e0, m1, m2, m0, m3);
+		SHA1_ROUNDS4( 2, e0, e1, m2, m3, m1, m0);
+		SHA1_ROUNDS4( 3, e1, e0, m3, m0, m2, m1);
+		SHA1_ROUNDS4( 4, e0, e1, m0, m1, m3, m2);
+		SHA1_ROUNDS4( 5, e1, e0, m1, m2, m0, m3);
+		SHA1_ROUNDS4( 6, e0, e1, m2, m3, m1, m0);
+		SHA1_ROUNDS4( 7, e1, e0, m3, m0, m2, m1);
+		SHA1_ROUNDS4( 8, e0, e1, m0, m1, m3, m2);
+		SHA1_ROUNDS4( 9, e1, e0, m1, m2, m0, m3);
+		SHA1_ROUNDS4(10, e0, e1, m2, m3, m1, m0);
+		SHA1_ROUNDS4(11, e1, e0, m3, m0, m2, m1);
+		SHA1_ROUNDS4(12, e0, e1, m0, m1, m3, m2);
+		SHA1_ROUNDS4(13, e1, e0, m1, m2, m0, m3);
+		SHA1_ROUNDS4(14, e0, e1, m2, m3, m1, m0);
+		SHA1_ROUNDS4(15, e1, e0, m3, m0, m2, m1);
+		SHA1_ROUNDS4(16, e0, e1, m0, m1, m3, m2);
+		SHA1_ROUNDS4(17, e1, e0, m1, m2, m0, m3);
+		SHA1_ROUNDS4(18, e0, e1, m2, m3, m1, m0);
+		SHA1_ROUNDS4(19, e1, e0, m3, m0, m2, m1);
+
+		/* e is a rotated by 30 from 4 rounds before the end */
+		e0   = _mm_sha1nexte_epu32(e0, e0_save);
+		abcd = _mm_add_epi32(abcd, abcd_save);
+	}
+
+	_mm_storeu_si128((__m128i *)state, _mm_shuffle_epi32(abcd, 0x1b));
+	state[4] = _mm_extract_epi32(e0, 3);
+}
+
+/*
+ * rounds 4g..4g+3 as two sha256rnds2, same scheme as SHA1_ROUNDS4:
+ * mprev (g-1) gets msg1, mnext (g+1) the w[t-7] words and msg2
+ */
+#define SHA256_ROUNDS4(g, mg, mnext, mprev) \
+	do { \
+		msg = _mm_add_epi32(mg, _mm_loadu_si128((const __m128i *)(sha256_K + 4 * (g)))); \
+		cdgh = _mm_sha256rnds2_epu32(cdgh, abef, msg); \
+		if ((g) >= 3 && (g) <= 14) { \
+			mnext = _mm_add_epi32(mnext, _mm_alignr_epi8(mg, mprev, 4)); \
+			mnext = _mm_sha256msg2_epu32(mnext, mg); \
+		} \
+		abef = _mm_sha256rnds2_epu32(abef, cdgh, _mm_shuffle_epi32(msg, 0x0e)); \
+		if ((g) >= 1 && (g) <= 12) \
+			mprev = _mm_sha256msg1_epu32(mprev, mg); \
+	} while (0)
+
+SHANI_TARGET
+void sha256_ni_run(uint32_t state[8], const uint8_t *data, size_t nblocks)
+{
+	__m128i abef, cdgh, abef_save, cdgh_save, t, msg, m0, m1, m2, m3;
+	const __m128i mask = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+	/* the instructions want the state as ABEF and CDGH */
+	t    = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&state[0]), 0xb1);
+	cdgh = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&state[4]), 0x1b);
+	abef = _mm_alignr_epi8(t, cdgh, 8);
+	cdgh = _mm_blend_epi16(cdgh, t, 0xf0);
+
+	for (; nblocks--; data += 64) {
+		abef_save = abef;
+		cdgh_save = cdgh;
+		m0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data +  0)), mask);
+		m1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 16)), mask);
+		m2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 32)), mask);
+		m3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 48)), mask);
+
+		SHA256_ROUNDS4( 0, m0, m1, m3);
+		SHA256_ROUNDS4( 1, m1, m2, m0);
+		SHA256_ROUNDS4( 2, m2, m3, m1);
+		SHA256_ROUNDS4( 3, m3, m0, m2);
+		SHA256_ROUNDS4( 4, m0, m1, m3);
+		SHA256_ROUNDS4( 5, m1, m2, m0);
+		SHA256_ROUNDS4( 6, m2, m3, m1);
+		SHA256_ROUNDS4( 7, m3, m0, m2);
+		SHA256_ROUNDS4( 8, m0, m1, m3);
+		SHA256_ROUNDS4( 9, m1, m2, m0);
+		SHA256_ROUNDS4(10, m2, m3, m1);
+		SHA256_ROUNDS4(11, m3, m0, m2);
+		SHA256_ROUNDS4(12, m0, m1, m3);
+		SHA256_ROUNDS4(13, m1, m2, m0);
+		SHA256_ROUNDS4(14, m2, m3, m1);
+		SHA256_ROUNDS4(15, m3, m0, m2);
+
+		abef = _mm_add_epi32(abef, abef_save);
+		cdgh = _mm_add_epi32(cdgh, cdgh_save);
+	}
+
+	t    = _mm_shuffle_epi32(abef, 0x1b);
+	cdgh = _mm_shuffle_epi32(cdgh, 0xb1);
+	_mm_storeu_si128((__m128i *)&state[0], _mm_blend_epi16(t, cdgh, 0xf0));
+	_mm_storeu_si128((__m128i *)&state[4], _mm_alignr_epi8(cdgh, t, 8));
+}
+
+#else /* no SHA extensions on this architecture */
+
+int  sha_ni_supported(void)
+{
+	return 0;
+}
+
+void sha1_ni_run(uint32_t state[5], const uint8_t *data, size_t nblocks)
+{
+}
+
+void sha256_ni_run(uint32_t state[8], const uint8_t *data, size_t nblocks)
+{
+}
+
+#endif
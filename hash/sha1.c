@@ -28,6 +28,11 @@ REGISTER_HASH_ALGO(eHASH_SHA1, sha1_init);
 static void sha1_update(sha1_ctx_t *ctx, uint8_t *data, size_t len);
 static void sha1_final(sha1_ctx_t *ctx, uint8_t digest[SHA1_DIGEST_LENGTH / 8]);
 
+extern int  sha_ni_supported(void);
+extern void sha1_ni_run(uint32_t state[5], const uint8_t *data, size_t nblocks);
+
+static int sha_ni = -1; /* use the SHA extensions, checked once or set by sha1_impl() */
+
 const uint32_t K1 = 0x5A827999;
 const uint32_t K2 = 0x6ED9EBA1;
 const uint32_t K3 = 0x8F1BBCDC;
@@ -49,110 +54,132 @@ const uint32_t H0[] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F
 	} while(0)
 
 
-static void sha1_run(uint32_t state[5], uint8_t data[SHA1_BUF_SIZE])
+static void sha1_run(uint32_t state[5], const uint8_t *data, size_t nblocks)
 {
 	uint32_t i, a, b, c, d, e, x[16];
 
-	memcpy(x, data, sizeof(x)); /* avoid alignment issue */
-	for (i=0; i<ARRAY_SIZE(x); i++)
-		x[i] = swap32(x[i]);
-
-	a = state[0];
-	b = state[1];
-	c = state[2];
-	d = state[3];
-	e = state[4];
-
-	R( a, b, c, d, e, Ch,     K1, x[ 0] );
-	R( e, a, b, c, d, Ch,     K1, x[ 1] );
-	R( d, e, a, b, c, Ch,     K1, x[ 2] );
-	R( c, d, e, a, b, Ch,     K1, x[ 3] );
-	R( b, c, d, e, a, Ch,     K1, x[ 4] );
-	R( a, b, c, d, e, Ch,     K1, x[ 5] );
-	R( e, a, b, c, d, Ch,     K1, x[ 6] );
-	R( d, e, a, b, c, Ch,     K1, x[ 7] );
-	R( c, d, e, a, b, Ch,     K1, x[ 8] );
-	R( b, c, d, e, a, Ch,     K1, x[ 9] );
-	R( a, b, c, d, e, Ch,     K1, x[10] );
-	R( e, a, b, c, d, Ch,     K1, x[11] );
-	R( d, e, a, b, c, Ch,     K1, x[12] );
-	R( c, d, e, a, b, Ch,     K1, x[13] );
-	R( b, c, d, e, a, Ch,     K1, x[14] );
-	R( a, b, c, d, e, Ch,     K1, x[15] );
-	R( e, a, b, c, d, Ch,     K1, W(16) );
-	R( d, e, a, b, c, Ch,     K1, W(17) );
-	R( c, d, e, a, b, Ch,     K1, W(18) );
-	R( b, c, d, e, a, Ch,     K1, W(19) );
-	R( a, b, c, d, e, Parity, K2, W(20) );
-	R( e, a, b, c, d, Parity, K2, W(21) );
-	R( d, e, a, b, c, Parity, K2, W(22) );
-	R( c, d, e, a, b, Parity, K2, W(23) );
-	R( b, c, d, e, a, Parity, K2, W(24) );
-	R( a, b, c, d, e, Parity, K2, W(25) );
-	R( e, a, b, c, d, Parity, K2, W(26) );
-	R( d, e, a, b, c, Parity, K2, W(27) );
-	R( c, d, e, a, b, Parity, K2, W(28) );
-	R( b, c, d, e, a, Parity, K2, W(29) );
-	R( a, b, c, d, e, Parity, K2, W(30) );
-	R( e, a, b, c, d, Parity, K2, W(31) );
-	R( d, e, a, b, c, Parity, K2, W(32) );
-	R( c, d, e, a, b, Parity, K2, W(33) );
-	R( b, c, d, e, a, Parity, K2, W(34) );
-	R( a, b, c, d, e, Parity, K2, W(35) );
-	R( e, a, b, c, d, Parity, K2, W(36) );
-	R( d, e, a, b, c, Parity, K2, W(37) );
-	R( c, d, e, a, b, Parity, K2, W(38) );
-	R( b, c, d, e, a, Parity, K2, W(39) );
-	R( a, b, c, d, e, Maj,    K3, W(40) );
-	R( e, a, b, c, d, Maj,    K3, W(41) );
-	R( d, e, a, b, c, Maj,    K3, W(42) );
-	R( c, d, e, a, b, Maj,    K3, W(43) );
-	R( b, c, d, e, a, Maj,    K3, W(44) );
-	R( a, b, c, d, e, Maj,    K3, W(45) );
-	R( e, a, b, c, d, Maj,    K3, W(46) );
-	R( d, e, a, b, c, Maj,    K3, W(47) );
-	R( c, d, e, a, b, Maj,    K3, W(48) );
-	R( b, c, d, e, a, Maj,    K3, W(49) );
-	R( a, b, c, d, e, Maj,    K3, W(50) );
-	R( e, a, b, c, d, Maj,    K3, W(51) );
-	R( d, e, a, b, c, Maj,    K3, W(52) );
-	R( c, d, e, a, b, Maj,    K3, W(53) );
-	R( b, c, d, e, a, Maj,    K3, W(54) );
-	R( a, b, c, d, e, Maj,    K3, W(55) );
-	R( e, a, b, c, d, Maj,    K3, W(56) );
-	R( d, e, a, b, c, Maj,    K3, W(57) );
-	R( c, d, e, a, b, Maj,    K3, W(58) );
-	R( b, c, d, e, a, Maj,    K3, W(59) );
-	R( a, b, c, d, e, Parity, K4, W(60) );
-	R( e, a, b, c, d, Parity, K4, W(61) );
-	R( d, e, a, b, c, Parity, K4, W(62) );
-	R( c, d, e, a, b, Parity, K4, W(63) );
-	R( b, c, d, e, a, Parity, K4, W(64) );
-	R( a, b, c, d, e, Parity, K4, W(65) );
-	R( e, a, b, c, d, Parity, K4, W(66) );
-	R( d, e, a, b, c, Parity, K4, W(67) );
-	R( c, d, e, a, b, Parity, K4, W(68) );
-	R( b, c, d, e, a, Parity, K4, W(69) );
-	R( a, b, c, d, e, Parity, K4, W(70) );
-	R( e, a, b, c, d, Parity, K4, W(71) );
-	R( d, e, a, b, c, Parity, K4, W(72) );
-	R( c, d, e, a, b, Parity, K4, W(73) );
-	R( b, c, d, e, a, Parity, K4, W(74) );
-	R( a, b, c, d, e, Parity, K4, W(75) );
-	R( e, a, b, c, d, Parity, K4, W(76) );
-	R( d, e, a, b, c, Parity, K4, W(77) );
-	R( c, d, e, a, b, Parity, K4, W(78) );
-	R( b, c, d, e, a, Parity, K4, W(79) );
-
-	state[0] += a;
-	state[1] += b;
-	state[2] += c;
-	state[3] += d;
-	state[4] += e;
+	for (; nblocks--; data += SHA1_BUF_SIZE) {
+		for (i=0; i<16; i++)
+			x[i] = load_be32(data + 4 * i);
+
+		a = state[0];
+		b = state[1];
+		c = state[2];
+		d = state[3];
+		e = state[4];
+
+		R( a, b, c, d, e, Ch,     K1, x[ 0] );
+		R( e, a, b, c, d, Ch,     K1, x[ 1] );
+		R( d, e, a, b, c, Ch,     K1, x[ 2] );
+		R( c, d, e, a, b, Ch,     K1, x[ 3] );
+		R( b, c, d, e, a, Ch,     K1, x[ 4] );
+		R( a, b, c, d, e, Ch,     K1, x[ 5] );
+		R( e, a, b, c, d, Ch,     K1, x[ 6] );
+		R( d, e, a, b, c, Ch,     K1, x[ 7] );
+		R( c, d, e, a, b, Ch,     K1, x[ 8] );
+		R( b, c, d, e, a, Ch,     K1, x[ 9] );
+		R( a, b, c, d, e, Ch,     K1, x[10] );
+		R( e, a, b, c, d, Ch,     K1, x[11] );
+		R( d, e, a, b, c, Ch,     K1, x[12] );
+		R( c, d, e, a, b, Ch,     K1, x[13] );
+		R( b, c, d, e, a, Ch,     K1, x[14] );
+		R( a, b, c, d, e, Ch,     K1, x[15] );
+		R( e, a, b, c, d, Ch,     K1, W(16) );
+		R( d, e, a, b, c, Ch,     K1, W(17) );
+		R( c, d, e, a, b, Ch,     K1, W(18) );
+		R( b, c, d, e, a, Ch,     K1, W(19) );
+		R( a, b, c, d, e, Parity, K2, W(20) );
+		R( e, a, b, c, d, Parity, K2, W(21) );
+		R( d, e, a, b, c, Parity, K2, W(22) );
+		R( c, d, e, a, b, Parity, K2, W(23) );
+		R( b, c, d, e, a, Parity, K2, W(24) );
+		R( a, b, c, d, e, Parity, K2, W(25) );
+		R( e, a, b, c, d, Parity, K2, W(26) );
+		R( d, e, a, b, c, Parity, K2, W(27) );
+		R( c, d, e, a, b, Parity, K2, W(28) );
+		R( b, c, d, e, a, Parity, K2, W(29) );
+		R( a, b, c, d, e, Parity, K2, W(30) );
+		R( e, a, b, c, d, Parity, K2, W(31) );
+		R( d, e, a, b, c, Parity, K2, W(32) );
+		R( c, d, e, a, b, Parity, K2, W(33) );
+		R( b, c, d, e, a, Parity, K2, W(34) );
+		R( a, b, c, d, e, Parity, K2, W(35) );
+		R( e, a, b, c, d, Parity, K2, W(36) );
+		R( d, e, a, b, c, Parity, K2, W(37) );
+		R( c, d, e, a, b, Parity, K2, W(38) );
+		R( b, c, d, e, a, Parity, K2, W(39) );
+		R( a, b, c, d, e, Maj,    K3, W(40) );
+		R( e, a, b, c, d, Maj,    K3, W(41) );
+		R( d, e, a, b, c, Maj,    K3, W(42) );
+		R( c, d, e, a, b, Maj,    K3, W(43) );
+		R( b, c, d, e, a, Maj,    K3, W(44) );
+		R( a, b, c, d, e, Maj,    K3, W(45) );
+		R( e, a, b, c, d, Maj,    K3, W(46) );
+		R( d, e, a, b, c, Maj,    K3, W(47) );
+		R( c, d, e, a, b, Maj,    K3, W(48) );
+		R( b, c, d, e, a, Maj,    K3, W(49) );
+		R( a, b, c, d, e, Maj,    K3, W(50) );
+		R( e, a, b, c, d, Maj,    K3, W(51) );
+		R( d, e, a, b, c, Maj,    K3, W(52) );
+		R( c, d, e, a, b, Maj,    K3, W(53) );
+		R( b, c, d, e, a, Maj,    K3, W(54) );
+		R( a, b, c, d, e, Maj,    K3, W(55) );
+		R( e, a, b, c, d, Maj,    K3, W(56) );
+		R( d, e, a, b, c, Maj,    K3, W(57) );
+		R( c, d, e, a, b, Maj,    K3, W(58) );
+		R( b, c, d, e, a, Maj,    K3, W(59) );
+		R( a, b, c, d, e, Parity, K4, W(60) );
+		R( e, a, b, c, d, Parity, K4, W(61) );
+		R( d, e, a, b, c, Parity, K4, W(62) );
+		R( c, d, e, a, b, Parity, K4, W(63) );
+		R( b, c, d, e, a, Parity, K4, W(64) );
+		R( a, b, c, d, e, Parity, K4, W(65) );
+		R( e, a, b, c, d, Parity, K4, W(66) );
+		R( d, e, a, b, c, Parity, K4, W(67) );
+		R( c, d, e, a, b, Parity, K4, W(68) );
+		R( b, c, d, e, a, Parity, K4, W(69) );
+		R( a, b, c, d, e, Parity, K4, W(70) );
+		R( e, a, b, c, d, Parity, K4, W(71) );
+		R( d, e, a, b, c, Parity, K4, W(72) );
+		R( c, d, e, a, b, Parity, K4, W(73) );
+		R( b, c, d, e, a, Parity, K4, W(74) );
+		R( a, b, c, d, e, Parity, K4, W(75) );
+		R( e, a, b, c, d, Parity, K4, W(76) );
+		R( d, e, a, b, c, Parity, K4, W(77) );
+		R( c, d, e, a, b, Parity, K4, W(78) );
+		R( b, c, d, e, a, Parity, K4, W(79) );
+
+		state[0] += a;
+		state[1] += b;
+		state[2] += c;
+		state[3] += d;
+		state[4] += e;
+	}
+}
+
+int  sha1_impl(enum sha1_impl impl)
+{
+	int ni = sha_ni_supported();
+
+	if (impl == eSHA1_SHA_NI && !ni)
+		return -1;
+	sha_ni = impl == eSHA1_AUTO ? ni : impl == eSHA1_SHA_NI;
+	return 0;
+}
+
+/* nblocks blocks, with the SHA extensions when the CPU has them */
+static inline void sha1_compress(uint32_t state[5], const uint8_t *data, size_t nblocks)
+{
+	if (sha_ni)
+		sha1_ni_run(state, data, nblocks);
+	else
+		sha1_run(state, data, nblocks);
 }
 
 void sha1_init(sha1_ctx_t *ctx)
 {
+	if (sha_ni < 0)
+		sha_ni = sha_ni_supported();
 	memset (ctx,0,sizeof(*ctx));
 	ctx->init     = sha1_init;
 	ctx->update   = sha1_update;
@@ -164,49 +191,52 @@ void sha1_init(sha1_ctx_t *ctx)
 	memcpy(ctx->state, H0, sizeof(H0));
 }
 
+/*
+ * a partial block is completed in ctx->buffer, then the whole blocks
+ * are compressed straight from data in one call, only the tail is copied
+ */
 static void sha1_update(sha1_ctx_t *ctx, uint8_t *data, size_t len)
 {
-	size_t i;
-
-	if (len + ctx->buf_len > SHA1_BUF_SIZE - 1) {
-		i = SHA1_BUF_SIZE - ctx->buf_len;
-		memcpy(&ctx->buffer[ctx->buf_len], data, i);
-		sha1_run(ctx->state, ctx->buffer);
-		for (; i+SHA1_BUF_SIZE-1<len; i+=SHA1_BUF_SIZE) {
-			sha1_run(ctx->state, &data[i]);
-		}
-		ctx->buf_len = len - i;
-		memcpy(&ctx->buffer, &data[i], ctx->buf_len);
-	}
-	else {
-		memcpy(&ctx->buffer[ctx->buf_len], data, len);
-		ctx->buf_len += len;
-	}
+	size_t n;
+
 	ctx->total += len;
+	if (ctx->buf_len) {
+		n = SHA1_BUF_SIZE - ctx->buf_len;
+		if (n > len) n = len;
+		memcpy(&ctx->buffer[ctx->buf_len], data, n);
+		ctx->buf_len += n;
+		data += n;
+		len  -= n;
+		if (ctx->buf_len < SHA1_BUF_SIZE)
+			return;
+		sha1_compress(ctx->state, ctx->buffer, 1);
+		ctx->buf_len = 0;
+	}
+	n = len / SHA1_BUF_SIZE;
+	if (n)
+		sha1_compress(ctx->state, data, n);
+	ctx->buf_len = len % SHA1_BUF_SIZE;
+	memcpy(ctx->buffer, &data[n * SHA1_BUF_SIZE], ctx->buf_len);
 }
 
 static void sha1_final(sha1_ctx_t *ctx, uint8_t digest[SHA1_DIGEST_LENGTH / 8])
 {
 	int i;
-	uint8_t byte;
-	uint64_t qw;
-
-	qw = ctx->total * 8;
-	byte = 0x80;
-	sha1_update(ctx, &byte, 1);
-	/*
-	 * if after add byte 0x80, the ctx->buf_len >= 64 - sizeof(qw)
-	 * the following while statement will triger an sha1_run
-	 */
-	byte = 0x00;
-	while (ctx->buf_len != SHA1_BUF_SIZE - sizeof(qw))
-		sha1_update(ctx, &byte, 1);
-
-	qw = swap64(qw);
-	sha1_update(ctx, (uint8_t *)&qw, sizeof(qw)); /* trigger sha1_run() */
+	uint64_t bits = ctx->total * 8;
+
+	/* 0x80, zeros and the bit length, in one block or two */
+	ctx->buffer[ctx->buf_len++] = 0x80;
+	if (ctx->buf_len > SHA1_BUF_SIZE - sizeof(bits)) {
+		memset(&ctx->buffer[ctx->buf_len], 0, SHA1_BUF_SIZE - ctx->buf_len);
+		sha1_compress(ctx->state, ctx->buffer, 1);
+		ctx->buf_len = 0;
+	}
+	memset(&ctx->buffer[ctx->buf_len], 0, SHA1_BUF_SIZE - sizeof(bits) - ctx->buf_len);
+	store_be64(&ctx->buffer[SHA1_BUF_SIZE - sizeof(bits)], bits);
+	sha1_compress(ctx->state, ctx->buffer, 1);
 
 	for (i=0; i<ARRAY_SIZE(ctx->state); i++)
-		ctx->state[i] = swap32(ctx->state[i]);
+		ctx->state[i] = __builtin_bswap32(ctx->state[i]);
 	memcpy(digest, ctx->state, ctx->md_len/8);
 
 	ctx->init(ctx);
@@ -42,5 +42,20 @@ struct sha1_ctx {
 
 void sha1_init(sha1_ctx_t *ctx);
 
+/*
+ * the block function used from now on by every sha1 context of the
+ * process, for tests and benchmarks: AUTO is the SHA extensions when
+ * the CPU has them. returns -1 if the CPU can't do the one asked for.
+ * not thread-safe, the choice is a plain global read by every hash:
+ * call it before any thread starts hashing
+ */
+enum sha1_impl {
+	eSHA1_AUTO,
+	eSHA1_PORTABLE,
+	eSHA1_SHA_NI
+};
+
+int  sha1_impl(enum sha1_impl impl);
+
 #endif /* __SHA1_H__ */
 
@@ -0,0 +1,206 @@
+/*
+   Copyright 2020 Andrew Li, Gavin Li
+
+   li.andrew.mail@gmail.com
+   gavinux@gmail.com
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+/*
+ * multi-buffer SHA-256: the rounds of 4, 8 or 16 independent messages
+ * run in the lanes of one vector (GCC vector extensions), so the ALU
+ * width is used by independent work instead of the serial rounds of
+ * one message. each lane takes the next message as soon as its own is
+ * done, so messages of uneven lengths keep the lanes busy
+ */
+#include <string.h>
+#include "sha256.h"
+
+#define MB_MAX_LANES 16
+
+#if defined(__x86_64__) || defined(__i386__)
+#define X4_TARGET  __attribute__((target("sse2")))
+#define X8_TARGET  __attribute__((target("avx2")))
+#define X16_TARGET __attribute__((target("avx512f")))
+#else
+#define X4_TARGET
+#endif
+
+#define Ch(x,y,z)     (((x) & (y)) ^ ((~(x)) & (z)))
+#define Maj(x,y,z)    (((x) & (y)) ^ ((x) & (z)) ^ ((y) & (z)))
+
+#define Sigma0(x)     (ROTR32((x), 2) ^ ROTR32((x),13) ^ ROTR32((x),22))
+#define Sigma1(x)     (ROTR32((x), 6) ^ ROTR32((x),11) ^ ROTR32((x),25))
+#define sigma0(x)     (ROTR32((x), 7) ^ ROTR32((x),18) ^ SHR((x), 3))
+#define sigma1(x)     (ROTR32((x),17) ^ ROTR32((x),19) ^ SHR((x),10))
+
+/*
+ * one block of each lane: state[i][j] is word i of lane j,
+ * blk[j] the 64-byte block of lane j
+ */
+#define SHA256_MB_RUN(name, lanes, target) \
+target \
+static void name(uint32_t state[8][MB_MAX_LANES], const uint8_t *blk[MB_MAX_LANES]) \
+{ \
+	typedef uint32_t v_t __attribute__((vector_size(4 * lanes))); \
+	int i, j; \
+	uint32_t x[16][lanes]; \
+	v_t w[16], a, b, c, d, e, f, g, h, t1, t2; \
+	for (i=0; i<16; i++) \
+		for (j=0; j<lanes; j++) \
+			x[i][j] = load_be32(blk[j] + 4 * i); \
+	memcpy(w, x, sizeof(w)); \
+	memcpy(&a, state[0], sizeof(a)); \
+	memcpy(&b, state[1], sizeof(b)); \
+	memcpy(&c, state[2], sizeof(c)); \
+	memcpy(&d, state[3], sizeof(d)); \
+	memcpy(&e, state[4], sizeof(e)); \
+	memcpy(&f, state[5], sizeof(f)); \
+	memcpy(&g, state[6], sizeof(g)); \
+	memcpy(&h, state[7], sizeof(h)); \
+	for (i=0; i<64; i++) { \
+		if (i >= 16) \
+			w[i&15] += sigma1(w[(i-2)&15]) + w[(i-7)&15] + sigma0(w[(i-15)&15]); \
+		t1 = h + Sigma1(e) + Ch(e, f, g) + sha256_K[i] + w[i&15]; \
+		t2 = Sigma0(a) + Maj(a, b, c); \
+		h = g; g = f; f = e; e = d + t1; \
+		d = c; c = b; b = a; a = t1 + t2; \
+	} \
+	for (j=0; j<lanes; j++) { \
+		state[0][j] += a[j]; \
+		state[1][j] += b[j]; \
+		state[2][j] += c[j]; \
+		state[3][j] += d[j]; \
+		state[4][j] += e[j]; \
+		state[5][j] += f[j]; \
+		state[6][j] += g[j]; \
+		state[7][j] += h[j]; \
+	} \
+}
+
+SHA256_MB_RUN(sha256_x4, 4, X4_TARGET)
+#ifdef X8_TARGET
+SHA256_MB_RUN(sha256_x8, 8, X8_TARGET)
+SHA256_MB_RUN(sha256_x16, 16, X16_TARGET)
+#endif
+
+typedef void (*mb_run_t)(uint32_t state[8][MB_MAX_LANES], const uint8_t *blk[MB_MAX_LANES]);
+
+struct mb_lane {
+	int      msg;    /* the message in the lane, -1 if idle */
+	size_t   blk;    /* the next block */
+	size_t   full;   /* whole blocks read from the message */
+	size_t   nblk;   /* full + 1 or 2 blocks of tail */
+	uint8_t  tail[2 * SHA256_BUF_SIZE]; /* the rest of the message and the padding */
+};
+
+/* puts message msg into lane j, or makes the lane idle when msg is -1 */
+static void lane_load(struct mb_lane *l, uint32_t state[8][MB_MAX_LANES], int j,
+                      int msg, uint8_t *data[], size_t len[], const uint32_t h0[8])
+{
+	int i;
+	size_t r;
+	uint64_t bits;
+
+	l->msg = msg;
+	if (msg < 0) return;
+	r    = len[msg] % SHA256_BUF_SIZE;
+	bits = len[msg] * 8;
+	l->blk  = 0;
+	l->full = len[msg] / SHA256_BUF_SIZE;
+	l->nblk = l->full + (r < SHA256_BUF_SIZE - sizeof(bits) ? 1 : 2);
+	memset(l->tail, 0, sizeof(l->tail));
+	memcpy(l->tail, data[msg] + l->full * SHA256_BUF_SIZE, r);
+	l->tail[r] = 0x80;
+	store_be64(l->tail + (l->nblk - l->full) * SHA256_BUF_SIZE - sizeof(bits), bits);
+	for (i=0; i<8; i++)
+		state[i][j] = h0[i];
+}
+
+static void sha256_mb_lanes(mb_run_t run, int lanes, uint8_t *data[], size_t len[], int n,
+                            uint8_t digest[][SHA256_DIGEST_LENGTH/8])
+{
+	static const uint8_t idle[SHA256_BUF_SIZE];
+	struct mb_lane lane[MB_MAX_LANES];
+	uint32_t state[8][MB_MAX_LANES];
+	const uint8_t *blk[MB_MAX_LANES];
+	sha256_ctx_t ctx;
+	struct mb_lane *l;
+	int i, j, next, active;
+
+	sha256_init(&ctx); /* for the initial hash value */
+	for (next=j=0; j<lanes; j++, next++)
+		lane_load(&lane[j], state, j, next < n ? next : -1, data, len, ctx.state);
+
+	for (active = n < lanes ? n : lanes; active; ) {
+		for (j=0; j<lanes; j++) {
+			l = &lane[j];
+			if (l->msg < 0)
+				blk[j] = idle;
+			else if (l->blk < l->full)
+				blk[j] = data[l->msg] + l->blk * SHA256_BUF_SIZE;
+			else
+				blk[j] = l->tail + (l->blk - l->full) * SHA256_BUF_SIZE;
+		}
+		run(state, blk);
+		for (j=0; j<lanes; j++) {
+			l = &lane[j];
+			if (l->msg < 0 || ++l->blk < l->nblk)
+				continue;
+			for (i=0; i<8; i++)
+				store_be32(digest[l->msg] + 4 * i, state[i][j]);
+			if (next < n) {
+				lane_load(l, state, j, next, data, len, ctx.state);
+				next++;
+			} else {
+				l->msg = -1;
+				active--;
+			}
+		}
+	}
+	memset(lane, 0, sizeof(lane));
+	memset(state, 0, sizeof(state));
+}
+
+int  sha256_mb_impl(uint8_t *data[], size_t len[], int n, uint8_t digest[][SHA256_DIGEST_LENGTH/8],
+                    enum sha256_mb_impl impl)
+{
+#ifdef X8_TARGET
+	__builtin_cpu_init();
+	if (impl == eSHA256_MB_AUTO)
+		impl = __builtin_cpu_supports("avx512f") ? eSHA256_MB_X16 :
+		       __builtin_cpu_supports("avx2")    ? eSHA256_MB_X8  : eSHA256_MB_X4;
+	switch (impl) {
+		case eSHA256_MB_X16:
+			if (!__builtin_cpu_supports("avx512f")) return -1;
+			sha256_mb_lanes(sha256_x16, 16, data, len, n, digest);
+			return 0;
+		case eSHA256_MB_X8:
+			if (!__builtin_cpu_supports("avx2")) return -1;
+			sha256_mb_lanes(sha256_x8, 8, data, len, n, digest);
+			return 0;
+		default:
+			break;
+	}
+#else
+	if (impl != eSHA256_MB_AUTO && impl != eSHA256_MB_X4) return -1;
+#endif
+	sha256_mb_lanes(sha256_x4, 4, data, len, n, digest);
+	return 0;
+}
+
+void sha256_mb(uint8_t *data[], size_t len[], int n, uint8_t digest[][SHA256_DIGEST_LENGTH/8])
+{
+	sha256_mb_impl(data, len, n, digest, eSHA256_MB_AUTO);
+}
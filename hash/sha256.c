@@ -26,11 +26,17 @@
 REGISTER_HASH_ALGO(eHASH_SHA224, sha224_init);
 REGISTER_HASH_ALGO(eHASH_SHA256, sha256_init);
 
-static void sha256_run(uint32_t state[8], uint8_t data[SHA256_BUF_SIZE]);
+static void sha256_run(uint32_t state[8], const uint8_t *data, size_t nblocks);
 static void sha256_update(sha256_ctx_t *ctx, uint8_t *data, size_t len);
 static void sha256_final(sha256_ctx_t *ctx, uint8_t digest[]);
 
-static const uint32_t K[64] = {
+extern int  sha_ni_supported(void);
+extern void sha256_ni_run(uint32_t state[8], const uint8_t *data, size_t nblocks);
+
+static int sha_ni = -1; /* use the SHA extensions, checked once or set by sha256_impl() */
+
+/* shared with the multi-buffer code in sha256-mb.c */
+const uint32_t sha256_K[64] = {
 	0x428a2f98U,0x71374491U,0xb5c0fbcfU,0xe9b5dba5U,
 	0x3956c25bU,0x59f111f1U,0x923f82a4U,0xab1c5ed5U,
 	0xd807aa98U,0x12835b01U,0x243185beU,0x550c7dc3U,
@@ -81,100 +87,122 @@ static const uint32_t H0_256[] = {
 	} while(0)
 
 
-static void sha256_run(uint32_t state[8], uint8_t data[SHA256_BUF_SIZE])
+static void sha256_run(uint32_t state[8], const uint8_t *data, size_t nblocks)
 {
 	uint32_t i, a, b, c, d, e, f, g, h, x[16], t1, t2;
 
-	memcpy(x, data, sizeof(x)); /* avoid alignment issue */
-	for (i=0; i<16; i++)
-		x[i] = swap32(x[i]);
-
-	a = state[0];
-	b = state[1];
-	c = state[2];
-	d = state[3];
-	e = state[4];
-	f = state[5];
-	g = state[6];
-	h = state[7];
-
-	R( a, b, c, d, e, f, g, h, K[ 0], x[ 0], t1, t2 );
-	R( h, a, b, c, d, e, f, g, K[ 1], x[ 1], t1, t2 );
-	R( g, h, a, b, c, d, e, f, K[ 2], x[ 2], t1, t2 );
-	R( f, g, h, a, b, c, d, e, K[ 3], x[ 3], t1, t2 );
-	R( e, f, g, h, a, b, c, d, K[ 4], x[ 4], t1, t2 );
-	R( d, e, f, g, h, a, b, c, K[ 5], x[ 5], t1, t2 );
-	R( c, d, e, f, g, h, a, b, K[ 6], x[ 6], t1, t2 );
-	R( b, c, d, e, f, g, h, a, K[ 7], x[ 7], t1, t2 );
-	R( a, b, c, d, e, f, g, h, K[ 8], x[ 8], t1, t2 );
-	R( h, a, b, c, d, e, f, g, K[ 9], x[ 9], t1, t2 );
-	R( g, h, a, b, c, d, e, f, K[10], x[10], t1, t2 );
-	R( f, g, h, a, b, c, d, e, K[11], x[11], t1, t2 );
-	R( e, f, g, h, a, b, c, d, K[12], x[12], t1, t2 );
-	R( d, e, f, g, h, a, b, c, K[13], x[13], t1, t2 );
-	R( c, d, e, f, g, h, a, b, K[14], x[14], t1, t2 );
-	R( b, c, d, e, f, g, h, a, K[15], x[15], t1, t2 );
-	R( a, b, c, d, e, f, g, h, K[16], W(16), t1, t2 );
-	R( h, a, b, c, d, e, f, g, K[17], W(17), t1, t2 );
-	R( g, h, a, b, c, d, e, f, K[18], W(18), t1, t2 );
-	R( f, g, h, a, b, c, d, e, K[19], W(19), t1, t2 );
-	R( e, f, g, h, a, b, c, d, K[20], W(20), t1, t2 );
-	R( d, e, f, g, h, a, b, c, K[21], W(21), t1, t2 );
-	R( c, d, e, f, g, h, a, b, K[22], W(22), t1, t2 );
-	R( b, c, d, e, f, g, h, a, K[23], W(23), t1, t2 );
-	R( a, b, c, d, e, f, g, h, K[24], W(24), t1, t2 );
-	R( h, a, b, c, d, e, f, g, K[25], W(25), t1, t2 );
-	R( g, h, a, b, c, d, e, f, K[26], W(26), t1, t2 );
-	R( f, g, h, a, b, c, d, e, K[27], W(27), t1, t2 );
-	R( e, f, g, h, a, b, c, d, K[28], W(28), t1, t2 );
-	R( d, e, f, g, h, a, b, c, K[29], W(29), t1, t2 );
-	R( c, d, e, f, g, h, a, b, K[30], W(30), t1, t2 );
-	R( b, c, d, e, f, g, h, a, K[31], W(31), t1, t2 );
-	R( a, b, c, d, e, f, g, h, K[32], W(32), t1, t2 );
-	R( h, a, b, c, d, e, f, g, K[33], W(33), t1, t2 );
-	R( g, h, a, b, c, d, e, f, K[34], W(34), t1, t2 );
-	R( f, g, h, a, b, c, d, e, K[35], W(35), t1, t2 );
-	R( e, f, g, h, a, b, c, d, K[36], W(36), t1, t2 );
-	R( d, e, f, g, h, a, b, c, K[37], W(37), t1, t2 );
-	R( c, d, e, f, g, h, a, b, K[38], W(38), t1, t2 );
-	R( b, c, d, e, f, g, h, a, K[39], W(39), t1, t2 );
-	R( a, b, c, d, e, f, g, h, K[40], W(40), t1, t2 );
-	R( h, a, b, c, d, e, f, g, K[41], W(41), t1, t2 );
-	R( g, h, a, b, c, d, e, f, K[42], W(42), t1, t2 );
-	R( f, g, h, a, b, c, d, e, K[43], W(43), t1, t2 );
-	R( e, f, g, h, a, b, c, d, K[44], W(44), t1, t2 );
-	R( d, e, f, g, h, a, b, c, K[45], W(45), t1, t2 );
-	R( c, d, e, f, g, h, a, b, K[46], W(46), t1, t2 );
-	R( b, c, d, e, f, g, h, a, K[47], W(47), t1, t2 );
-	R( a, b, c, d, e, f, g, h, K[48], W(48), t1, t2 );
-	R( h, a, b, c, d, e, f, g, K[49], W(49), t1, t2 );
-	R( g, h, a, b, c, d, e, f, K[50], W(50), t1, t2 );
-	R( f, g, h, a, b, c, d, e, K[51], W(51), t1, t2 );
-	R( e, f, g, h, a, b, c, d, K[52], W(52), t1, t2 );
-	R( d, e, f, g, h, a, b, c, K[53], W(53), t1, t2 );
-	R( c, d, e, f, g, h, a, b, K[54], W(54), t1, t2 );
-	R( b, c, d, e, f, g, h, a, K[55], W(55), t1, t2 );
-	R( a, b, c, d, e, f, g, h, K[56], W(56), t1, t2 );
-	R( h, a, b, c, d, e, f, g, K[57], W(57), t1, t2 );
-	R( g, h, a, b, c, d, e, f, K[58], W(58), t1, t2 );
-	R( f, g, h, a, b, c, d, e, K[59], W(59), t1, t2 );
-	R( e, f, g, h, a, b, c, d, K[60], W(60), t1, t2 );
-	R( d, e, f, g, h, a, b, c, K[61], W(61), t1, t2 );
-	R( c, d, e, f, g, h, a, b, K[62], W(62), t1, t2 );
-	R( b, c, d, e, f, g, h, a, K[63], W(63), t1, t2 );
-
-	state[0] += a;
-	state[1] += b;
-	state[2] += c;
-	state[3] += d;
-	state[4] += e;
-	state[5] += f;
-	state[6] += g;
-	state[7] += h;
+	for (; nblocks--; data += SHA256_BUF_SIZE) {
+		for (i=0; i<16; i++)
+			x[i] = load_be32(data + 4 * i);
+
+		a = state[0];
+		b = state[1];
+		c = state[2];
+		d = state[3];
+		e = state[4];
+		f = state[5];
+		g = state[6];
+		h = state[7];
+
+		R( a, b, c, d, e, f, g, h, sha256_K[ 0], x[ 0], t1, t2 );
+		R( h, a, b, c, d, e, f, g, sha256_K[ 1], x[ 1], t1, t2 );
+		R( g, h, a, b, c, d, e, f, sha256_K[ 2], x[ 2], t1, t2 );
+		R( f, g, h, a, b, c, d, e, sha256_K[ 3], x[ 3], t1, t2 );
+		R( e, f, g, h, a, b, c, d, sha256_K[ 4], x[ 4], t1, t2 );
+		R( d, e, f, g, h, a, b, c, sha256_K[ 5], x[ 5], t1, t2 );
+		R( c, d, e, f, g, h, a, b, sha256_K[ 6], x[ 6], t1, t2 );
+		R( b, c, d, e, f, g, h, a, sha256_K[ 7], x[ 7], t1, t2 );
+		R( a, b, c, d, e, f, g, h, sha256_K[ 8], x[ 8], t1, t2 );
+		R( h, a, b, c, d, e, f, g, sha256_K[ 9], x[ 9], t1, t2 );
+		R( g, h, a, b, c, d, e, f, sha256_K[10], x[10], t1, t2 );
+		R( f, g, h, a, b, c, d, e, sha256_K[11], x[11], t1, t2 );
+		R( e, f, g, h, a, b, c, d, sha256_K[12], x[12], t1, t2 );
+		R( d, e, f, g, h, a, b, c, sha256_K[13], x[13], t1, t2 );
+		R( c, d, e, f, g, h, a, b, sha256_K[14], x[14], t1, t2 );
+		R( b, c, d, e, f, g, h, a, sha256_K[15], x[15], t1, t2 );
+		R( a, b, c, d, e, f, g, h, sha256_K[16], W(16), t1, t2 );
+		R( h, a, b, c, d, e, f, g, sha256_K[17], W(17), t1, t2 );
+		R( g, h, a, b, c, d, e, f, sha256_K[18], W(18), t1, t2 );
+		R( f, g, h, a, b, c, d, e, sha256_K[19], W(19), t1, t2 );
+		R( e, f, g, h, a, b, c, d, sha256_K[20], W(20), t1, t2 );
+		R( d, e, f, g, h, a, b, c, sha256_K[21], W(21), t1, t2 );
+		R( c, d, e, f, g, h, a, b, sha256_K[22], W(22), t1, t2 );
+		R( b, c, d, e, f, g, h, a, sha256_K[23], W(23), t1, t2 );
+		R( a, b, c, d, e, f, g, h, sha256_K[24], W(24), t1, t2 );
+		R( h, a, b, c, d, e, f, g, sha256_K[25], W(25), t1, t2 );
+		R( g, h, a, b, c, d, e, f, sha256_K[26], W(26), t1, t2 );
+		R( f, g, h, a, b, c, d, e, sha256_K[27], W(27), t1, t2 );
+		R( e, f, g, h, a, b, c, d, sha256_K[28], W(28), t1, t2 );
+		R( d, e, f, g, h, a, b, c, sha256_K[29], W(29), t1, t2 );
+		R( c, d, e, f, g, h, a, b, sha256_K[30], W(30), t1, t2 );
+		R( b, c, d, e, f, g, h, a, sha256_K[31], W(31), t1, t2 );
+		R( a, b, c, d, e, f, g, h, sha256_K[32], W(32), t1, t2 );
+		R( h, a, b, c, d, e, f, g, sha256_K[33], W(33), t1, t2 );
+		R( g, h, a, b, c, d, e, f, sha256_K[34], W(34), t1, t2 );
+		R( f, g, h, a, b, c, d, e, sha256_K[35], W(35), t1, t2 );
+		R( e, f, g, h, a, b, c, d, sha256_K[36], W(36), t1, t2 );
+		R( d, e, f, g, h, a, b, c, sha256_K[37], W(37), t1, t2 );
+		R( c, d, e, f, g, h, a, b, sha256_K[38], W(38), t1, t2 );
+		R( b, c, d, e, f, g, h, a, sha256_K[39], W(39), t1, t2 );
+		R( a, b, c, d, e, f, g, h, sha256_K[40], W(40), t1, t2 );
+		R( h, a, b, c, d, e, f, g, sha256_K[41], W(41), t1, t2 );
+		R( g, h, a, b, c, d, e, f, sha256_K[42], W(42), t1, t2 );
+		R( f, g, h, a, b, c, d, e, sha256_K[43], W(43), t1, t2 );
+		R( e, f, g, h, a, b, c, d, sha256_K[44], W(44), t1, t2 );
+		R( d, e, f, g, h, a, b, c, sha256_K[45], W(45), t1, t2 );
+		R( c, d, e, f, g, h, a, b, sha256_K[46], W(46), t1, t2 );
+		R( b, c, d, e, f, g, h, a, sha256_K[47], W(47), t1, t2 );
+		R( a, b, c, d, e, f, g, h, sha256_K[48], W(48), t1, t2 );
+		R( h, a, b, c, d, e, f, g, sha256_K[49], W(49), t1, t2 );
+		R( g, h, a, b, c, d, e, f, sha256_K[50], W(50), t1, t2 );
+		R( f, g, h, a, b, c, d, e, sha256_K[51], W(51), t1, t2 );
+		R( e, f, g, h, a, b, c, d, sha256_K[52], W(52), t1, t2 );
+		R( d, e, f, g, h, a, b, c, sha256_K[53], W(53), t1, t2 );
+		R( c, d, e, f, g, h, a, b, sha256_K[54], W(54), t1, t2 );
+		R( b, c, d, e, f, g, h, a, sha256_K[55], W(55), t1, t2 );
+		R( a, b, c, d, e, f, g, h, sha256_K[56], W(56), t1, t2 );
+		R( h, a, b, c, d, e, f, g, sha256_K[57], W(57), t1, t2 );
+		R( g, h, a, b, c, d, e, f, sha256_K[58], W(58), t1, t2 );
+		R( f, g, h, a, b, c, d, e, sha256_K[59], W(59), t1, t2 );
+		R( e, f, g, h, a, b, c, d, sha256_K[60], W(60), t1, t2 );
+		R( d, e, f, g, h, a, b, c, sha256_K[61], W(61), t1, t2 );
+		R( c, d, e, f, g, h, a, b, sha256_K[62], W(62), t1, t2 );
+		R( b, c, d, e, f, g, h, a, sha256_K[63], W(63), t1, t2 );
+
+		state[0] += a;
+		state[1] += b;
+		state[2] += c;
+		state[3] += d;
+		state[4] += e;
+		state[5] += f;
+		state[6] += g;
+		state[7] += h;
+	}
+}
+
+int  sha256_impl(enum sha256_impl impl)
+{
+	int ni = sha_ni_supported();
+
+	if (impl == eSHA256_SHA_NI && !ni)
+		return -1;
+	sha_ni = impl == eSHA256_AUTO ? ni : impl == eSHA256_SHA_NI;
+	return 0;
+}
+
+/* nblocks blocks, with the SHA extensions when the CPU has them */
+static inline void sha256_compress(uint32_t state[8], const uint8_t *data, size_t nblocks)
+{
+	if (sha_ni)
+		sha256_ni_run(state, data, nblocks);
+	else
+		sha256_run(state, data, nblocks);
 }
 
 void sha224_init (sha256_ctx_t *ctx)
 {
+	if (sha_ni < 0)
+		sha_ni = sha_ni_supported();
 	memset (ctx,0,sizeof(*ctx));
 	ctx->init     = sha224_init;
 	ctx->update   = sha256_update;
@@ -188,6 +216,8 @@ void sha224_init (sha256_ctx_t *ctx)
 
 void sha256_init (sha256_ctx_t *ctx)
 {
+	if (sha_ni < 0)
+		sha_ni = sha_ni_supported();
 	memset (ctx,0,sizeof(*ctx));
 	ctx->init     = sha256_init;
 	ctx->update   = sha256_update;
@@ -199,46 +229,52 @@ void sha256_init (sha256_ctx_t *ctx)
 	memcpy(ctx->state, H0_256, sizeof(H0_256));
 }
 
+/*
+ * a partial block is completed in ctx->buffer, then the whole blocks
+ * are compressed straight from data in one call, only the tail is copied
+ */
 static void sha256_update(sha256_ctx_t *ctx, uint8_t *data, size_t len)
 {
-	size_t i;
-
-	if (len + ctx->buf_len > SHA256_BUF_SIZE - 1) {
-		i = SHA256_BUF_SIZE - ctx->buf_len;
-		memcpy(&ctx->buffer[ctx->buf_len], data, i);
-		sha256_run(ctx->state, ctx->buffer);
-		for (; i+SHA256_BUF_SIZE-1<len; i+=SHA256_BUF_SIZE) {
-			sha256_run(ctx->state, &data[i]);
-		}
-		ctx->buf_len = len - i;
-		memcpy(&ctx->buffer, &data[i], ctx->buf_len);
-	}
-	else {
-		memcpy(&ctx->buffer[ctx->buf_len], data, len);
-		ctx->buf_len += len;
-	}
+	size_t n;
+
 	ctx->total += len;
+	if (ctx->buf_len) {
+		n = SHA256_BUF_SIZE - ctx->buf_len;
+		if (n > len) n = len;
+		memcpy(&ctx->buffer[ctx->buf_len], data, n);
+		ctx->buf_len += n;
+		data += n;
+		len  -= n;
+		if (ctx->buf_len < SHA256_BUF_SIZE)
+			return;
+		sha256_compress(ctx->state, ctx->buffer, 1);
+		ctx->buf_len = 0;
+	}
+	n = len / SHA256_BUF_SIZE;
+	if (n)
+		sha256_compress(ctx->state, data, n);
+	ctx->buf_len = len % SHA256_BUF_SIZE;
+	memcpy(ctx->buffer, &data[n * SHA256_BUF_SIZE], ctx->buf_len);
 }
 
 static void sha256_final(sha256_ctx_t *ctx, uint8_t digest[])
 {
 	int i;
-	uint8_t byte;
-	uint64_t qw;
-
-	qw = ctx->total * 8;
-	byte = 0x80;
-	sha256_update(ctx, &byte, 1);
-
-	byte = 0x00;
-	while (ctx->buf_len != SHA256_BUF_SIZE - sizeof(qw))
-		sha256_update(ctx, &byte, 1);
-
-	qw = swap64(qw);
-	sha256_update(ctx, (uint8_t *)&qw, sizeof(qw)); /* trigger sha256_run() */
+	uint64_t bits = ctx->total * 8;
+
+	/* 0x80, zeros and the bit length, in one block or two */
+	ctx->buffer[ctx->buf_len++] = 0x80;
+	if (ctx->buf_len > SHA256_BUF_SIZE - sizeof(bits)) {
+		memset(&ctx->buffer[ctx->buf_len], 0, SHA256_BUF_SIZE - ctx->buf_len);
+		sha256_compress(ctx->state, ctx->buffer, 1);
+		ctx->buf_len = 0;
+	}
+	memset(&ctx->buffer[ctx->buf_len], 0, SHA256_BUF_SIZE - sizeof(bits) - ctx->buf_len);
+	store_be64(&ctx->buffer[SHA256_BUF_SIZE - sizeof(bits)], bits);
+	sha256_compress(ctx->state, ctx->buffer, 1);
 
 	for (i=0; i<ARRAY_SIZE(ctx->state); i++)
-		ctx->state[i] = swap32(ctx->state[i]);
+		ctx->state[i] = __builtin_bswap32(ctx->state[i]);
 	memcpy(digest, ctx->state, ctx->md_len/8);
 
 	ctx->init(ctx);
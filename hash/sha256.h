@@ -43,5 +43,33 @@ struct sha256_ctx {
 void sha224_init(sha256_ctx_t *ctx);
 void sha256_init(sha256_ctx_t *ctx);
 
+/* the sha224/sha256 block function, like sha1_impl() and as thread-unsafe */
+enum sha256_impl {
+	eSHA256_AUTO,
+	eSHA256_PORTABLE,
+	eSHA256_SHA_NI
+};
+
+int  sha256_impl(enum sha256_impl impl);
+
+extern const uint32_t sha256_K[64];
+
+/*
+ * multi-buffer SHA-256, the n messages data[i] of len[i] bytes are
+ * hashed in lockstep, one message per SIMD lane, into digest[i].
+ * eSHA256_MB_AUTO takes the widest lanes the CPU has,
+ * sha256_mb_impl() returns -1 if the CPU can't do the lanes asked for
+ */
+enum sha256_mb_impl {
+	eSHA256_MB_AUTO,
+	eSHA256_MB_X4,   /* SSE2 */
+	eSHA256_MB_X8,   /* AVX2 */
+	eSHA256_MB_X16   /* AVX-512 */
+};
+
+void sha256_mb(uint8_t *data[], size_t len[], int n, uint8_t digest[][SHA256_DIGEST_LENGTH/8]);
+int  sha256_mb_impl(uint8_t *data[], size_t len[], int n, uint8_t digest[][SHA256_DIGEST_LENGTH/8],
+                    enum sha256_mb_impl impl);
+
 #endif /* __SHA256_H__ */
 
@@ -128,7 +128,7 @@ void sha3_512_init (sha3_ctx_t *ctx)
 	sha3_init(ctx, SHA512_DIGEST_LENGTH, sha3_512_init);
 }
 
-static void sha3_update(sha3_ctx_t *ctx, uint8_t *data, size_t len)
+static void sha3_absorb(sha3_ctx_t *ctx, uint8_t *data, size_t len)
 {
 	size_t i;
 	uint8_t *state;
@@ -144,6 +144,33 @@ static void sha3_update(sha3_ctx_t *ctx, uint8_t *data, size_t len)
 	}
 }
 
+/*
+ * whole blocks are xored into the state a 64-bit lane at a time
+ * straight from data, bytes only before and after them.
+ * the rates are multiples of 8 bytes, lanes are little-endian
+ */
+static void sha3_update(sha3_ctx_t *ctx, uint8_t *data, size_t len)
+{
+	size_t i, n;
+	uint64_t x, *lane = (uint64_t *)ctx->state;
+
+	if (ctx->buf_len) {
+		n = ctx->buf_size - ctx->buf_len;
+		if (n > len) n = len;
+		sha3_absorb(ctx, data, n);
+		data += n;
+		len  -= n;
+	}
+	for (; len >= ctx->buf_size && !ctx->buf_len; len -= ctx->buf_size) {
+		for (i=0; i<ctx->buf_size/8; i++, data += 8) {
+			memcpy(&x, data, sizeof(x));
+			lane[i] ^= x;
+		}
+		sha3_run(ctx->state);
+	}
+	sha3_absorb(ctx, data, len);
+}
+
 static void sha3_final(sha3_ctx_t *ctx, uint8_t digest[])
 {
 	uint8_t padding[5*5*sizeof(uint64_t)];
@@ -28,10 +28,12 @@ REGISTER_HASH_ALGO(eHASH_SHA512_256, sha512_256_init);
 REGISTER_HASH_ALGO(eHASH_SHA384,     sha384_init);
 REGISTER_HASH_ALGO(eHASH_SHA512,     sha512_init);
 
-static void sha512_run(uint64_t state[8], uint8_t data[SHA512_BUF_SIZE]);
+static void sha512_run(uint64_t state[8], const uint8_t *data, size_t nblocks);
 static void sha512_update(sha512_ctx_t *ctx, uint8_t *data, size_t len);
 static void sha512_final(sha512_ctx_t *ctx, uint8_t digest[]);
 
+static int sha512_simd = -1; /* 2: AVX-512VL, 1: AVX2, 0: none, checked once or set by sha512_impl() */
+
 static const uint64_t K[80] = {
 	0x428a2f98d728ae22UL,0x7137449123ef65cdUL,
 	0xb5c0fbcfec4d3b2fUL,0xe9b5dba58189dbbcUL,
@@ -123,116 +125,263 @@ static const uint64_t H0_512[] = {
 	} while(0)
 
 
-static void sha512_run(uint64_t state[8], uint8_t data[SHA512_BUF_SIZE])
+static void sha512_run(uint64_t state[8], const uint8_t *data, size_t nblocks)
 {
 	uint64_t i, a, b, c, d, e, f, g, h, x[16], t1, t2;
 
-	memcpy(x, data, sizeof(x)); /* avoid alignment issue */
-	for (i=0; i<16; i++)
-		x[i] = swap64(x[i]);
-
-	a = state[0];
-	b = state[1];
-	c = state[2];
-	d = state[3];
-	e = state[4];
-	f = state[5];
-	g = state[6];
-	h = state[7];
-
-	R( a, b, c, d, e, f, g, h, K[ 0], x[ 0], t1, t2 );
-	R( h, a, b, c, d, e, f, g, K[ 1], x[ 1], t1, t2 );
-	R( g, h, a, b, c, d, e, f, K[ 2], x[ 2], t1, t2 );
-	R( f, g, h, a, b, c, d, e, K[ 3], x[ 3], t1, t2 );
-	R( e, f, g, h, a, b, c, d, K[ 4], x[ 4], t1, t2 );
-	R( d, e, f, g, h, a, b, c, K[ 5], x[ 5], t1, t2 );
-	R( c, d, e, f, g, h, a, b, K[ 6], x[ 6], t1, t2 );
-	R( b, c, d, e, f, g, h, a, K[ 7], x[ 7], t1, t2 );
-	R( a, b, c, d, e, f, g, h, K[ 8], x[ 8], t1, t2 );
-	R( h, a, b, c, d, e, f, g, K[ 9], x[ 9], t1, t2 );
-	R( g, h, a, b, c, d, e, f, K[10], x[10], t1, t2 );
-	R( f, g, h, a, b, c, d, e, K[11], x[11], t1, t2 );
-	R( e, f, g, h, a, b, c, d, K[12], x[12], t1, t2 );
-	R( d, e, f, g, h, a, b, c, K[13], x[13], t1, t2 );
-	R( c, d, e, f, g, h, a, b, K[14], x[14], t1, t2 );
-	R( b, c, d, e, f, g, h, a, K[15], x[15], t1, t2 );
-	R( a, b, c, d, e, f, g, h, K[16], W(16), t1, t2 );
-	R( h, a, b, c, d, e, f, g, K[17], W(17), t1, t2 );
-	R( g, h, a, b, c, d, e, f, K[18], W(18), t1, t2 );
-	R( f, g, h, a, b, c, d, e, K[19], W(19), t1, t2 );
-	R( e, f, g, h, a, b, c, d, K[20], W(20), t1, t2 );
-	R( d, e, f, g, h, a, b, c, K[21], W(21), t1, t2 );
-	R( c, d, e, f, g, h, a, b, K[22], W(22), t1, t2 );
-	R( b, c, d, e, f, g, h, a, K[23], W(23), t1, t2 );
-	R( a, b, c, d, e, f, g, h, K[24], W(24), t1, t2 );
-	R( h, a, b, c, d, e, f, g, K[25], W(25), t1, t2 );
-	R( g, h, a, b, c, d, e, f, K[26], W(26), t1, t2 );
-	R( f, g, h, a, b, c, d, e, K[27], W(27), t1, t2 );
-	R( e, f, g, h, a, b, c, d, K[28], W(28), t1, t2 );
-	R( d, e, f, g, h, a, b, c, K[29], W(29), t1, t2 );
-	R( c, d, e, f, g, h, a, b, K[30], W(30), t1, t2 );
-	R( b, c, d, e, f, g, h, a, K[31], W(31), t1, t2 );
-	R( a, b, c, d, e, f, g, h, K[32], W(32), t1, t2 );
-	R( h, a, b, c, d, e, f, g, K[33], W(33), t1, t2 );
-	R( g, h, a, b, c, d, e, f, K[34], W(34), t1, t2 );
-	R( f, g, h, a, b, c, d, e, K[35], W(35), t1, t2 );
-	R( e, f, g, h, a, b, c, d, K[36], W(36), t1, t2 );
-	R( d, e, f, g, h, a, b, c, K[37], W(37), t1, t2 );
-	R( c, d, e, f, g, h, a, b, K[38], W(38), t1, t2 );
-	R( b, c, d, e, f, g, h, a, K[39], W(39), t1, t2 );
-	R( a, b, c, d, e, f, g, h, K[40], W(40), t1, t2 );
-	R( h, a, b, c, d, e, f, g, K[41], W(41), t1, t2 );
-	R( g, h, a, b, c, d, e, f, K[42], W(42), t1, t2 );
-	R( f, g, h, a, b, c, d, e, K[43], W(43), t1, t2 );
-	R( e, f, g, h, a, b, c, d, K[44], W(44), t1, t2 );
-	R( d, e, f, g, h, a, b, c, K[45], W(45), t1, t2 );
-	R( c, d, e, f, g, h, a, b, K[46], W(46), t1, t2 );
-	R( b, c, d, e, f, g, h, a, K[47], W(47), t1, t2 );
-	R( a, b, c, d, e, f, g, h, K[48], W(48), t1, t2 );
-	R( h, a, b, c, d, e, f, g, K[49], W(49), t1, t2 );
-	R( g, h, a, b, c, d, e, f, K[50], W(50), t1, t2 );
-	R( f, g, h, a, b, c, d, e, K[51], W(51), t1, t2 );
-	R( e, f, g, h, a, b, c, d, K[52], W(52), t1, t2 );
-	R( d, e, f, g, h, a, b, c, K[53], W(53), t1, t2 );
-	R( c, d, e, f, g, h, a, b, K[54], W(54), t1, t2 );
-	R( b, c, d, e, f, g, h, a, K[55], W(55), t1, t2 );
-	R( a, b, c, d, e, f, g, h, K[56], W(56), t1, t2 );
-	R( h, a, b, c, d, e, f, g, K[57], W(57), t1, t2 );
-	R( g, h, a, b, c, d, e, f, K[58], W(58), t1, t2 );
-	R( f, g, h, a, b, c, d, e, K[59], W(59), t1, t2 );
-	R( e, f, g, h, a, b, c, d, K[60], W(60), t1, t2 );
-	R( d, e, f, g, h, a, b, c, K[61], W(61), t1, t2 );
-	R( c, d, e, f, g, h, a, b, K[62], W(62), t1, t2 );
-	R( b, c, d, e, f, g, h, a, K[63], W(63), t1, t2 );
-	R( a, b, c, d, e, f, g, h, K[64], W(64), t1, t2 );
-	R( h, a, b, c, d, e, f, g, K[65], W(65), t1, t2 );
-	R( g, h, a, b, c, d, e, f, K[66], W(66), t1, t2 );
-	R( f, g, h, a, b, c, d, e, K[67], W(67), t1, t2 );
-	R( e, f, g, h, a, b, c, d, K[68], W(68), t1, t2 );
-	R( d, e, f, g, h, a, b, c, K[69], W(69), t1, t2 );
-	R( c, d, e, f, g, h, a, b, K[70], W(70), t1, t2 );
-	R( b, c, d, e, f, g, h, a, K[71], W(71), t1, t2 );
-	R( a, b, c, d, e, f, g, h, K[72], W(72), t1, t2 );
-	R( h, a, b, c, d, e, f, g, K[73], W(73), t1, t2 );
-	R( g, h, a, b, c, d, e, f, K[74], W(74), t1, t2 );
-	R( f, g, h, a, b, c, d, e, K[75], W(75), t1, t2 );
-	R( e, f, g, h, a, b, c, d, K[76], W(76), t1, t2 );
-	R( d, e, f, g, h, a, b, c, K[77], W(77), t1, t2 );
-	R( c, d, e, f, g, h, a, b, K[78], W(78), t1, t2 );
-	R( b, c, d, e, f, g, h, a, K[79], W(79), t1, t2 );
-
-	state[0] += a;
-	state[1] += b;
-	state[2] += c;
-	state[3] += d;
-	state[4] += e;
-	state[5] += f;
-	state[6] += g;
-	state[7] += h;
+	for (; nblocks--; data += SHA512_BUF_SIZE) {
+		for (i=0; i<16; i++)
+			x[i] = load_be64(data + 8 * i);
+
+		a = state[0];
+		b = state[1];
+		c = state[2];
+		d = state[3];
+		e = state[4];
+		f = state[5];
+		g = state[6];
+		h = state[7];
+
+		R( a, b, c, d, e, f, g, h, K[ 0], x[ 0], t1, t2 );
+		R( h, a, b, c, d, e, f, g, K[ 1], x[ 1], t1, t2 );
+		R( g, h, a, b, c, d, e, f, K[ 2], x[ 2], t1, t2 );
+		R( f, g, h, a, b, c, d, e, K[ 3], x[ 3], t1, t2 );
+		R( e, f, g, h, a, b, c, d, K[ 4], x[ 4], t1, t2 );
+		R( d, e, f, g, h, a, b, c, K[ 5], x[ 5], t1, t2 );
+		R( c, d, e, f, g, h, a, b, K[ 6], x[ 6], t1, t2 );
+		R( b, c, d, e, f, g, h, a, K[ 7], x[ 7], t1, t2 );
+		R( a, b, c, d, e, f, g, h, K[ 8], x[ 8], t1, t2 );
+		R( h, a, b, c, d, e, f, g, K[ 9], x[ 9], t1, t2 );
+		R( g, h, a, b, c, d, e, f, K[10], x[10], t1, t2 );
+		R( f, g, h, a, b, c, d, e, K[11], x[11], t1, t2 );
+		R( e, f, g, h, a, b, c, d, K[12], x[12], t1, t2 );
+		R( d, e, f, g, h, a, b, c, K[13], x[13], t1, t2 );
+		R( c, d, e, f, g, h, a, b, K[14], x[14], t1, t2 );
+		R( b, c, d, e, f, g, h, a, K[15], x[15], t1, t2 );
+		R( a, b, c, d, e, f, g, h, K[16], W(16), t1, t2 );
+		R( h, a, b, c, d, e, f, g, K[17], W(17), t1, t2 );
+		R( g, h, a, b, c, d, e, f, K[18], W(18), t1, t2 );
+		R( f, g, h, a, b, c, d, e, K[19], W(19), t1, t2 );
+		R( e, f, g, h, a, b, c, d, K[20], W(20), t1, t2 );
+		R( d, e, f, g, h, a, b, c, K[21], W(21), t1, t2 );
+		R( c, d, e, f, g, h, a, b, K[22], W(22), t1, t2 );
+		R( b, c, d, e, f, g, h, a, K[23], W(23), t1, t2 );
+		R( a, b, c, d, e, f, g, h, K[24], W(24), t1, t2 );
+		R( h, a, b, c, d, e, f, g, K[25], W(25), t1, t2 );
+		R( g, h, a, b, c, d, e, f, K[26], W(26), t1, t2 );
+		R( f, g, h, a, b, c, d, e, K[27], W(27), t1, t2 );
+		R( e, f, g, h, a, b, c, d, K[28], W(28), t1, t2 );
+		R( d, e, f, g, h, a, b, c, K[29], W(29), t1, t2 );
+		R( c, d, e, f, g, h, a, b, K[30], W(30), t1, t2 );
+		R( b, c, d, e, f, g, h, a, K[31], W(31), t1, t2 );
+		R( a, b, c, d, e, f, g, h, K[32], W(32), t1, t2 );
+		R( h, a, b, c, d, e, f, g, K[33], W(33), t1, t2 );
+		R( g, h, a, b, c, d, e, f, K[34], W(34), t1, t2 );
+		R( f, g, h, a, b, c, d, e, K[35], W(35), t1, t2 );
+		R( e, f, g, h, a, b, c, d, K[36], W(36), t1, t2 );
+		R( d, e, f, g, h, a, b, c, K[37], W(37), t1, t2 );
+		R( c, d, e, f, g, h, a, b, K[38], W(38), t1, t2 );
+		R( b, c, d, e, f, g, h, a, K[39], W(39), t1, t2 );
+		R( a, b, c, d, e, f, g, h, K[40], W(40), t1, t2 );
+		R( h, a, b, c, d, e, f, g, K[41], W(41), t1, t2 );
+		R( g, h, a, b, c, d, e, f, K[42], W(42), t1, t2 );
+		R( f, g, h, a, b, c, d, e, K[43], W(43), t1, t2 );
+		R( e, f, g, h, a, b, c, d, K[44], W(44), t1, t2 );
+		R( d, e, f, g, h, a, b, c, K[45], W(45), t1, t2 );
+		R( c, d, e, f, g, h, a, b, K[46], W(46), t1, t2 );
+		R( b, c, d, e, f, g, h, a, K[47], W(47), t1, t2 );
+		R( a, b, c, d, e, f, g, h, K[48], W(48), t1, t2 );
+		R( h, a, b, c, d, e, f, g, K[49], W(49), t1, t2 );
+		R( g, h, a, b, c, d, e, f, K[50], W(50), t1, t2 );
+		R( f, g, h, a, b, c, d, e, K[51], W(51), t1, t2 );
+		R( e, f, g, h, a, b, c, d, K[52], W(52), t1, t2 );
+		R( d, e, f, g, h, a, b, c, K[53], W(53), t1, t2 );
+		R( c, d, e, f, g, h, a, b, K[54], W(54), t1, t2 );
+		R( b, c, d, e, f, g, h, a, K[55], W(55), t1, t2 );
+		R( a, b, c, d, e, f, g, h, K[56], W(56), t1, t2 );
+		R( h, a, b, c, d, e, f, g, K[57], W(57), t1, t2 );
+		R( g, h, a, b, c, d, e, f, K[58], W(58), t1, t2 );
+		R( f, g, h, a, b, c, d, e, K[59], W(59), t1, t2 );
+		R( e, f, g, h, a, b, c, d, K[60], W(60), t1, t2 );
+		R( d, e, f, g, h, a, b, c, K[61], W(61), t1, t2 );
+		R( c, d, e, f, g, h, a, b, K[62], W(62), t1, t2 );
+		R( b, c, d, e, f, g, h, a, K[63], W(63), t1, t2 );
+		R( a, b, c, d, e, f, g, h, K[64], W(64), t1, t2 );
+		R( h, a, b, c, d, e, f, g, K[65], W(65), t1, t2 );
+		R( g, h, a, b, c, d, e, f, K[66], W(66), t1, t2 );
+		R( f, g, h, a, b, c, d, e, K[67], W(67), t1, t2 );
+		R( e, f, g, h, a, b, c, d, K[68], W(68), t1, t2 );
+		R( d, e, f, g, h, a, b, c, K[69], W(69), t1, t2 );
+		R( c, d, e, f, g, h, a, b, K[70], W(70), t1, t2 );
+		R( b, c, d, e, f, g, h, a, K[71], W(71), t1, t2 );
+		R( a, b, c, d, e, f, g, h, K[72], W(72), t1, t2 );
+		R( h, a, b, c, d, e, f, g, K[73], W(73), t1, t2 );
+		R( g, h, a, b, c, d, e, f, K[74], W(74), t1, t2 );
+		R( f, g, h, a, b, c, d, e, K[75], W(75), t1, t2 );
+		R( e, f, g, h, a, b, c, d, K[76], W(76), t1, t2 );
+		R( d, e, f, g, h, a, b, c, K[77], W(77), t1, t2 );
+		R( c, d, e, f, g, h, a, b, K[78], W(78), t1, t2 );
+		R( b, c, d, e, f, g, h, a, K[79], W(79), t1, t2 );
+
+		state[0] += a;
+		state[1] += b;
+		state[2] += c;
+		state[3] += d;
+		state[4] += e;
+		state[5] += f;
+		state[6] += g;
+		state[7] += h;
+	}
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SIMD_AVX2_TARGET   __attribute__((target("avx2,bmi2")))
+#define SIMD_AVX512_TARGET __attribute__((target("avx2,bmi2,avx512f,avx512vl")))
+
+/* eight rounds on w[] = W + K, the variables rotate back to their places */
+#define R8(t)                                                             \
+	do {                                                              \
+		R( a, b, c, d, e, f, g, h, 0, w[t+0], t1, t2 );           \
+		R( h, a, b, c, d, e, f, g, 0, w[t+1], t1, t2 );           \
+		R( g, h, a, b, c, d, e, f, 0, w[t+2], t1, t2 );           \
+		R( f, g, h, a, b, c, d, e, 0, w[t+3], t1, t2 );           \
+		R( e, f, g, h, a, b, c, d, 0, w[t+4], t1, t2 );           \
+		R( d, e, f, g, h, a, b, c, 0, w[t+5], t1, t2 );           \
+		R( c, d, e, f, g, h, a, b, 0, w[t+6], t1, t2 );           \
+		R( b, c, d, e, f, g, h, a, 0, w[t+7], t1, t2 );           \
+	} while(0)
+
+/*
+ * W[t..t+3] from X0..X3 = W[t-16..t-1], the result replaces X0.
+ * W[t+2], W[t+3] need W[t], W[t+1] of the same vector, so sigma1 is
+ * added to the low half first, then to the high half
+ */
+#define SCHED4(X0, X1, X2, X3, t)                                         \
+	do {                                                              \
+		y   = __builtin_shuffle(X0, X1, (m4_t){1, 2, 3, 4});      \
+		X0 += sigma0(y);                                          \
+		X0 += __builtin_shuffle(X2, X3, (m4_t){1, 2, 3, 4});      \
+		y   = __builtin_shuffle(X3, (m4_t){2, 3, 2, 3});          \
+		X0 += sigma1(y) & lo;                                     \
+		y   = __builtin_shuffle(X0, (m4_t){0, 1, 0, 1});          \
+		X0 += sigma1(y) & ~lo;                                    \
+		memcpy(&y, &K[t], sizeof(y));                             \
+		y  += X0;                                                 \
+		memcpy(&w[t], &y, sizeof(y));                             \
+	} while(0)
+
+/*
+ * the message schedule 4 words at a time, kept in four 256-bit vectors
+ * (GCC vector extensions, the rotations become vprorq with AVX-512VL).
+ * the next 16 words are computed between the rounds on the current 16,
+ * so the vector work overlaps the rounds. the rounds stay scalar, each
+ * one depends on the one before
+ */
+#define SHA512_SIMD_RUN(name, target)                                          \
+target                                                                         \
+static void name(uint64_t state[8], const uint8_t *data, size_t nblocks)      \
+{                                                                              \
+	typedef uint64_t v4_t __attribute__((vector_size(32)));               \
+	typedef int64_t  m4_t __attribute__((vector_size(32)));               \
+	typedef uint8_t  b32_t __attribute__((vector_size(32)));              \
+	const v4_t  lo = {UINT64_MAX, UINT64_MAX, 0, 0};                       \
+	const b32_t be = { 7,  6,  5,  4,  3,  2,  1,  0,                      \
+	                  15, 14, 13, 12, 11, 10,  9,  8,                      \
+	                  23, 22, 21, 20, 19, 18, 17, 16,                      \
+	                  31, 30, 29, 28, 27, 26, 25, 24 };                    \
+	uint64_t t, a, b, c, d, e, f, g, h, t1, t2, w[80];                     \
+	v4_t x[4], y;                                                          \
+	b32_t z;                                                               \
+	for (; nblocks--; data += SHA512_BUF_SIZE) {                           \
+		for (t=0; t<4; t++) {                                          \
+			memcpy(&z, data + 32 * t, sizeof(z));                  \
+			x[t] = (v4_t)__builtin_shuffle(z, be);                 \
+			memcpy(&y, &K[4 * t], sizeof(y));                      \
+			y += x[t];                                             \
+			memcpy(&w[4 * t], &y, sizeof(y));                      \
+		}                                                              \
+		a = state[0];                                                  \
+		b = state[1];                                                  \
+		c = state[2];                                                  \
+		d = state[3];                                                  \
+		e = state[4];                                                  \
+		f = state[5];                                                  \
+		g = state[6];                                                  \
+		h = state[7];                                                  \
+		for (t=0; t<64; t+=16) {                                       \
+			SCHED4(x[0], x[1], x[2], x[3], t + 16);                \
+			SCHED4(x[1], x[2], x[3], x[0], t + 20);                \
+			R8(t);                                                 \
+			SCHED4(x[2], x[3], x[0], x[1], t + 24);                \
+			SCHED4(x[3], x[0], x[1], x[2], t + 28);                \
+			R8(t + 8);                                             \
+		}                                                              \
+		R8(64);                                                        \
+		R8(72);                                                        \
+		state[0] += a;                                                 \
+		state[1] += b;                                                 \
+		state[2] += c;                                                 \
+		state[3] += d;                                                 \
+		state[4] += e;                                                 \
+		state[5] += f;                                                 \
+		state[6] += g;                                                 \
+		state[7] += h;                                                 \
+	}                                                                      \
+}
+
+SHA512_SIMD_RUN(sha512_avx2_run,   SIMD_AVX2_TARGET)
+SHA512_SIMD_RUN(sha512_avx512_run, SIMD_AVX512_TARGET)
+
+static int sha512_simd_supported(void)
+{
+	__builtin_cpu_init();
+	if (!__builtin_cpu_supports("avx2") || !__builtin_cpu_supports("bmi2"))
+		return 0;
+	if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vl"))
+		return 2;
+	return 1;
+}
+
+#else /* portable code only */
+
+static int sha512_simd_supported(void)
+{
+	return 0;
+}
+
+#endif
+
+/* nblocks blocks, with the widest vectors the CPU has for the schedule */
+static inline void sha512_compress(uint64_t state[8], const uint8_t *data, size_t nblocks)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	if (sha512_simd == 2)
+		sha512_avx512_run(state, data, nblocks);
+	else if (sha512_simd == 1)
+		sha512_avx2_run(state, data, nblocks);
+	else
+#endif
+		sha512_run(state, data, nblocks);
+}
+
+int  sha512_impl(enum sha512_impl impl)
+{
+	int simd = sha512_simd_supported();
+
+	if (impl == eSHA512_AUTO) {
+		sha512_simd = simd;
+		return 0;
+	}
+	if ((int)impl - eSHA512_PORTABLE > simd)
+		return -1;
+	sha512_simd = (int)impl - eSHA512_PORTABLE;
+	return 0;
 }
 
 void sha512_224_init (sha512_ctx_t *ctx)
 {
+        if (sha512_simd < 0)
+                sha512_simd = sha512_simd_supported();
         memset (ctx,0,sizeof(*ctx));
         ctx->init     = sha512_224_init;
         ctx->update   = sha512_update;
@@ -246,6 +395,8 @@ void sha512_224_init (sha512_ctx_t *ctx)
 
 void sha512_256_init (sha512_ctx_t *ctx)
 {
+        if (sha512_simd < 0)
+                sha512_simd = sha512_simd_supported();
         memset (ctx,0,sizeof(*ctx));
         ctx->init     = sha512_256_init;
         ctx->update   = sha512_update;
@@ -259,6 +410,8 @@ void sha512_256_init (sha512_ctx_t *ctx)
 
 void sha384_init (sha512_ctx_t *ctx)
 {
+	if (sha512_simd < 0)
+		sha512_simd = sha512_simd_supported();
 	memset (ctx,0,sizeof(*ctx));
 	ctx->init     = sha384_init;
 	ctx->update   = sha512_update;
@@ -272,6 +425,8 @@ void sha384_init (sha512_ctx_t *ctx)
 
 void sha512_init (sha512_ctx_t *ctx)
 {
+	if (sha512_simd < 0)
+		sha512_simd = sha512_simd_supported();
 	memset (ctx,0,sizeof(*ctx));
 	ctx->init     = sha512_init;
 	ctx->update   = sha512_update;
@@ -283,48 +438,55 @@ void sha512_init (sha512_ctx_t *ctx)
 	memcpy(ctx->state, H0_512, sizeof(H0_512));
 }
 
+/*
+ * a partial block is completed in ctx->buffer, then the whole blocks
+ * are compressed straight from data in one call, only the tail is copied
+ */
 static void sha512_update(sha512_ctx_t *ctx, uint8_t *data, size_t len)
 {
-	size_t i;
-
-	if (len + ctx->buf_len > SHA512_BUF_SIZE - 1) {
-		i = SHA512_BUF_SIZE - ctx->buf_len;
-		memcpy(&ctx->buffer[ctx->buf_len], data, i);
-		sha512_run(ctx->state, ctx->buffer);
-		for (; i+SHA512_BUF_SIZE-1<len; i+=SHA512_BUF_SIZE) {
-			sha512_run(ctx->state, &data[i]);
-		}
-		ctx->buf_len = len - i;
-		memcpy(&ctx->buffer, &data[i], ctx->buf_len);
-	}
-	else {
-		memcpy(&ctx->buffer[ctx->buf_len], data, len);
-		ctx->buf_len += len;
-	}
+	size_t n;
+
 	ctx->total += len;
+	if (ctx->buf_len) {
+		n = SHA512_BUF_SIZE - ctx->buf_len;
+		if (n > len) n = len;
+		memcpy(&ctx->buffer[ctx->buf_len], data, n);
+		ctx->buf_len += n;
+		data += n;
+		len  -= n;
+		if (ctx->buf_len < SHA512_BUF_SIZE)
+			return;
+		sha512_compress(ctx->state, ctx->buffer, 1);
+		ctx->buf_len = 0;
+	}
+	n = len / SHA512_BUF_SIZE;
+	if (n)
+		sha512_compress(ctx->state, data, n);
+	ctx->buf_len = len % SHA512_BUF_SIZE;
+	memcpy(ctx->buffer, &data[n * SHA512_BUF_SIZE], ctx->buf_len);
 }
 
 static void sha512_final(sha512_ctx_t *ctx, uint8_t digest[])
 {
 	int i;
-	uint8_t byte;
-	uint128_t xw; /* 16 bytes */
-
-	xw = ctx->total * 8;
-	byte = 0x80;
-	sha512_update(ctx, &byte, 1);
-
-	byte = 0x00;
-	while (ctx->buf_len != SHA512_BUF_SIZE - sizeof(xw))
-		sha512_update(ctx, &byte, 1);
-
-	xw = swap128(xw);
-	sha512_update(ctx, (uint8_t *)&xw, sizeof(xw)); /* trigger sha512_run() */
+	uint128_t bits = ctx->total * 8;
+
+	/* 0x80, zeros and the bit length, in one block or two */
+	ctx->buffer[ctx->buf_len++] = 0x80;
+	if (ctx->buf_len > SHA512_BUF_SIZE - sizeof(bits)) {
+		memset(&ctx->buffer[ctx->buf_len], 0, SHA512_BUF_SIZE - ctx->buf_len);
+		sha512_compress(ctx->state, ctx->buffer, 1);
+		ctx->buf_len = 0;
+	}
+	memset(&ctx->buffer[ctx->buf_len], 0, SHA512_BUF_SIZE - sizeof(bits) - ctx->buf_len);
+	store_be64(&ctx->buffer[SHA512_BUF_SIZE - sizeof(bits)], bits >> 64);
+	store_be64(&ctx->buffer[SHA512_BUF_SIZE - sizeof(uint64_t)], bits);
+	sha512_compress(ctx->state, ctx->buffer, 1);
 
 	for (i=0; i<ARRAY_SIZE(ctx->state); i++)
-		ctx->state[i] = swap64(ctx->state[i]);
+		ctx->state[i] = __builtin_bswap64(ctx->state[i]);
 	memcpy(digest, ctx->state, ctx->md_len/8);
-	
+
 	ctx->init(ctx);
 }
 
@@ -46,5 +46,21 @@ void sha512_256_init(sha512_ctx_t *ctx);
 void sha384_init(sha512_ctx_t *ctx);
 void sha512_init(sha512_ctx_t *ctx);
 
+/*
+ * the kernel used from now on by every sha384/sha512 context of the
+ * process, for tests and benchmarks: AUTO is the widest vectors the
+ * CPU has. returns -1 if the CPU can't run the one asked for.
+ * not thread-safe, like sha1_impl(): call it before any thread
+ * starts hashing
+ */
+enum sha512_impl {
+	eSHA512_AUTO,
+	eSHA512_PORTABLE,
+	eSHA512_AVX2,
+	eSHA512_AVX512   /* AVX-512VL */
+};
+
+int  sha512_impl(enum sha512_impl impl);
+
 #endif /* __SHA512_H__ */
 
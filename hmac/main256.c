@@ -32,7 +32,7 @@
  * https://csrc.nist.gov/CSRC/media/Projects/Cryptographic-Standards-and-Guidelines/documents/examples/HMAC_SHA256.pdf
  */
 
-int main(int argc, char *argv[])
+static void run_tests(void)
 {
 	hmac_ctx_t hmac;
 	int len, key_len;
@@ -83,7 +83,29 @@ int main(int argc, char *argv[])
 	hmac.update(&hmac, data4, strlen(data4));
 	len = hmac.final(&hmac, dgst);
 	assert(!memcmp(expdgst, dgst, len));
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct {
+		enum sha256_impl impl;
+		const char *name;
+	} impls[] = {
+		{ eSHA256_PORTABLE, "portable" },
+		{ eSHA256_SHA_NI,   "sha-ni" },
+	};
+	int i;
 
+	/* every block function this CPU can run */
+	for (i=0; i<ARRAY_SIZE(impls); i++) {
+		if (sha256_impl(impls[i].impl)) {
+			printf("%s: not supported by this CPU\n", impls[i].name);
+			continue;
+		}
+		run_tests();
+		printf("%s: passed\n", impls[i].name);
+	}
+	sha256_impl(eSHA256_AUTO);
 
 	printf("ALL TEST PASSED!\n");
 	return 0;
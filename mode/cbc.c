@@ -45,24 +45,32 @@ static size_t cbc_encrypt(cipher_ctx_t *ctx, uint8_t *buf, size_t len)
 	return len;
 }
 
+/*
+ * blocks don't depend on each other in decryption, CBC_BATCH blocks are
+ * decrypted by one call, then XORed with the saved previous ciphertexts
+ */
+#define CBC_BATCH 8
+
 static size_t cbc_decrypt(cipher_ctx_t *ctx, uint8_t *buf, size_t len)
 {
-	size_t i, j;
+	size_t i, j, n;
 	int blklen = ctx->cipher->blklen / 8;
-	uint8_t  iv[CIPHER_CTX_MAX_BLK_LEN];
-	uint8_t  iv1[CIPHER_CTX_MAX_BLK_LEN];
+	uint8_t  prev[(CBC_BATCH + 1) * CIPHER_CTX_MAX_BLK_LEN];
 
 	assert(len % blklen == 0);
 
-	memcpy(iv, ctx->iv, blklen);
-	for (i=0; i<len; i+=blklen) {
-		memcpy(iv1, buf, blklen);
-		ctx->cipher->decrypt(ctx->cipher, buf, 1);
-		for (j=0; j<blklen; j++)
-			*buf++ ^= iv[j];
-		memcpy(iv, iv1, blklen);
+	/* prev holds the IV followed by the ciphertext of the batch */
+	memcpy(prev, ctx->iv, blklen);
+	for (i=0; i<len; i+=n) {
+		n = len - i;
+		if (n > CBC_BATCH * blklen) n = CBC_BATCH * blklen;
+		memcpy(prev + blklen, buf, n);
+		ctx->cipher->decrypt(ctx->cipher, buf, n / blklen);
+		for (j=0; j<n; j++)
+			*buf++ ^= prev[j];
+		memcpy(prev, prev + n, blklen);
 	}
-	memcpy(ctx->iv, iv, blklen);
+	memcpy(ctx->iv, prev, blklen);
 
 	if (ctx->pad)
 		i = ctx->pad->unpad(buf - blklen, blklen);
@@ -85,6 +93,10 @@ void cbc_init(cipher_ctx_t *ctx, blk_ctx_t *blk_ctx, pad_ctx_t *pad, uint8_t *iv
 	ctx->init    = cbc_init;
 	ctx->encrypt = cbc_encrypt;
 	ctx->decrypt = cbc_decrypt;
+	ctx->encrypt_iov = cipher_encrypt_iov;
+	ctx->decrypt_iov = cipher_decrypt_iov;
+	ctx->update  = cipher_update;
+	ctx->final   = cipher_final;
 	ctx->pad     = pad;
 	ctx->cipher  = blk_ctx;
 	ctx->ivlen   = blk_ctx->blklen / 8;
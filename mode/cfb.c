@@ -24,53 +24,99 @@
 
 /*
  * only supports length of multiple bytes
- * don't support arbitirary length of bits
+ * don't support arbitirary length of bits.
+ * after a partial block ctx->iv is its keystream block with the first
+ * bytes replaced by the ciphertext so far, the ks_len bytes at the end
+ * are still keystream. the block is finished by the next call, then
+ * ctx->iv is the whole ciphertext block, the input of the next one
  */
+static void cfb_finish(cipher_ctx_t *ctx, uint8_t **buf, size_t *len, int decrypt)
+{
+	uint8_t c, *p = *buf;
+	int blklen = ctx->cipher->blklen / 8;
+	int i = blklen - ctx->ks_len;
+
+	for (; ctx->ks_len && *len; ctx->ks_len--, (*len)--, i++, p++) {
+		c = decrypt ? *p : *p ^ ctx->iv[i];
+		*p ^= ctx->iv[i];
+		ctx->iv[i] = c;
+	}
+	*buf = p;
+}
+
+/* len < one block */
+static void cfb_start(cipher_ctx_t *ctx, uint8_t *buf, size_t len, int decrypt)
+{
+	size_t j;
+	uint8_t c;
+	int blklen = ctx->cipher->blklen / 8;
+
+	if (!len) return;
+	ctx->cipher->encrypt(ctx->cipher, ctx->iv, 1);
+	for (j=0; j<len; j++) {
+		c = decrypt ? buf[j] : buf[j] ^ ctx->iv[j];
+		buf[j] ^= ctx->iv[j];
+		ctx->iv[j] = c;
+	}
+	ctx->ks_len = blklen - len;
+}
+
 static size_t cfb_encrypt(cipher_ctx_t *ctx, uint8_t *buf, size_t len)
 {
-	size_t i, j, k;
+	size_t i, j, n;
 	int blklen = ctx->cipher->blklen / 8;
 
 	if (ctx->pad)
 		len = ctx->pad->pad(buf, blklen, len);
 
-	for (i=0; i<len; i+=blklen) {
+	n = len;
+	cfb_finish(ctx, &buf, &len, 0);
+	for (i=0; i+blklen<=len; i+=blklen) {
 		ctx->cipher->encrypt(ctx->cipher, ctx->iv, 1);
-		if (len - i < blklen) k = len - i;
-		else k = blklen;
-		for (j=0; j<k; j++)
+		for (j=0; j<blklen; j++)
 			*buf++ ^= ctx->iv[j];
-		memcpy(ctx->iv, buf-ctx->ivlen, ctx->ivlen);
+		memcpy(ctx->iv, buf-blklen, blklen);
 	}
+	cfb_start(ctx, buf, len - i, 0);
 
-	return len;
+	return n;
 }
 
+/*
+ * the cipher inputs are the IV and the ciphertext, all known in advance,
+ * so CFB_BATCH keystream blocks are produced by one encrypt call
+ */
+#define CFB_BATCH 8
+
 static size_t cfb_decrypt(cipher_ctx_t *ctx, uint8_t *buf, size_t len)
 {
-	size_t i, j, k;
+	size_t i, j, n, total = len;
 	int blklen = ctx->cipher->blklen / 8;
-	uint8_t  iv[CIPHER_CTX_MAX_BLK_LEN];
-	uint8_t  iv1[CIPHER_CTX_MAX_BLK_LEN];
-
-	memcpy(iv, ctx->iv, blklen);
-	for (i=0; i<len; i+=blklen) {
-		memcpy(iv1, buf, blklen);
-		ctx->cipher->encrypt(ctx->cipher, iv, 1);
-		if (len - i < blklen) k = len - i;
-		else k = blklen;
-		for (j=0; j<k; j++)
-			*buf++ ^= iv[j];
-		memcpy(iv, iv1, blklen);
+	uint8_t  ks[CFB_BATCH * CIPHER_CTX_MAX_BLK_LEN];
+
+	cfb_finish(ctx, &buf, &len, 1);
+	for (i=0; i+blklen<=len; i+=n) {
+		n = (len - i) / blklen * blklen;
+		if (n > CFB_BATCH * blklen) n = CFB_BATCH * blklen;
+		/* ks = IV || C[0] || ... || C[nblocks-2] */
+		memcpy(ks, ctx->iv, blklen);
+		memcpy(ks + blklen, buf, n - blklen);
+		/* the next IV is the last ciphertext block, same as cfb_encrypt() */
+		memcpy(ctx->iv, buf + n - blklen, blklen);
+		ctx->cipher->encrypt(ctx->cipher, ks, n / blklen);
+		for (j=0; j<n; j++)
+			*buf++ ^= ks[j];
 	}
-	memcpy(ctx->iv, iv, blklen);
+	memset(ks, 0, sizeof(ks));
+	cfb_start(ctx, buf, len - i, 1);
+	buf += len - i;
 
 	if (ctx->pad)
 		i = ctx->pad->unpad(buf - blklen, blklen);
 	else
 		i = 0;
 
-	return len - i;
+	return total - i;
 }
 
 void cfb_init(cipher_ctx_t *ctx, blk_ctx_t *blk_ctx, pad_ctx_t *pad, uint8_t *nounce)
@@ -86,6 +132,11 @@ void cfb_init(cipher_ctx_t *ctx, blk_ctx_t *blk_ctx, pad_ctx_t *pad, uint8_t *no
 	ctx->init    = cfb_init;
 	ctx->encrypt = cfb_encrypt;
 	ctx->decrypt = cfb_decrypt;
+	ctx->encrypt_iov = cipher_encrypt_iov;
+	ctx->decrypt_iov = cipher_decrypt_iov;
+	ctx->update  = cipher_update;
+	ctx->final   = cipher_final;
+	ctx->stream  = 1;
 	ctx->pad     = pad;
 	ctx->cipher  = blk_ctx;
 	ctx->ivlen   = blk_ctx->blklen / 8;
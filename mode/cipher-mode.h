@@ -21,6 +21,7 @@
 #define __CHIPHER_MODE__
 
 #include <stdint.h>
+#include <sys/uio.h>
 #include "paddings.h"
 
 #define CIPHER_CTX_MAX_BLK_LEN 16
@@ -42,27 +43,99 @@ typedef struct cipher_ctx cipher_ctx_t;
  * buffer block has to be long enough for paddings.
  * if don't use padding, then the block length should be multiple
  * of blk->blklen
+ *
+ * encrypt_iov/decrypt_iov are out of place, from the in iovecs to the
+ * out iovecs, blocks may span elements. out needs room for the padded
+ * length only, in and out may be the same buffers but must not
+ * overlap otherwise. they return the output length, -1 if out is
+ * too short, the length is not valid for the padding (whole blocks
+ * for ECB/CBC without padding) or the padding of a ciphertext is bad
  */
 struct cipher_ctx {
 	void      (*init)(cipher_ctx_t* ctx, blk_ctx_t *blk_ctx, pad_ctx_t *pad, uint8_t *iv);
 	size_t (*encrypt)(cipher_ctx_t *ctx, uint8_t *block, size_t len);
 	size_t (*decrypt)(cipher_ctx_t *ctx, uint8_t *block, size_t len);
+	ssize_t (*encrypt_iov)(cipher_ctx_t *ctx, const struct iovec *in, int nin, struct iovec *out, int nout);
+	ssize_t (*decrypt_iov)(cipher_ctx_t *ctx, const struct iovec *in, int nin, struct iovec *out, int nout);
+	ssize_t  (*update)(cipher_ctx_t *ctx, const uint8_t *in, size_t len, uint8_t *out, int decrypt);
+	ssize_t   (*final)(cipher_ctx_t *ctx, uint8_t *out, int decrypt);
 	pad_ctx_t *pad;
 	blk_ctx_t *cipher; /* block cipher context: DES, AES */
 	int      ivlen;    /* bytes */
 	uint8_t  iv[CIPHER_CTX_MAX_BLK_LEN];
+	int      stream;   /* CTR, OFB, CFB: any length, the next call continues a partial block */
+	int      ks_len;   /* unused keystream bytes of the partial block */
+	uint8_t  ks[CIPHER_CTX_MAX_BLK_LEN];  /* CTR: the keystream block of the partial block */
+	int      buf_len;
+	uint8_t  buf[CIPHER_CTX_MAX_BLK_LEN]; /* update(): input held back until a block is complete */
 };
 
+/*
+ * streaming, after xxx_init(): update() any number of times, any length,
+ * then final(). the output is the same as one encrypt/decrypt call over
+ * the concatenation, the padding is added/removed by final() only.
+ * input of ECB, CBC and of padded messages is held back until a block is
+ * complete, and the last block of a padded ciphertext until final(), so
+ * out needs room for len + one block. out may be in. they return the
+ * bytes written to out, final() returns -1 if the message doesn't end
+ * at a block boundary where the mode needs it to
+ */
+ssize_t cipher_update(cipher_ctx_t *ctx, const uint8_t *in, size_t len, uint8_t *out, int decrypt);
+ssize_t cipher_final(cipher_ctx_t *ctx, uint8_t *out, int decrypt);
+
+/* the encrypt_iov/decrypt_iov of all modes, on top of ctx->encrypt/decrypt */
+ssize_t cipher_encrypt_iov(cipher_ctx_t *ctx, const struct iovec *in, int nin, struct iovec *out, int nout);
+ssize_t cipher_decrypt_iov(cipher_ctx_t *ctx, const struct iovec *in, int nin, struct iovec *out, int nout);
+
 void cbc_init(cipher_ctx_t *ctx, blk_ctx_t *blk_ctx, pad_ctx_t *pad, uint8_t *iv);
 void ecb_init(cipher_ctx_t *ctx, blk_ctx_t *blk_ctx, pad_ctx_t *pad, uint8_t *iv);
 /*
  * nounce in ctr mode contains 96-bit iv and 32-bit counter value 
  * first 12 bytes are iv
  * last   4 bytes are counter
+ * the whole block is incremented as one big-endian number, so a wrap
+ * of the 32-bit counter carries into the iv, same as OpenSSL's CTR
  */
 void ctr_init(cipher_ctx_t *ctx, blk_ctx_t *blk_ctx, pad_ctx_t *pad, uint8_t *nounce);
+
+/*
+ * same result as ctx->encrypt/decrypt of a ctr_init()'ed ctx, the buffer
+ * is split across nthreads threads, nthreads <= 0 uses all online CPUs.
+ * the worker pool caps nthreads, see pool_threads() in mode/pool.h.
+ * the block cipher context is shared read-only by the threads
+ */
+size_t ctr_encrypt_mt(cipher_ctx_t *ctx, uint8_t *buf, size_t len, int nthreads);
+size_t ctr_decrypt_mt(cipher_ctx_t *ctx, uint8_t *buf, size_t len, int nthreads);
 void ofb_init(cipher_ctx_t *ctx, blk_ctx_t *blk_ctx, pad_ctx_t *pad, uint8_t *nounce);
 void cfb_init(cipher_ctx_t *ctx, blk_ctx_t *blk_ctx, pad_ctx_t *pad, uint8_t *nounce);
 
+typedef struct xts_ctx xts_ctx_t;
+
+/*
+ * XTS (IEEE 1619) on 128-bit block ciphers, in place, one data unit
+ * (sector) per encrypt/decrypt call: len >= 16, a length that is not
+ * a multiple of 16 uses ciphertext stealing. key1 encrypts the data,
+ * key2 the sector number, they are separate block cipher contexts
+ * and should not hold the same key
+ */
+struct xts_ctx {
+	int (*init)(xts_ctx_t *ctx, blk_ctx_t *key1, blk_ctx_t *key2, size_t sector_len);
+	int (*encrypt)(xts_ctx_t *ctx, uint8_t *buf, size_t len, uint64_t sector);
+	int (*decrypt)(xts_ctx_t *ctx, uint8_t *buf, size_t len, uint64_t sector);
+	blk_ctx_t *cipher;     /* key1 */
+	blk_ctx_t *tweak;      /* key2 */
+	size_t     sector_len; /* bytes, used by the sector batch calls */
+};
+
+int xts_init(xts_ctx_t *ctx, blk_ctx_t *key1, blk_ctx_t *key2, size_t sector_len);
+
+/*
+ * nsectors consecutive sectors of sector_len bytes starting from sector
+ * number sector, split across nthreads threads like ctr_encrypt_mt().
+ * 0, -1 if a sector could not be en/decrypted
+ */
+int xts_encrypt_sectors(xts_ctx_t *ctx, uint8_t *buf, size_t nsectors, uint64_t sector, int nthreads);
+int xts_decrypt_sectors(xts_ctx_t *ctx, uint8_t *buf, size_t nsectors, uint64_t sector, int nthreads);
+
 #endif /* __CHIPHER_MODE__ */
 
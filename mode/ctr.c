@@ -21,57 +21,176 @@
 #include <string.h>
 #include "cipher-mode.h"
 #include "sha-common.h"
+#include "util.h"
+#include "pool.h"
 
-static void inc_ctr32(uint8_t *ctr)
+#define CTR_BATCH 8  /* counter blocks per cipher call */
+
+/* ctr += n, the whole len bytes are one big-endian number */
+static void ctr_add(uint8_t *ctr, int len, uint64_t n)
 {
-	register uint32_t u32;
+	int i;
 
-	u32 = swap32(*(uint32_t *)ctr);
-	*(uint32_t *)ctr = swap32(++u32);
+	for (i=len-1; i>=0 && n; i--, n >>= 8) {
+		n += ctr[i];
+		ctr[i] = (uint8_t)n;
+	}
+}
+
+/*
+ * CTR_BATCH counter blocks are built and encrypted by one multi-block
+ * call, so pipelined ciphers (AES-NI, bitsliced) process them together.
+ * the whole block is the counter: the last 32 bits are counted in a
+ * register and a wrap carries into the iv bytes before them, so the
+ * keystream never repeats within the 2^(blklen) counter values.
+ * the unused keystream of a partial last block is kept for the next call
+ */
+static void ctr_crypt(cipher_ctx_t *ctx, uint8_t *buf, size_t len)
+{
+	size_t i, n, nblocks;
+	uint32_t ctr;
+	uint8_t  ks[CTR_BATCH * CIPHER_CTX_MAX_BLK_LEN];
+	int blklen = ctx->cipher->blklen / 8;
+
+	n = len < ctx->ks_len ? len : ctx->ks_len;
+	xor_keystream(buf, ctx->ks + blklen - ctx->ks_len, n);
+	ctx->ks_len -= n;
+	buf += n;
+	len -= n;
+
+	ctr = load_be32(ctx->iv + ctx->ivlen);
+	while (len) {
+		nblocks = (len + blklen - 1) / blklen;
+		if (nblocks > CTR_BATCH) nblocks = CTR_BATCH;
+		for (i=0; i<nblocks; i++) {
+			memcpy(ks + i*blklen, ctx->iv, ctx->ivlen);
+			store_be32(ks + i*blklen + ctx->ivlen, ctr);
+			if (!++ctr)
+				ctr_add(ctx->iv, ctx->ivlen, 1);
+		}
+		ctx->cipher->encrypt(ctx->cipher, ks, nblocks);
+
+		n = nblocks * blklen;
+		if (n > len) {
+			n = len;
+			ctx->ks_len = nblocks * blklen - len;
+			memcpy(ctx->ks, ks + (nblocks - 1) * blklen, blklen);
+		}
+		xor_keystream(buf, ks, n);
+		buf += n;
+		len -= n;
+	}
+	store_be32(ctx->iv + ctx->ivlen, ctr);
+	memset(ks, 0, sizeof(ks));
 }
 
 static size_t ctr_encrypt(cipher_ctx_t *ctx, uint8_t *buf, size_t len)
 {
-	size_t i, j, k;
-	uint8_t  ivctr[CIPHER_CTX_MAX_BLK_LEN];
 	int blklen = ctx->cipher->blklen / 8;
 
 	if (ctx->pad)
 		len = ctx->pad->pad(buf, blklen, len);
 
-	for (i=0; i<len; i+=blklen) {
-		memcpy(ivctr, ctx->iv, blklen);
-		inc_ctr32(ctx->iv + ctx->ivlen);
-
-		ctx->cipher->encrypt(ctx->cipher, ivctr, 1);
-		if (len - i < blklen) k = len - i;
-		else k = blklen;
-		for (j=0; j<k; j++)
-			*buf++ ^= ivctr[j];
-	}
-
+	ctr_crypt(ctx, buf, len);
 	return len;
 }
 
 static size_t ctr_decrypt(cipher_ctx_t *ctx, uint8_t *buf, size_t len)
 {
-	size_t i, j, k;
-	uint8_t  ivctr[CIPHER_CTX_MAX_BLK_LEN];
+	size_t i;
 	int blklen = ctx->cipher->blklen / 8;
 
-	for (i=0; i<len; i+=blklen) {
-		memcpy(ivctr, ctx->iv, blklen);
-		inc_ctr32(ctx->iv + ctx->ivlen);
+	ctr_crypt(ctx, buf, len);
+
+	if (ctx->pad)
+		i = ctx->pad->unpad(buf + len - blklen, blklen);
+	else
+		i = 0;
+
+	return len - i;
+}
+
+/*
+ * multi-threaded CTR: the keystream block of block i only depends on
+ * counter + i, so the buffer is cut into nthreads runs of whole blocks
+ * and each job of the worker pool works on a copy of ctx with the
+ * counter advanced to the start of its run
+ */
+struct ctr_job {
+	cipher_ctx_t ctx;
+	uint8_t *buf;
+	size_t   len;
+};
+
+static void ctr_worker(void *arg)
+{
+	struct ctr_job *job = arg;
 
-		ctx->cipher->encrypt(ctx->cipher, ivctr, 1);
-		if (len - i < blklen) k = len - i;
-		else k = blklen;
-		for (j=0; j<k; j++)
-			*buf++ ^= ivctr[j];
+	ctr_crypt(&job->ctx, job->buf, job->len);
+}
+
+static void ctr_crypt_mt(cipher_ctx_t *ctx, uint8_t *buf, size_t len, int nthreads)
+{
+	int t;
+	size_t n, nblocks, per, off;
+	int blklen = ctx->cipher->blklen / 8;
+	struct ctr_job job[POOL_MAX_THREADS];
+
+	nthreads = pool_threads(nthreads, len);
+	if (nthreads == 1) {
+		ctr_crypt(ctx, buf, len);
+		return;
 	}
 
+	/* the rest of a partial block first, so the runs start at a block boundary */
+	n = len < ctx->ks_len ? len : ctx->ks_len;
+	ctr_crypt(ctx, buf, n);
+	buf += n;
+	len -= n;
+
+	nblocks = (len + blklen - 1) / blklen;
+	per = (nblocks + nthreads - 1) / nthreads;
+	for (t=0; t<nthreads; t++) {
+		off = t * per * blklen;
+		if (off > len) off = len;
+		job[t].ctx = *ctx;
+		ctr_add(job[t].ctx.iv, blklen, t * per);
+		job[t].buf = buf + off;
+		job[t].len = len - off < per * blklen ? len - off : per * blklen;
+	}
+	run_jobs(ctr_worker, job, sizeof(job[0]), nthreads);
+
+	ctr_add(ctx->iv, blklen, nblocks);
+	/* the keystream of a partial last block, from the last run that isn't empty */
+	for (t=nthreads-1; t && !job[t].len; t--)
+		;
+	ctx->ks_len = job[t].ctx.ks_len;
+	memcpy(ctx->ks, job[t].ctx.ks, blklen);
+	memset(job, 0, sizeof(job));
+}
+
+size_t ctr_encrypt_mt(cipher_ctx_t *ctx, uint8_t *buf, size_t len, int nthreads)
+{
+	int blklen = ctx->cipher->blklen / 8;
+
+	assert(ctx->encrypt == ctr_encrypt);
+	if (ctx->pad)
+		len = ctx->pad->pad(buf, blklen, len);
+
+	ctr_crypt_mt(ctx, buf, len, nthreads);
+	return len;
+}
+
+size_t ctr_decrypt_mt(cipher_ctx_t *ctx, uint8_t *buf, size_t len, int nthreads)
+{
+	size_t i;
+	int blklen = ctx->cipher->blklen / 8;
+
+	assert(ctx->decrypt == ctr_decrypt);
+	ctr_crypt_mt(ctx, buf, len, nthreads);
+
 	if (ctx->pad)
-		i = ctx->pad->unpad(buf - blklen, blklen);
+		i = ctx->pad->unpad(buf + len - blklen, blklen);
 	else
 		i = 0;
 
@@ -91,6 +210,11 @@ void ctr_init(cipher_ctx_t *ctx, blk_ctx_t *blk_ctx, pad_ctx_t *pad, uint8_t *no
 	ctx->init    = ctr_init;
 	ctx->encrypt = ctr_encrypt;
 	ctx->decrypt = ctr_decrypt;
+	ctx->encrypt_iov = cipher_encrypt_iov;
+	ctx->decrypt_iov = cipher_decrypt_iov;
+	ctx->update  = cipher_update;
+	ctx->final   = cipher_final;
+	ctx->stream  = 1;
 	ctx->pad     = pad;
 	ctx->cipher  = blk_ctx;
 	ctx->ivlen   = blk_ctx->blklen / 8 - sizeof(uint32_t);
@@ -71,6 +71,10 @@ void ecb_init(cipher_ctx_t *ctx, blk_ctx_t *blk_ctx, pad_ctx_t *pad, uint8_t *iv
 	ctx->init    = ecb_init;
 	ctx->encrypt = ecb_encrypt;
 	ctx->decrypt = ecb_decrypt;
+	ctx->encrypt_iov = cipher_encrypt_iov;
+	ctx->decrypt_iov = cipher_decrypt_iov;
+	ctx->update  = cipher_update;
+	ctx->final   = cipher_final;
 	ctx->pad     = pad;
 	ctx->cipher  = blk_ctx;
 	ctx->ivlen   = blk_ctx->blklen/8;
@@ -0,0 +1,163 @@
+/*
+   Copyright 2020 Andrew Li, Gavin Li
+
+   li.andrew.mail@gmail.com
+   gavinux@gmail.com
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+/*
+ * out of place encrypt/decrypt over iovec lists, for every mode.
+ * runs of whole blocks that are contiguous in both the input and the
+ * output element are copied to the output and en/decrypted there by
+ * the mode itself, a block that spans elements goes through a one
+ * block bounce buffer. the padding is applied to the last, partial
+ * block only, so the output just needs room for the padded length
+ */
+#include <assert.h>
+#include <string.h>
+#include "cipher-mode.h"
+
+struct iov_cursor {
+	const struct iovec *v;
+	int     n;     /* elements */
+	int     i;     /* current element */
+	size_t  off;   /* offset in the current element */
+};
+
+static size_t iov_total(const struct iovec *v, int n)
+{
+	size_t len = 0;
+
+	while (n--)
+		len += v++->iov_len;
+	return len;
+}
+
+/* contiguous bytes at the position, empty elements are skipped, 0 at the end */
+static size_t iov_span(struct iov_cursor *c, uint8_t **p)
+{
+	while (c->i < c->n && c->off == c->v[c->i].iov_len) {
+		c->i++;
+		c->off = 0;
+	}
+	if (c->i == c->n) return 0;
+	*p = (uint8_t *)c->v[c->i].iov_base + c->off;
+	return c->v[c->i].iov_len - c->off;
+}
+
+static void iov_gather(struct iov_cursor *c, uint8_t *buf, size_t len)
+{
+	size_t n;
+	uint8_t *p;
+
+	while (len) {
+		n = iov_span(c, &p);
+		if (n > len) n = len;
+		memcpy(buf, p, n);
+		c->off += n;
+		buf += n;
+		len -= n;
+	}
+}
+
+static void iov_scatter(struct iov_cursor *c, const uint8_t *buf, size_t len)
+{
+	size_t n;
+	uint8_t *p;
+
+	while (len) {
+		n = iov_span(c, &p);
+		if (n > len) n = len;
+		memcpy(p, buf, n);
+		c->off += n;
+		buf += n;
+		len -= n;
+	}
+}
+
+static ssize_t cipher_iov(cipher_ctx_t *ctx, const struct iovec *in, int nin, struct iovec *out, int nout, int decrypt)
+{
+	size_t a, b, n, total, body, tail, need, room;
+	int blklen = ctx->cipher->blklen / 8;
+	pad_ctx_t *pad = ctx->pad;
+	size_t (*crypt)(cipher_ctx_t *ctx, uint8_t *buf, size_t len) = decrypt ? ctx->decrypt : ctx->encrypt;
+	struct iov_cursor ci = {in, nin, 0, 0}, co = {out, nout, 0, 0};
+	uint8_t bounce[2 * CIPHER_CTX_MAX_BLK_LEN], *ip, *op;
+
+	assert(in || !nin);
+	assert(out || !nout);
+
+	/* the last block is held back for the padding */
+	total = iov_total(in, nin);
+	if (!ctx->stream && !pad && total % blklen) return -1;
+	if (decrypt && pad) {
+		if (total < blklen || total % blklen) return -1;
+		tail = blklen;
+		need = total - blklen;  /* at least, the padding is not written */
+	} else {
+		tail = total % blklen;
+		need = total - tail + (pad ? pad->pad(bounce, blklen, tail) : tail);
+	}
+	room = iov_total(out, nout);
+	if (room < need) return -1;
+	body = total - tail;
+	room -= body;
+
+	ctx->pad = NULL;
+	while (body) {
+		a = iov_span(&ci, &ip);
+		b = iov_span(&co, &op);
+		n = a < b ? a : b;
+		if (n > body) n = body;
+		n -= n % blklen;
+		if (n) {
+			memmove(op, ip, n);
+			crypt(ctx, op, n);
+			ci.off += n;
+			co.off += n;
+		} else {
+			n = blklen;
+			iov_gather(&ci, bounce, n);
+			crypt(ctx, bounce, n);
+			iov_scatter(&co, bounce, n);
+		}
+		body -= n;
+	}
+	ctx->pad = pad;
+
+	n = 0;
+	if (tail || pad) {
+		iov_gather(&ci, bounce, tail);
+		n = crypt(ctx, bounce, tail);
+		/* a tampered padding length wraps n, a padding of 0 is bad too */
+		if (n > room || (decrypt && pad && n >= blklen)) {
+			memset(bounce, 0, sizeof(bounce));
+			return -1;
+		}
+		iov_scatter(&co, bounce, n);
+	}
+	memset(bounce, 0, sizeof(bounce));
+	return total - tail + n;
+}
+
+ssize_t cipher_encrypt_iov(cipher_ctx_t *ctx, const struct iovec *in, int nin, struct iovec *out, int nout)
+{
+	return cipher_iov(ctx, in, nin, out, nout, 0);
+}
+
+ssize_t cipher_decrypt_iov(cipher_ctx_t *ctx, const struct iovec *in, int nin, struct iovec *out, int nout)
+{
+	return cipher_iov(ctx, in, nin, out, nout, 1);
+}
@@ -18,6 +18,7 @@
 */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include "des.h"
 #include "aes.h"
@@ -39,6 +40,164 @@ static void printbuf(uint8_t *buf, int nr)
 	printf("\n");
 }
 
+/* cuts len bytes of buf into at most n iovecs of random lengths, empty ones included */
+static int split_iov(uint8_t *buf, size_t len, struct iovec *v, int n)
+{
+	int i;
+	size_t k;
+
+	for (i=0; i<n-1 && len; i++) {
+		k = rand() % 3 ? rand() % 20 : rand() % 100;
+		if (k > len) k = len;
+		v[i].iov_base = buf;
+		v[i].iov_len  = k;
+		buf += k;
+		len -= k;
+	}
+	v[i].iov_base = buf;
+	v[i].iov_len  = len;
+	return i + 1;
+}
+
+typedef void (*mode_init_t)(cipher_ctx_t *ctx, blk_ctx_t *blk_ctx, pad_ctx_t *pad, uint8_t *iv);
+
+/* encrypt_iov/decrypt_iov on random iovecs against encrypt/decrypt on one buffer */
+static int iov_check(mode_init_t init, blk_ctx_t *blk, pad_ctx_t *pad, uint8_t *iv)
+{
+	cipher_ctx_t ctx;
+	struct iovec vin[64], vout[64];
+	uint8_t pt[600], ref[640], out[640], back[640];
+	size_t i, len, n;
+	ssize_t m;
+	int test, nin, nout, fail = 0;
+	int blklen = blk->blklen / 8;
+
+	for (test=0; test<200; test++) {
+		len = rand() % sizeof(pt);
+		if (!pad && (init == ecb_init || init == cbc_init))
+			len -= len % blklen;
+		for (i=0; i<len; i++)
+			pt[i] = rand();
+
+		memcpy(ref, pt, len);
+		init(&ctx, blk, pad, iv);
+		n = ctx.encrypt(&ctx, ref, len);
+
+		init(&ctx, blk, pad, iv);
+		nin  = split_iov(pt, len, vin, 64);
+		nout = split_iov(out, n, vout, 64);
+		m = ctx.encrypt_iov(&ctx, vin, nin, vout, nout);
+		if (m != n || memcmp(out, ref, n)) fail = 1;
+
+		init(&ctx, blk, pad, iv);
+		nin  = split_iov(out, n, vin, 64);
+		nout = split_iov(back, n, vout, 64);
+		m = ctx.decrypt_iov(&ctx, vin, nin, vout, nout);
+		if (m != len || memcmp(back, pt, len)) fail = 1;
+	}
+
+	/* ECB and CBC without padding take whole blocks only */
+	if (!pad && (init == ecb_init || init == cbc_init)) {
+		init(&ctx, blk, pad, iv);
+		nin  = split_iov(pt, blklen + 4, vin, 64);
+		nout = split_iov(out, sizeof(out), vout, 64);
+		if (ctx.encrypt_iov(&ctx, vin, nin, vout, nout) != -1) fail = 1;
+		if (ctx.decrypt_iov(&ctx, vin, nin, vout, nout) != -1) fail = 1;
+	}
+	return fail;
+}
+
+/*
+ * update()/final() with random chunk lengths against encrypt/decrypt on one
+ * buffer. without padding CTR, OFB and CFB also continue a partial block
+ * across plain encrypt/decrypt calls
+ */
+static int update_check(mode_init_t init, blk_ctx_t *blk, pad_ctx_t *pad, uint8_t *iv)
+{
+	cipher_ctx_t ctx;
+	uint8_t pt[600], ref[640], out[700], back[700];
+	size_t i, k, len, n, m;
+	ssize_t r;
+	int test, fail = 0;
+	int blklen = blk->blklen / 8;
+
+	for (test=0; test<200; test++) {
+		len = rand() % sizeof(pt);
+		if (!pad && (init == ecb_init || init == cbc_init))
+			len -= len % blklen;
+		for (i=0; i<len; i++)
+			pt[i] = rand();
+
+		memcpy(ref, pt, len);
+		init(&ctx, blk, pad, iv);
+		n = ctx.encrypt(&ctx, ref, len);
+
+		init(&ctx, blk, pad, iv);
+		for (i=m=0; i<len; i+=k) {
+			k = rand() % 3 ? rand() % 20 : rand() % 100;
+			if (k > len - i) k = len - i;
+			memcpy(out + m, pt + i, k);
+			r = ctx.update(&ctx, out + m, k, out + m, 0);  /* in place */
+			m += r;
+		}
+		r = ctx.final(&ctx, out + m, 0);
+		if (r < 0 || m + r != n || memcmp(out, ref, n)) fail = 1;
+
+		init(&ctx, blk, pad, iv);
+		for (i=m=0; i<n; i+=k) {
+			k = rand() % 3 ? rand() % 20 : rand() % 100;
+			if (k > n - i) k = n - i;
+			m += ctx.update(&ctx, ref + i, k, back + m, 1);
+		}
+		r = ctx.final(&ctx, back + m, 1);
+		if (r < 0 || m + r != len || memcmp(back, pt, len)) fail = 1;
+
+		if (ctx.stream && !pad) {
+			memcpy(out, pt, len);
+			init(&ctx, blk, pad, iv);
+			k = rand() % (len + 1);
+			ctx.encrypt(&ctx, out, k);
+			ctx.encrypt(&ctx, out + k, len - k);
+			if (memcmp(out, ref, len)) fail = 1;
+		}
+	}
+	return fail;
+}
+
+/*
+ * final() and decrypt_iov() of a padded ECB/CBC ciphertext whose last
+ * block says the padding is 0 bytes or longer than a block must fail
+ */
+static int bad_pad_check(mode_init_t init, blk_ctx_t *blk, pad_ctx_t *pad, uint8_t *iv)
+{
+	static const uint8_t bad[] = {0x00, 0xff, 0x11};
+	cipher_ctx_t ctx;
+	struct iovec vin, vout;
+	uint8_t ct[2 * CIPHER_CTX_MAX_BLK_LEN], out[2 * CIPHER_CTX_MAX_BLK_LEN];
+	int i, fail = 0;
+	int blklen = blk->blklen / 8;
+	ssize_t n;
+
+	for (i=0; i<sizeof(bad); i++) {
+		memset(ct, 0x5a, 2 * blklen);
+		ct[2 * blklen - 1] = bad[i];
+		init(&ctx, blk, NULL, iv);
+		ctx.encrypt(&ctx, ct, 2 * blklen);
+
+		init(&ctx, blk, pad, iv);
+		n = ctx.update(&ctx, ct, 2 * blklen, out, 1);
+		if (n != blklen || ctx.final(&ctx, out + n, 1) != -1) fail = 1;
+
+		init(&ctx, blk, pad, iv);
+		vin.iov_base  = ct;
+		vin.iov_len   = 2 * blklen;
+		vout.iov_base = out;
+		vout.iov_len  = sizeof(out);
+		if (ctx.decrypt_iov(&ctx, &vin, 1, &vout, 1) != -1) fail = 1;
+	}
+	return fail;
+}
+
 int main(int argc, char *argv[])
 {
 	size_t n;
@@ -67,7 +226,57 @@ int main(int argc, char *argv[])
 		0xf6, 0x9f, 0x24, 0x45, 0xdf, 0x4f, 0x9b, 0x17, 0xad, /*0x2b, 0x41, 0x7b, 0xe6, 0x6c, 0x37, 0x10 */
 	};
 
-	uint8_t buf[512];
+	/* NIST SP 800-38A F.5.5 CTR-AES256.Encrypt, the counter doesn't cross 32 bits */
+	uint8_t ctr_iv[] = {
+		0xf0, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa, 0xfb, 0xfc, 0xfd, 0xfe, 0xff
+	};
+	uint8_t ctr_pt[] = {
+		0x6b, 0xc1, 0xbe, 0xe2, 0x2e, 0x40, 0x9f, 0x96, 0xe9, 0x3d, 0x7e, 0x11, 0x73, 0x93, 0x17, 0x2a,
+		0xae, 0x2d, 0x8a, 0x57, 0x1e, 0x03, 0xac, 0x9c, 0x9e, 0xb7, 0x6f, 0xac, 0x45, 0xaf, 0x8e, 0x51,
+		0x30, 0xc8, 0x1c, 0x46, 0xa3, 0x5c, 0xe4, 0x11, 0xe5, 0xfb, 0xc1, 0x19, 0x1a, 0x0a, 0x52, 0xef,
+		0xf6, 0x9f, 0x24, 0x45, 0xdf, 0x4f, 0x9b, 0x17, 0xad, 0x2b, 0x41, 0x7b, 0xe6, 0x6c, 0x37, 0x10
+	};
+	uint8_t ctr_ct[] = {
+		0x60, 0x1e, 0xc3, 0x13, 0x77, 0x57, 0x89, 0xa5, 0xb7, 0xa7, 0xf5, 0x04, 0xbb, 0xf3, 0xd2, 0x28,
+		0xf4, 0x43, 0xe3, 0xca, 0x4d, 0x62, 0xb5, 0x9a, 0xca, 0x84, 0xe9, 0x90, 0xca, 0xca, 0xf5, 0xc5,
+		0x2b, 0x09, 0x30, 0xda, 0xa2, 0x3d, 0xe9, 0x4c, 0xe8, 0x70, 0x17, 0xba, 0x2d, 0x84, 0x98, 0x8d,
+		0xdf, 0xc9, 0xc5, 0x8d, 0xb6, 0x7a, 0xad, 0xa6, 0x13, 0xc2, 0xdd, 0x08, 0x45, 0x79, 0x41, 0xa6
+	};
+	/*
+	 * 128 bytes 0, 1, ..., 127 by AES-256-CTR with the F.5.5 key and
+	 * iv f0..f9 fa ff ff ff ff fa, from OpenSSL: the 32-bit counter
+	 * wraps after 6 blocks and carries through byte 11 into byte 10
+	 */
+	uint8_t ctr_wrap_ct[] = {
+		0xb9, 0x56, 0xea, 0x46, 0x85, 0x93, 0x92, 0xd8, 0x8a, 0x24, 0x40, 0xad, 0x54, 0xd0, 0xce, 0xad,
+		0xa0, 0xb4, 0xb1, 0x83, 0x9f, 0xbd, 0x37, 0xf8, 0xf0, 0x88, 0x4c, 0x86, 0xce, 0x47, 0xcd, 0x56,
+		0x68, 0xd1, 0xbd, 0x5f, 0x3d, 0x31, 0xda, 0xe3, 0x18, 0xa6, 0x45, 0x7a, 0xed, 0xa2, 0x58, 0xa1,
+		0xbd, 0xab, 0xe6, 0xf8, 0x3e, 0x48, 0xcd, 0xaa, 0x97, 0x89, 0xbf, 0x22, 0xf2, 0x78, 0x2f, 0x4e,
+		0x0e, 0x58, 0xe1, 0x7d, 0x51, 0x71, 0x41, 0xd3, 0x7e, 0xae, 0x45, 0x37, 0xdc, 0x9a, 0x3c, 0x50,
+		0x02, 0xba, 0x53, 0x16, 0x9a, 0xbd, 0xed, 0x5c, 0xe8, 0x8a, 0x40, 0x73, 0x29, 0xcd, 0xa3, 0x8d,
+		0x41, 0x6f, 0x21, 0xc3, 0xd9, 0x3c, 0x89, 0x88, 0x79, 0x8c, 0x77, 0x86, 0xc6, 0xe3, 0xfd, 0x32,
+		0x88, 0x38, 0xd7, 0x29, 0x7d, 0xd4, 0x5c, 0xba, 0x33, 0x42, 0x58, 0x78, 0x2e, 0x6e, 0xfc, 0x59
+	};
+	/* IEEE 1619 XTS-AES-128 vectors 1 and 2, and a 17-byte ciphertext stealing case */
+	uint8_t xts_ct1[] = {
+		0x91, 0x7c, 0xf6, 0x9e, 0xbd, 0x68, 0xb2, 0xec, 0x9b, 0x9f, 0xe9, 0xa3, 0xea, 0xdd, 0xa6, 0x92,
+		0xcd, 0x43, 0xd2, 0xf5, 0x95, 0x98, 0xed, 0x85, 0x8c, 0x02, 0xc2, 0x65, 0x2f, 0xbf, 0x92, 0x2e
+	};
+	uint8_t xts_ct2[] = {
+		0xc4, 0x54, 0x18, 0x5e, 0x6a, 0x16, 0x93, 0x6e, 0x39, 0x33, 0x40, 0x38, 0xac, 0xef, 0x83, 0x8b,
+		0xfb, 0x18, 0x6f, 0xff, 0x74, 0x80, 0xad, 0xc4, 0x28, 0x93, 0x82, 0xec, 0xd6, 0xd3, 0x94, 0xf0
+	};
+	uint8_t xts_ct3[] = {
+		0x64, 0x16, 0x10, 0x67, 0x9d, 0xcb, 0xf9, 0x2e, 0x50, 0x5c, 0x41, 0x33, 0x3f, 0xb0, 0x6c, 0x2a,
+		0x95
+	};
+	mode_init_t inits[] = {ecb_init, cbc_init, ctr_init, cfb_init, ofb_init};
+	uint8_t xts_key[32];
+	aes_ctx_t aes2;
+	xts_ctx_t xts;
+	uint8_t buf[512], ref[512];
+	static uint8_t sectors[64 * 4096 + 64], sref[64 * 4096 + 64];
+	int  i;
 
 	printf("input data:\n");
 	printbuf(vect, sizeof(vect));
@@ -84,6 +293,106 @@ int main(int argc, char *argv[])
 	n = ctx.decrypt(&ctx, buf, n);
 	printbuf(buf, n);
 
+	printf("aes-ctr SP 800-38A F.5.5: ");
+	memcpy(buf, ctr_pt, sizeof(ctr_pt));
+	ctr_init(&ctx, (blk_ctx_t *)&aes, NULL, ctr_iv);
+	ctx.encrypt(&ctx, buf, sizeof(ctr_pt));
+	printf("%s\n", memcmp(buf, ctr_ct, sizeof(ctr_ct)) ? "failed" : "succeeded");
+
+	/*
+	 * one batched call against OpenSSL and block by block calls, the
+	 * 32-bit counter starts at 0xfffffffa so it wraps inside a batch
+	 */
+	printf("aes-ctr counter wrap: ");
+	memset(ctr_iv + 11, 0xff, 5);
+	ctr_iv[15] = 0xfa;
+	for (i=0; i<sizeof(buf); i++)
+		buf[i] = ref[i] = i;
+	ctr_init(&ctx, (blk_ctx_t *)&aes, NULL, ctr_iv);
+	ctx.encrypt(&ctx, buf, sizeof(buf) - 5);
+	ctr_init(&ctx, (blk_ctx_t *)&aes, NULL, ctr_iv);
+	for (i=0; i<sizeof(ref) - 5; i+=16)
+		ctx.encrypt(&ctx, ref + i, sizeof(ref) - 5 - i < 16 ? sizeof(ref) - 5 - i : 16);
+	printf("%s\n", memcmp(buf, ctr_wrap_ct, sizeof(ctr_wrap_ct)) || memcmp(buf, ref, sizeof(buf)) ||
+	       memcmp(ctx.iv + 10, "\xfb\x00\x00\x00\x00\x1a", 6) ? "failed" : "succeeded");
+
+	printf("aes-xts IEEE 1619 vector 1: ");
+	memset(xts_key, 0, sizeof(xts_key));
+	aes_init(&aes, xts_key, 128);
+	aes_init(&aes2, xts_key + 16, 128);
+	xts_init(&xts, (blk_ctx_t *)&aes, (blk_ctx_t *)&aes2, 512);
+	memset(buf, 0, 32);
+	xts.encrypt(&xts, buf, 32, 0);
+	printf("%s\n", memcmp(buf, xts_ct1, sizeof(xts_ct1)) ? "failed" : "succeeded");
+
+	printf("aes-xts IEEE 1619 vector 2: ");
+	memset(xts_key, 0x11, 16);
+	memset(xts_key + 16, 0x22, 16);
+	aes_init(&aes, xts_key, 128);
+	aes_init(&aes2, xts_key + 16, 128);
+	memset(buf, 0x44, 32);
+	xts.encrypt(&xts, buf, 32, 0x3333333333ULL);
+	printf("%s\n", memcmp(buf, xts_ct2, sizeof(xts_ct2)) ? "failed" : "succeeded");
+
+	printf("aes-xts ciphertext stealing: ");
+	for (i=0; i<16; i++) {
+		xts_key[i] = 0xff - i;
+		xts_key[16 + i] = 0xbf - i;
+		ref[i] = i;
+	}
+	ref[16] = 0x10;
+	aes_init(&aes, xts_key, 128);
+	aes_init(&aes2, xts_key + 16, 128);
+	memcpy(buf, ref, 17);
+	xts.encrypt(&xts, buf, 17, 0x9a78563412ULL);
+	i = memcmp(buf, xts_ct3, sizeof(xts_ct3));
+	xts.decrypt(&xts, buf, 17, 0x9a78563412ULL);
+	printf("%s\n", i || memcmp(buf, ref, 17) ? "failed" : "succeeded");
+
+	/* sector batches, threaded or not, against one sector per call */
+	printf("aes-xts sector batches: ");
+	aes_init(&aes, key256, 256);
+	aes_init(&aes2, xts_key, 256);
+	for (i=0; i<sizeof(sectors); i++)
+		sectors[i] = sref[i] = i * 7;
+	xts_init(&xts, (blk_ctx_t *)&aes, (blk_ctx_t *)&aes2, 4096 + 1);
+	n = xts_encrypt_sectors(&xts, sectors, 64, 1000, 4);
+	for (i=0; i<64; i++)
+		xts.encrypt(&xts, sref + i * (4096 + 1), 4096 + 1, 1000 + i);
+	n |= memcmp(sectors, sref, sizeof(sref));
+	n |= xts_decrypt_sectors(&xts, sectors, 64, 1000, 1);
+	for (i=0; i<sizeof(sectors); i++)
+		n |= sectors[i] != (uint8_t)(i * 7);
+	printf("%s\n", n ? "failed" : "succeeded");
+
+	printf("aes/3des iovec encrypt/decrypt: ");
+	tdes_init(&tdes, (uint8_t *)key3, 192);
+	n = 0;
+	for (i=0; i<sizeof(inits)/sizeof(inits[0]); i++) {
+		n |= iov_check(inits[i], (blk_ctx_t *)&aes, pad_algo, iv);
+		n |= iov_check(inits[i], (blk_ctx_t *)&aes, NULL, iv);
+		n |= iov_check(inits[i], (blk_ctx_t *)&tdes, pad_algo, iv);
+	}
+	printf("%s\n", n ? "failed" : "succeeded");
+
+	printf("aes/3des streaming update/final: ");
+	n = 0;
+	for (i=0; i<sizeof(inits)/sizeof(inits[0]); i++) {
+		n |= update_check(inits[i], (blk_ctx_t *)&aes, pad_algo, iv);
+		n |= update_check(inits[i], (blk_ctx_t *)&aes, NULL, iv);
+		n |= update_check(inits[i], (blk_ctx_t *)&tdes, pad_algo, iv);
+		n |= update_check(inits[i], (blk_ctx_t *)&tdes, NULL, iv);
+	}
+	printf("%s\n", n ? "failed" : "succeeded");
+
+	printf("aes/3des ecb/cbc final with a bad padding: ");
+	n = bad_pad_check(ecb_init, (blk_ctx_t *)&aes, pad_algo, iv);
+	n |= bad_pad_check(cbc_init, (blk_ctx_t *)&aes, pad_algo, iv);
+	n |= bad_pad_check(ecb_init, (blk_ctx_t *)&tdes, pad_algo, iv);
+	n |= bad_pad_check(cbc_init, (blk_ctx_t *)&tdes, pad_algo, iv);
+	printf("%s\n", n ? "failed" : "succeeded");
+	memcpy(buf, vect, sizeof(vect));
+
 	printf("aes-ofb mode:\n");
 	ofb_init(&ctx, (blk_ctx_t *)&aes, pad_algo, iv);
 	n = ctx.encrypt(&ctx, buf, sizeof(vect));
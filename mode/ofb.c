@@ -23,40 +23,48 @@
 #include "sha-common.h"
 
 
-static size_t ofb_encrypt(cipher_ctx_t *ctx, uint8_t *buf, size_t len)
+/*
+ * ctx->iv is the last keystream block, the ks_len bytes at its end
+ * are left over from a partial block and used first
+ */
+static void ofb_crypt(cipher_ctx_t *ctx, uint8_t *buf, size_t len)
 {
-	size_t i, j, k;
+	size_t j, k;
 	int blklen = ctx->cipher->blklen / 8;
 
-	if (ctx->pad)
-		len = ctx->pad->pad(buf, blklen, len);
+	for (; ctx->ks_len && len; len--)
+		*buf++ ^= ctx->iv[blklen - ctx->ks_len--];
 
-	for (i=0; i<len; i+=blklen) {
+	while (len) {
 		ctx->cipher->encrypt(ctx->cipher, ctx->iv, 1);
-		if (len - i < blklen) k = len - i;
-		else k = blklen;
+		k = len < blklen ? len : blklen;
 		for (j=0; j<k; j++)
 			*buf++ ^= ctx->iv[j];
+		ctx->ks_len = blklen - k;
+		len -= k;
 	}
+}
+
+static size_t ofb_encrypt(cipher_ctx_t *ctx, uint8_t *buf, size_t len)
+{
+	int blklen = ctx->cipher->blklen / 8;
+
+	if (ctx->pad)
+		len = ctx->pad->pad(buf, blklen, len);
 
+	ofb_crypt(ctx, buf, len);
 	return len;
 }
 
 static size_t ofb_decrypt(cipher_ctx_t *ctx, uint8_t *buf, size_t len)
 {
-	size_t i, j, k;
+	size_t i;
 	int blklen = ctx->cipher->blklen / 8;
 
-	for (i=0; i<len; i+=blklen) {
-		ctx->cipher->encrypt(ctx->cipher, ctx->iv, 1);
-		if (len - i < blklen) k = len - i;
-		else k = blklen;
-		for (j=0; j<k; j++)
-			*buf++ ^= ctx->iv[j];
-	}
+	ofb_crypt(ctx, buf, len);
 
 	if (ctx->pad)
-		i = ctx->pad->unpad(buf - blklen, blklen);
+		i = ctx->pad->unpad(buf + len - blklen, blklen);
 	else
 		i = 0;
 
@@ -76,6 +84,11 @@ void ofb_init(cipher_ctx_t *ctx, blk_ctx_t *blk_ctx, pad_ctx_t *pad, uint8_t *no
 	ctx->init    = ofb_init;
 	ctx->encrypt = ofb_encrypt;
 	ctx->decrypt = ofb_decrypt;
+	ctx->encrypt_iov = cipher_encrypt_iov;
+	ctx->decrypt_iov = cipher_decrypt_iov;
+	ctx->update  = cipher_update;
+	ctx->final   = cipher_final;
+	ctx->stream  = 1;
 	ctx->pad     = pad;
 	ctx->cipher  = blk_ctx;
 	ctx->ivlen   = blk_ctx->blklen / 8;
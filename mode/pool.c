@@ -0,0 +1,159 @@
+/*
+   Copyright 2020 Andrew Li, Gavin Li
+
+   li.andrew.mail@gmail.com
+   gavinux@gmail.com
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+/*
+ * persistent worker pool of the multi-threaded modes. a run_jobs()
+ * call queues a batch, idle workers and the caller take its jobs one
+ * by one, the last one done wakes the caller. the workers wait for
+ * the next batch instead of exiting, a forked child starts without
+ * workers and creates them again on its first batch
+ */
+#include <pthread.h>
+#include <unistd.h>
+#include "pool.h"
+
+struct batch {
+	void   (*fn)(void *job);
+	char    *jobs;
+	size_t   size;
+	int      n;
+	int      next;           /* first job not taken yet */
+	int      done;
+	pthread_cond_t  cond;    /* done == n */
+	struct batch   *link;
+};
+
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  pool_work = PTHREAD_COND_INITIALIZER;  /* a batch was queued */
+static struct batch   *queue;      /* batches with jobs not taken yet */
+static int             nworkers;
+static pthread_once_t  atfork_once = PTHREAD_ONCE_INIT;
+
+/* the workers of the parent don't exist in the child */
+static void pool_atfork_child(void)
+{
+	pthread_mutex_init(&pool_lock, NULL);
+	pthread_cond_init(&pool_work, NULL);
+	queue = NULL;
+	nworkers = 0;
+}
+
+static void pool_atfork_register(void)
+{
+	pthread_atfork(NULL, NULL, pool_atfork_child);
+}
+
+/* the next job of batch b, b leaves the queue with its last job. pool_lock is held */
+static char *take_job(struct batch *b)
+{
+	struct batch **p;
+	char *job = b->jobs + b->next++ * b->size;
+
+	if (b->next == b->n) {
+		for (p=&queue; *p != b; p=&(*p)->link)
+			;
+		*p = b->link;
+	}
+	return job;
+}
+
+/* runs a job of b without pool_lock */
+static void run_job(struct batch *b, char *job)
+{
+	pthread_mutex_unlock(&pool_lock);
+	b->fn(job);
+	pthread_mutex_lock(&pool_lock);
+	if (++b->done == b->n)
+		pthread_cond_signal(&b->cond);
+}
+
+static void *pool_worker(void *arg)
+{
+	struct batch *b;
+
+	pthread_mutex_lock(&pool_lock);
+	for (;;) {
+		while (!queue)
+			pthread_cond_wait(&pool_work, &pool_lock);
+		b = queue;
+		run_job(b, take_job(b));
+	}
+	return NULL;
+}
+
+int pool_threads(int nthreads, size_t len)
+{
+	if (nthreads <= 0)
+		nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+	if (nthreads > len / POOL_MIN_CHUNK)
+		nthreads = len / POOL_MIN_CHUNK;
+	if (nthreads > POOL_MAX_THREADS)
+		nthreads = POOL_MAX_THREADS;
+	if (nthreads < 1)
+		nthreads = 1;
+	return nthreads;
+}
+
+void run_jobs(void (*fn)(void *job), void *jobs, size_t size, int n)
+{
+	struct batch b, **p;
+	pthread_attr_t attr;
+	pthread_t tid;
+	int i;
+
+	if (n <= 1) {
+		for (i=0; i<n; i++)
+			fn((char *)jobs + i * size);
+		return;
+	}
+	pthread_once(&atfork_once, pool_atfork_register);
+
+	b.fn   = fn;
+	b.jobs = jobs;
+	b.size = size;
+	b.n    = n;
+	b.next = 0;
+	b.done = 0;
+	b.link = NULL;
+	pthread_cond_init(&b.cond, NULL);
+
+	pthread_mutex_lock(&pool_lock);
+	/* n - 1 workers besides the caller */
+	if (nworkers < n - 1 && nworkers < POOL_MAX_THREADS) {
+		pthread_attr_init(&attr);
+		pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+		while (nworkers < n - 1 && nworkers < POOL_MAX_THREADS) {
+			if (pthread_create(&tid, &attr, pool_worker, NULL))
+				break;
+			nworkers++;
+		}
+		pthread_attr_destroy(&attr);
+	}
+	for (p=&queue; *p; p=&(*p)->link)
+		;
+	*p = &b;
+	pthread_cond_broadcast(&pool_work);
+
+	while (b.next < b.n)
+		run_job(&b, take_job(&b));
+	while (b.done < b.n)
+		pthread_cond_wait(&b.cond, &pool_lock);
+	pthread_mutex_unlock(&pool_lock);
+	pthread_cond_destroy(&b.cond);
+}
@@ -0,0 +1,43 @@
+/*
+   Copyright 2020 Andrew Li, Gavin Li
+
+   li.andrew.mail@gmail.com
+   gavinux@gmail.com
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef __POOL_H__
+#define __POOL_H__
+
+#include <stddef.h>
+
+#define POOL_MAX_THREADS  64
+#define POOL_MIN_CHUNK    (64 * 1024)  /* bytes, smaller runs don't pay for a thread */
+
+/*
+ * the threads for len bytes of work: nthreads, all online CPUs if
+ * nthreads <= 0, at most one per POOL_MIN_CHUNK bytes and at most
+ * POOL_MAX_THREADS, at least 1
+ */
+int  pool_threads(int nthreads, size_t len);
+
+/*
+ * fn(jobs + i * size) for i = 0..n-1, returns when all are done.
+ * the worker threads are created on first use and kept for the next
+ * calls, the calling thread works on its own jobs too, so they all
+ * get done even if no worker could be created
+ */
+void run_jobs(void (*fn)(void *job), void *jobs, size_t size, int n);
+
+#endif /* __POOL_H__ */
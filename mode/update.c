@@ -0,0 +1,110 @@
+/*
+   Copyright 2020 Andrew Li, Gavin Li
+
+   li.andrew.mail@gmail.com
+   gavinux@gmail.com
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+/*
+ * streaming update()/final() of all modes, on top of ctx->encrypt/decrypt.
+ * CTR, OFB and CFB carry a partial block themselves, so without padding
+ * the input goes straight through. otherwise the input is cut at block
+ * boundaries, the rest is held back in ctx->buf, and the padding is done
+ * by the one en/decrypt call of final()
+ */
+#include <assert.h>
+#include <string.h>
+#include "cipher-mode.h"
+
+ssize_t cipher_update(cipher_ctx_t *ctx, const uint8_t *in, size_t len, uint8_t *out, int decrypt)
+{
+	size_t keep, head, off, mid, total;
+	int blklen = ctx->cipher->blklen / 8;
+	pad_ctx_t *pad = ctx->pad;
+	size_t (*crypt)(cipher_ctx_t *ctx, uint8_t *buf, size_t len) = decrypt ? ctx->decrypt : ctx->encrypt;
+	uint8_t first[CIPHER_CTX_MAX_BLK_LEN], last[CIPHER_CTX_MAX_BLK_LEN];
+
+	assert(in || !len);
+	assert(out || !len);
+
+	if (ctx->stream && !pad) {
+		memmove(out, in, len);
+		crypt(ctx, out, len);
+		return len;
+	}
+
+	total = ctx->buf_len + len;
+	keep = total % blklen;
+	/* the last block of a padded ciphertext is unpadded by final() */
+	if (decrypt && pad && !keep && total)
+		keep = blklen;
+	if (total == keep) {
+		memcpy(ctx->buf + ctx->buf_len, in, len);
+		ctx->buf_len += len;
+		return 0;
+	}
+
+	/*
+	 * out = [held back bytes || head of in] || middle of in, and the last
+	 * keep bytes of in are held back. in is read before out is written
+	 * where they may overlap
+	 */
+	off  = ctx->buf_len ? blklen : 0;
+	head = ctx->buf_len ? blklen - ctx->buf_len : 0;
+	mid  = total - keep - off;
+	memcpy(first, ctx->buf, ctx->buf_len);
+	memcpy(first + ctx->buf_len, in, head);
+	memcpy(last, in + len - keep, keep);
+	memmove(out + off, in + head, mid);
+
+	ctx->pad = NULL;
+	if (off) {
+		crypt(ctx, first, blklen);
+		memcpy(out, first, blklen);
+	}
+	crypt(ctx, out + off, mid);
+	ctx->pad = pad;
+
+	memcpy(ctx->buf, last, keep);
+	ctx->buf_len = keep;
+	memset(first, 0, sizeof(first));
+	memset(last, 0, sizeof(last));
+	return total - keep;
+}
+
+ssize_t cipher_final(cipher_ctx_t *ctx, uint8_t *out, int decrypt)
+{
+	ssize_t n = 0;
+	int blklen = ctx->cipher->blklen / 8;
+
+	if (ctx->pad) {
+		/* a padded ciphertext ends with a whole block */
+		if (decrypt && ctx->buf_len != blklen) return -1;
+		n = decrypt ? ctx->decrypt(ctx, ctx->buf, blklen) : ctx->encrypt(ctx, ctx->buf, ctx->buf_len);
+		/* the padding is 1..blklen bytes, a tampered block can say 0 or more */
+		if (decrypt && (n < 0 || n >= blklen)) {
+			memset(ctx->buf, 0, sizeof(ctx->buf));
+			ctx->buf_len = 0;
+			return -1;
+		}
+		memcpy(out, ctx->buf, n);
+	} else if (ctx->buf_len) {
+		/* ECB and CBC without padding */
+		return -1;
+	}
+	memset(ctx->buf, 0, sizeof(ctx->buf));
+	ctx->buf_len = 0;
+	return n;
+}
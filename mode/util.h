@@ -0,0 +1,75 @@
+/*
+   Copyright 2020 Andrew Li, Gavin Li
+
+   li.andrew.mail@gmail.com
+   gavinux@gmail.com
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef __MODE_UTIL_H__
+#define __MODE_UTIL_H__
+
+/* helpers shared by the modes in mode/ and the AEADs in gmac/ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+/* little-endian words on any host */
+static inline uint64_t load_le64(const uint8_t *p)
+{
+	uint64_t x;
+
+	memcpy(&x, p, sizeof(x));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	x = __builtin_bswap64(x);
+#endif
+	return x;
+}
+
+static inline void store_le64(uint8_t *p, uint64_t x)
+{
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	x = __builtin_bswap64(x);
+#endif
+	memcpy(p, &x, sizeof(x));
+}
+
+/* buf ^= ks, 8 bytes at a time, buf may be unaligned */
+static inline void xor_keystream(uint8_t *buf, const uint8_t *ks, size_t len)
+{
+	uint64_t a, b;
+
+	for (; len >= sizeof(a); len -= sizeof(a), buf += sizeof(a), ks += sizeof(a)) {
+		memcpy(&a, buf, sizeof(a));
+		memcpy(&b, ks, sizeof(b));
+		a ^= b;
+		memcpy(buf, &a, sizeof(a));
+	}
+	while (len--)
+		*buf++ ^= *ks++;
+}
+
+/* 0 if the n bytes of a and b are equal, the time doesn't depend on where they differ */
+static inline int ct_memcmp(const uint8_t *a, const uint8_t *b, size_t n)
+{
+	size_t i;
+	volatile uint8_t d = 0;
+
+	for (i=0; i<n; i++)
+		d |= a[i] ^ b[i];
+	return -(int)((d + 0xff) >> 8);  /* 0 or -1 */
+}
+
+#endif /* __MODE_UTIL_H__ */
@@ -0,0 +1,236 @@
+/*
+   Copyright 2020 Andrew Li, Gavin Li
+
+   li.andrew.mail@gmail.com
+   gavinux@gmail.com
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+/*
+ * XTS-AES, IEEE Std 1619-2018, with ciphertext stealing.
+ * a data unit (sector) is en/decrypted under the tweak
+ * T = E(Key2, sector number as 16 little-endian bytes),
+ * block j is whitened with T * alpha^j in GF(2^128)
+ */
+#include <assert.h>
+#include <string.h>
+#include "cipher-mode.h"
+#include "util.h"
+#include "pool.h"
+
+#define XTS_BLK_LEN  16
+#define XTS_BATCH    8   /* blocks or sector tweaks per cipher call */
+
+/* t = t * alpha, t[0] is the low half of the 128-bit number */
+static inline void xts_mul_alpha(uint64_t t[2])
+{
+	uint64_t carry = t[1] >> 63;
+
+	t[1] = t[1] << 1 | t[0] >> 63;
+	t[0] = t[0] << 1 ^ (0x87 & -carry);
+}
+
+/*
+ * nblocks whole blocks, XTS_BATCH at a time: the tweaks of a batch are
+ * laid out next to each other, xored in, one multi-block cipher call,
+ * xored out again. t is advanced past the last block
+ */
+static void xts_blocks(xts_ctx_t *ctx, uint8_t *buf, size_t nblocks, uint64_t t[2], int decrypt)
+{
+	size_t i, n;
+	uint8_t tw[XTS_BATCH * XTS_BLK_LEN];
+
+	while (nblocks) {
+		n = nblocks < XTS_BATCH ? nblocks : XTS_BATCH;
+		for (i=0; i<n; i++) {
+			store_le64(tw + i*XTS_BLK_LEN, t[0]);
+			store_le64(tw + i*XTS_BLK_LEN + 8, t[1]);
+			xts_mul_alpha(t);
+		}
+		xor_keystream(buf, tw, n * XTS_BLK_LEN);
+		if (decrypt)
+			ctx->cipher->decrypt(ctx->cipher, buf, n);
+		else
+			ctx->cipher->encrypt(ctx->cipher, buf, n);
+		xor_keystream(buf, tw, n * XTS_BLK_LEN);
+		buf += n * XTS_BLK_LEN;
+		nblocks -= n;
+	}
+	memset(tw, 0, sizeof(tw));
+}
+
+/*
+ * one data unit under the encrypted tweak t, a trailing partial block
+ * steals the tail of the ciphertext of the last whole block
+ */
+static int xts_unit(xts_ctx_t *ctx, uint8_t *buf, size_t len, uint64_t t[2], int decrypt)
+{
+	size_t m = len / XTS_BLK_LEN, r = len % XTS_BLK_LEN;
+	uint64_t t1[2];
+	uint8_t cc[XTS_BLK_LEN], *last;
+
+	if (len < XTS_BLK_LEN) return -1;
+	if (!r) {
+		xts_blocks(ctx, buf, m, t, decrypt);
+		return 0;
+	}
+
+	xts_blocks(ctx, buf, m - 1, t, decrypt);
+	last = buf + (m - 1) * XTS_BLK_LEN;
+	t1[0] = t[0];
+	t1[1] = t[1];
+	xts_mul_alpha(t1);
+	/* the block before the partial one uses the later tweak when decrypting */
+	xts_blocks(ctx, last, 1, decrypt ? t1 : t, decrypt);
+	memcpy(cc, last, XTS_BLK_LEN);
+	memcpy(last, last + XTS_BLK_LEN, r);
+	memcpy(last + XTS_BLK_LEN, cc, r);
+	xts_blocks(ctx, last, 1, decrypt ? t : t1, decrypt);
+	memset(cc, 0, sizeof(cc));
+	return 0;
+}
+
+/* the tweaks of n consecutive sectors, encrypted by one call */
+static void xts_tweaks(xts_ctx_t *ctx, uint64_t sector, uint8_t *tw, size_t n)
+{
+	size_t i;
+
+	for (i=0; i<n; i++) {
+		store_le64(tw + i*XTS_BLK_LEN, sector + i);
+		store_le64(tw + i*XTS_BLK_LEN + 8, 0);
+	}
+	ctx->tweak->encrypt(ctx->tweak, tw, n);
+}
+
+/* one sector under the encrypted tweak tw */
+static int xts_sector(xts_ctx_t *ctx, uint8_t *buf, size_t len, const uint8_t *tw, int decrypt)
+{
+	int ret;
+	uint64_t t[2];
+
+	t[0] = load_le64(tw);
+	t[1] = load_le64(tw + 8);
+	ret = xts_unit(ctx, buf, len, t, decrypt);
+	memset(t, 0, sizeof(t));
+	return ret;
+}
+
+static int xts_crypt(xts_ctx_t *ctx, uint8_t *buf, size_t len, uint64_t sector, int decrypt)
+{
+	int ret;
+	uint8_t tw[XTS_BLK_LEN];
+
+	xts_tweaks(ctx, sector, tw, 1);
+	ret = xts_sector(ctx, buf, len, tw, decrypt);
+	memset(tw, 0, sizeof(tw));
+	return ret;
+}
+
+static int xts_encrypt(xts_ctx_t *ctx, uint8_t *buf, size_t len, uint64_t sector)
+{
+	return xts_crypt(ctx, buf, len, sector, 0);
+}
+
+static int xts_decrypt(xts_ctx_t *ctx, uint8_t *buf, size_t len, uint64_t sector)
+{
+	return xts_crypt(ctx, buf, len, sector, 1);
+}
+
+/*
+ * sector batches: the sectors are independent, so the tweaks of
+ * XTS_BATCH sectors are encrypted together and the sectors are
+ * cut into nthreads runs for the worker pool
+ */
+struct xts_job {
+	xts_ctx_t *ctx;
+	uint8_t   *buf;
+	size_t     nsectors;
+	uint64_t   sector;
+	int        decrypt;
+	int        ret;      /* -1 if a sector failed */
+};
+
+static void xts_worker(void *arg)
+{
+	struct xts_job *job = arg;
+	xts_ctx_t *ctx = job->ctx;
+	size_t i, n, left = job->nsectors;
+	uint64_t sector = job->sector;
+	uint8_t *buf = job->buf, tw[XTS_BATCH * XTS_BLK_LEN];
+
+	job->ret = 0;
+	while (left) {
+		n = left < XTS_BATCH ? left : XTS_BATCH;
+		xts_tweaks(ctx, sector, tw, n);
+		for (i=0; i<n; i++) {
+			job->ret |= xts_sector(ctx, buf, ctx->sector_len, tw + i*XTS_BLK_LEN, job->decrypt);
+			buf += ctx->sector_len;
+		}
+		sector += n;
+		left -= n;
+	}
+	memset(tw, 0, sizeof(tw));
+}
+
+static int xts_sectors_mt(xts_ctx_t *ctx, uint8_t *buf, size_t nsectors, uint64_t sector, int decrypt, int nthreads)
+{
+	int t, ret = 0;
+	size_t per, first;
+	struct xts_job job[POOL_MAX_THREADS];
+
+	nthreads = pool_threads(nthreads, nsectors * ctx->sector_len);
+	per = (nsectors + nthreads - 1) / nthreads;
+	for (t=0; t<nthreads; t++) {
+		first = t * per < nsectors ? t * per : nsectors;
+		job[t].ctx      = ctx;
+		job[t].buf      = buf + first * ctx->sector_len;
+		job[t].nsectors = nsectors - first < per ? nsectors - first : per;
+		job[t].sector   = sector + first;
+		job[t].decrypt  = decrypt;
+	}
+	run_jobs(xts_worker, job, sizeof(job[0]), nthreads);
+	for (t=0; t<nthreads; t++)
+		ret |= job[t].ret;
+	return ret;
+}
+
+int xts_encrypt_sectors(xts_ctx_t *ctx, uint8_t *buf, size_t nsectors, uint64_t sector, int nthreads)
+{
+	assert(ctx->encrypt == xts_encrypt);
+	return xts_sectors_mt(ctx, buf, nsectors, sector, 0, nthreads);
+}
+
+int xts_decrypt_sectors(xts_ctx_t *ctx, uint8_t *buf, size_t nsectors, uint64_t sector, int nthreads)
+{
+	assert(ctx->decrypt == xts_decrypt);
+	return xts_sectors_mt(ctx, buf, nsectors, sector, 1, nthreads);
+}
+
+int xts_init(xts_ctx_t *ctx, blk_ctx_t *key1, blk_ctx_t *key2, size_t sector_len)
+{
+	assert(ctx);
+	assert(key1);
+	assert(key2);
+	if (key1->blklen != XTS_BLK_LEN * 8 || key2->blklen != XTS_BLK_LEN * 8) return -1;
+	if (sector_len < XTS_BLK_LEN) return -1;
+
+	memset(ctx, 0, sizeof(*ctx));
+	ctx->init       = xts_init;
+	ctx->encrypt    = xts_encrypt;
+	ctx->decrypt    = xts_decrypt;
+	ctx->cipher     = key1;
+	ctx->tweak      = key2;
+	ctx->sector_len = sector_len;
+	return 0;
+}
@@ -0,0 +1,212 @@
+/*
+   Copyright 2020 Andrew Li, Gavin Li
+
+   li.andrew.mail@gmail.com
+   gavinux@gmail.com
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+/*
+ * Implementation is based on NIST SP 800-90A Rev.1
+ * 10.2.1 CTR_DRBG, AES-256, derivation function is not used,
+ * so the entropy input must be full entropy of seedlen bits
+ */
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/random.h>
+#include "drbg.h"
+
+static int drbg_reseed(drbg_ctx_t *ctx, uint8_t *entropy);
+static int drbg_generate(drbg_ctx_t *ctx, uint8_t *out, size_t len);
+static int drbg_read(drbg_ctx_t *ctx, uint8_t *out, size_t len);
+
+int drbg_get_entropy(uint8_t *buf, size_t len)
+{
+	int fd;
+	ssize_t n;
+
+	while (len) {
+		n = getrandom(buf, len, 0);
+		if (n < 0) {
+			if (errno == EINTR) continue;
+			break; /* ENOSYS: kernel older than 3.17 */
+		}
+		buf += n;
+		len -= n;
+	}
+	if (!len) return 0;
+
+	fd = open("/dev/urandom", O_RDONLY);
+	if (fd < 0) return -1;
+	while (len) {
+		n = read(fd, buf, len);
+		if (n <= 0) {
+			if (n < 0 && errno == EINTR) continue;
+			break;
+		}
+		buf += n;
+		len -= n;
+	}
+	close(fd);
+	return len ? -1 : 0;
+}
+
+/* V = (V + 1) mod 2^blocklen */
+static void inc_v(uint8_t v[DRBG_BLK_LEN])
+{
+	int i;
+	for (i=DRBG_BLK_LEN-1; i>=0; i--)
+		if (++v[i]) break;
+}
+
+/* put nblocks successive counter blocks V+1, V+2, ... to out, and encrypt them in one call */
+static void ctr_blocks(drbg_ctx_t *ctx, uint8_t *out, size_t nblocks)
+{
+	size_t i;
+
+	for (i=0; i<nblocks; i++) {
+		inc_v(ctx->v);
+		memcpy(out + i*DRBG_BLK_LEN, ctx->v, DRBG_BLK_LEN);
+	}
+	ctx->aes.encrypt(&ctx->aes, out, nblocks);
+}
+
+/* 10.2.1.2 CTR_DRBG_Update, data is seedlen bytes or NULL for all zeros */
+static void drbg_update(drbg_ctx_t *ctx, uint8_t *data)
+{
+	int i;
+	uint8_t temp[DRBG_SEED_LEN];
+
+	ctr_blocks(ctx, temp, DRBG_SEED_LEN/DRBG_BLK_LEN);
+	if (data) {
+		for (i=0; i<DRBG_SEED_LEN; i++)
+			temp[i] ^= data[i];
+	}
+	aes_init(&ctx->aes, temp, DRBG_KEY_LEN*8);
+	memcpy(ctx->v, temp + DRBG_KEY_LEN, DRBG_BLK_LEN);
+	memset(temp, 0, sizeof(temp));
+}
+
+/* 10.2.1.3.1 Instantiation When a Derivation Function is Not Used */
+int drbg_init(drbg_ctx_t *ctx, uint8_t *entropy, uint8_t *pers, size_t pers_len)
+{
+	int i;
+	uint8_t seed[DRBG_SEED_LEN];
+	uint8_t key[DRBG_KEY_LEN];
+
+	assert(ctx);
+	if (pers_len > DRBG_SEED_LEN) return -1;
+
+	memset(ctx, 0, sizeof(*ctx));
+	ctx->init     = drbg_init;
+	ctx->reseed   = drbg_reseed;
+	ctx->generate = drbg_generate;
+	ctx->read     = drbg_read;
+
+	if (entropy)
+		memcpy(seed, entropy, DRBG_SEED_LEN);
+	else if (drbg_get_entropy(seed, DRBG_SEED_LEN))
+		return -2;
+	/* seed_material = entropy_input XOR personalization_string */
+	for (i=0; i<pers_len; i++)
+		seed[i] ^= pers[i];
+
+	/* Key = 0^keylen, V = 0^blocklen */
+	memset(key, 0, sizeof(key));
+	aes_init(&ctx->aes, key, DRBG_KEY_LEN*8);
+	drbg_update(ctx, seed);
+	memset(seed, 0, sizeof(seed));
+	ctx->reseed_counter = 1;
+	return 0;
+}
+
+/* 10.2.1.4.1 Reseeding When a Derivation Function is Not Used */
+static int drbg_reseed(drbg_ctx_t *ctx, uint8_t *entropy)
+{
+	uint8_t seed[DRBG_SEED_LEN];
+
+	if (entropy)
+		memcpy(seed, entropy, DRBG_SEED_LEN);
+	else if (drbg_get_entropy(seed, DRBG_SEED_LEN))
+		return -1;
+	drbg_update(ctx, seed);
+	memset(seed, 0, sizeof(seed));
+	ctx->reseed_counter = 1;
+	/* buffered output came from the old state */
+	memset(ctx->buffer, 0, sizeof(ctx->buffer));
+	ctx->buf_len = 0;
+	return 0;
+}
+
+/* 10.2.1.5.1 Generating Pseudorandom Bits When a Derivation Function is Not Used */
+static int drbg_generate(drbg_ctx_t *ctx, uint8_t *out, size_t len)
+{
+	size_t n;
+	uint8_t blk[DRBG_BLK_LEN];
+
+	if (len > DRBG_MAX_REQUEST) return -1;
+	if (ctx->reseed_counter > DRBG_RESEED_INTERVAL) {
+		if (drbg_reseed(ctx, NULL)) return -2;
+	}
+
+	/* full blocks are encrypted in place in the output buffer */
+	n = len / DRBG_BLK_LEN;
+	if (n) ctr_blocks(ctx, out, n);
+	if (len % DRBG_BLK_LEN) {
+		ctr_blocks(ctx, blk, 1);
+		memcpy(out + n*DRBG_BLK_LEN, blk, len % DRBG_BLK_LEN);
+		memset(blk, 0, sizeof(blk));
+	}
+	/* additional_input is not supported, it is all zeros */
+	drbg_update(ctx, NULL);
+	ctx->reseed_counter++;
+	return 0;
+}
+
+/*
+ * the buffer is consumed from its end, the consumed bytes are wiped
+ * so the output can't be recovered from a later memory dump
+ */
+static int drbg_read(drbg_ctx_t *ctx, uint8_t *out, size_t len)
+{
+	size_t n;
+	uint8_t *p;
+
+	while (len) {
+		if (!ctx->buf_len) {
+			if (len >= DRBG_BUF_SIZE) {
+				/* big request, bypass the buffer */
+				n = len < DRBG_MAX_REQUEST ? len : DRBG_MAX_REQUEST;
+				n -= n % DRBG_BLK_LEN;
+				if (drbg_generate(ctx, out, n)) return -1;
+				out += n;
+				len -= n;
+				continue;
+			}
+			if (drbg_generate(ctx, ctx->buffer, DRBG_BUF_SIZE)) return -1;
+			ctx->buf_len = DRBG_BUF_SIZE;
+		}
+		n = len < ctx->buf_len ? len : ctx->buf_len;
+		p = ctx->buffer + ctx->buf_len - n;
+		memcpy(out, p, n);
+		memset(p, 0, n);
+		ctx->buf_len -= n;
+		out += n;
+		len -= n;
+	}
+	return 0;
+}
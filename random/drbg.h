@@ -0,0 +1,64 @@
+/*
+   Copyright 2020 Andrew Li, Gavin Li
+
+   li.andrew.mail@gmail.com
+   gavinux@gmail.com
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef __DRBG_H__
+#define __DRBG_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include "aes.h"
+
+/*
+ * NIST SP 800-90A Rev.1 CTR_DRBG, AES-256, no derivation function
+ */
+#define DRBG_KEY_LEN          32    /* bytes */
+#define DRBG_BLK_LEN          16    /* bytes */
+#define DRBG_SEED_LEN         (DRBG_KEY_LEN + DRBG_BLK_LEN)
+#define DRBG_MAX_REQUEST      (1 << 16)  /* bytes per generate(), SP 800-90A allows 2^19 bits */
+#define DRBG_RESEED_INTERVAL  (1UL << 16) /* generate() calls between reseeds */
+#define DRBG_BUF_SIZE         1024  /* bytes buffered for read() */
+
+typedef struct drbg_ctx drbg_ctx_t;
+
+struct drbg_ctx {
+	/*
+	 * entropy is DRBG_SEED_LEN bytes of full entropy input,
+	 * if it is NULL, the entropy is pulled from the kernel by getrandom()
+	 * pers is optional personalization string, at most DRBG_SEED_LEN bytes
+	 */
+	int  (*init)(drbg_ctx_t *ctx, uint8_t *entropy, uint8_t *pers, size_t pers_len);
+	int  (*reseed)(drbg_ctx_t *ctx, uint8_t *entropy);
+	/* SP 800-90A Generate, len <= DRBG_MAX_REQUEST */
+	int  (*generate)(drbg_ctx_t *ctx, uint8_t *out, size_t len);
+	/* any length, served from the internal buffer which is refilled by generate() */
+	int  (*read)(drbg_ctx_t *ctx, uint8_t *out, size_t len);
+
+	aes_ctx_t aes;
+	uint8_t   v[DRBG_BLK_LEN];
+	uint64_t  reseed_counter;
+	uint32_t  buf_len;   /* unread bytes at the end of buffer */
+	uint8_t   buffer[DRBG_BUF_SIZE];
+};
+
+int  drbg_init(drbg_ctx_t *ctx, uint8_t *entropy, uint8_t *pers, size_t pers_len);
+
+/* fill buf with len bytes from the operating system entropy source */
+int  drbg_get_entropy(uint8_t *buf, size_t len);
+
+#endif /* __DRBG_H__ */
@@ -0,0 +1,77 @@
+/*
+   Copyright 2020 Andrew Li, Gavin Li
+
+   li.andrew.mail@gmail.com
+   gavinux@gmail.com
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sha-common.h"
+#include "drbg.h"
+
+/*
+ * test vectors coming from
+ * https://csrc.nist.gov/Projects/cryptographic-algorithm-validation-program/Random-Number-Generators
+ * only [AES-256 no df] without additional input is tested:
+ * instantiate, generate (discarded), generate (compared with ReturnedBits)
+ */
+int main(int argc, char *argv[])
+{
+	drbg_ctx_t ctx;
+	char *token;
+	char filename[] = "downloads/drbgtestvectors/drbgvectors_no_reseed/CTR_DRBG.rsp";
+	int  line = 0, active = 0, tests = 0;
+	int  perslen = 0, adinlen = 0, retlen = 0;
+	uint32_t value = 0;
+	uint8_t buf[1024];
+	uint8_t entropy[DRBG_SEED_LEN], pers[DRBG_SEED_LEN], ret[256], out[256];
+	FILE *fp;
+
+	fp = fopen(filename, "r");
+	assert(fp);
+	while (fgets(buf, sizeof(buf), fp)) {
+		line++;
+		strtok(buf, "\r\n");
+		if (!strncmp(buf, "[AES-256 no df]", 15)) active = 1;
+		else if (!strncmp(buf, "[AES-", 5) || !strncmp(buf, "[TDES", 5)) active = 0;
+		else if (token=strstr(buf, "[PersonalizationStringLen = ")) perslen = atoi(token + 28) / 8;
+		else if (token=strstr(buf, "[AdditionalInputLen = "))  adinlen = atoi(token + 22) / 8;
+		else if (token=strstr(buf, "[ReturnedBitsLen = "))     retlen  = atoi(token + 19) / 8;
+		else if (!active || adinlen) continue;
+		else if (!strncmp(buf, "COUNT = ", 8)) value = 0x01;
+		else if (!strncmp(buf, "EntropyInput = ", 15)) {value |= 0x02; hex2ba(buf + 15, entropy, sizeof(entropy));}
+		else if (!strncmp(buf, "PersonalizationString = ", 24)) {value |= 0x04; hex2ba(buf + 24, pers, sizeof(pers));}
+		else if (!strncmp(buf, "ReturnedBits = ", 15)) {value |= 0x08; hex2ba(buf + 15, ret, sizeof(ret));}
+
+		if (value != 0x0F) continue;
+		value = 0;
+
+		assert(!drbg_init(&ctx, entropy, pers, perslen));
+		assert(!ctx.generate(&ctx, out, retlen));
+		assert(!ctx.generate(&ctx, out, retlen));
+		if (memcmp(out, ret, retlen)) {
+			printf("CTR_DRBG failed at line %d of file %s\n", line, filename);
+			exit(-1);
+		}
+		tests++;
+	}
+	fclose(fp);
+	printf("%d tests\n", tests);
+	printf("ALL CTR_DRBG TESTS PASSED!\n");
+	return 0;
+}
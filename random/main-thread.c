@@ -0,0 +1,79 @@
+/*
+   Copyright 2020 Andrew Li, Gavin Li
+
+   li.andrew.mail@gmail.com
+   gavinux@gmail.com
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "random.h"
+
+#define NTHREADS 4
+#define NBYTES   32
+
+static uint8_t out[NTHREADS + 2][NBYTES];
+
+static void *worker(void *arg)
+{
+	uint8_t *p = arg;
+	assert(!random_bytes(p, NBYTES));
+	return NULL;
+}
+
+/*
+ * every thread and a forked child must get different output,
+ * the parent draws first so the child inherits a used DRBG buffer
+ */
+int main(int argc, char *argv[])
+{
+	pthread_t tid[NTHREADS];
+	int i, j, fd[2], status;
+	uint8_t tmp[NBYTES];
+	pid_t pid;
+
+	for (i=0; i<NTHREADS; i++)
+		assert(!pthread_create(&tid[i], NULL, worker, out[i]));
+	for (i=0; i<NTHREADS; i++)
+		pthread_join(tid[i], NULL);
+
+	assert(!random_bytes(tmp, NBYTES));
+	assert(!pipe(fd));
+	pid = fork();
+	assert(pid >= 0);
+	if (!pid) {
+		random_bytes(tmp, NBYTES);
+		assert(write(fd[1], tmp, NBYTES) == NBYTES);
+		_exit(0);
+	}
+	assert(!random_bytes(out[NTHREADS], NBYTES));
+	assert(read(fd[0], out[NTHREADS+1], NBYTES) == NBYTES);
+	waitpid(pid, &status, 0);
+
+	for (i=0; i<NTHREADS+2; i++) {
+		for (j=i+1; j<NTHREADS+2; j++) {
+			if (!memcmp(out[i], out[j], NBYTES)) {
+				printf("random output %d and %d are equal\n", i, j);
+				return -1;
+			}
+		}
+	}
+	printf("ALL THREAD/FORK RANDOM TESTS PASSED!\n");
+	return 0;
+}
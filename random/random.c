@@ -17,100 +17,84 @@
    limitations under the License.
 */
 
+#include <assert.h>
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
 #include "bn.h"
+#include "drbg.h"
 #include "random.h"
 
-#ifndef USE_LINUX_URANDOM
-
-#include <string.h>
-#include <sys/time.h>
-#include "sha-common.h"
-#include "sha1.h"
+/*
+ * every thread owns its DRBG instance, seeded from getrandom() on first use,
+ * so there is no lock and no state shared between threads.
+ * a forked child would inherit the parent's state and repeat its output,
+ * the atfork handler bumps fork_gen and the child instantiates a new DRBG
+ */
+static __thread drbg_ctx_t drbg;
+static __thread uint32_t drbg_gen;   /* fork_gen + 1 when instantiated, 0 never */
+static uint32_t fork_gen;
+static pthread_once_t atfork_once = PTHREAD_ONCE_INIT;
+
+static void random_atfork_child(void)
+{
+	fork_gen++;
+}
 
-/* 20 bytes pseudorandom output */
-static int rand(uint8_t rnd20[SHA1_DIGEST_LENGTH/8])
+static void random_atfork_register(void)
 {
-	int i, again;
-	sha_ctx_t ctx;
-	struct timeval tv;
-	uint8_t t[SHA1_DIGEST_LENGTH/8];
-	/* don't initialize c[], just use the value AS IS */
-	uint8_t c[SHA1_DIGEST_LENGTH/8];
-
-	if (gettimeofday(&tv, NULL)) return -1;
-	if (hash_init(eHASH_SHA1, &ctx)) return -2;
-	ctx.update(&ctx, (uint8_t *)&tv, sizeof(tv));
-	ctx.final(&ctx, t);
-	do {
-		/* HAC Algorithm 5.15 */
-		ctx.init(&ctx);
-		memcpy(((sha1_ctx_t *)&ctx)->state, t, sizeof(t));
-		ctx.update(&ctx, c, sizeof(c));
-		ctx.final(&ctx, rnd20);
-		/* end of HAC Algorithm 5.15 */
-		again = 0;
-		for (i=0; i<SHA1_DIGEST_LENGTH/8; i++) {
-			if (!rnd20[i]) again = 1;
-		}
-		if (again) memcpy(c, rnd20, SHA1_DIGEST_LENGTH/8);
-	} while (again);
+	pthread_atfork(NULL, NULL, random_atfork_child);
+}
 
+static int random_instantiate(void)
+{
+	struct {
+		char  name[16];
+		pid_t pid;
+		pid_t tid;
+	} pers;
+
+	pthread_once(&atfork_once, random_atfork_register);
+	/* the personalization string makes instances distinct even with equal entropy */
+	memset(&pers, 0, sizeof(pers));
+	strcpy(pers.name, "OpenCrypto");
+	pers.pid = getpid();
+	pers.tid = syscall(SYS_gettid);
+	if (drbg_init(&drbg, NULL, (uint8_t *)&pers, sizeof(pers))) return -1;
+	drbg_gen = fork_gen + 1;
 	return 0;
 }
 
-/* if array u8[] is longer than nbits, the caller have to clear it first */
-int  get_random(int nbits, uint8_t u8[])
+int  random_bytes(uint8_t *buf, size_t len)
 {
-	int n = nbits;
-	uint8_t rnd[SHA1_DIGEST_LENGTH/8];
-	for (; n>=0; n-=SHA1_DIGEST_LENGTH) {
-		if (rand(rnd)) return -1;
-		if (n > SHA1_DIGEST_LENGTH)
-			memcpy(u8+(n-SHA1_DIGEST_LENGTH)/8, rnd, SHA1_DIGEST_LENGTH/8);
-		else
-			memcpy(u8, rnd, (n+7)/8);
+	if (drbg_gen != fork_gen + 1) {
+		if (random_instantiate()) return -1;
 	}
-	/* make sure msbit = 1 */
-	u8[0] &= (0xFF >> ((8-nbits%8)&7));
-	u8[0] |= (1<<(nbits-1)%8);
-	/* make sure lsbit = 1 */
-	u8[(nbits+7)/8-1] |= 1;
-	return nbits;
+	return drbg.read(&drbg, buf, len);
 }
 
-#else
-
-#include <unistd.h>
-#include <sys/types.h>
-#include <sys/stat.h>
-#include <fcntl.h>
-
 /* if array u8[] is longer than nbits, the caller have to clear it first */
 int  get_random(int nbits, uint8_t u8[])
 {
-	int fd, nbytes;
+	int i, nbytes;
 
 	nbytes = (nbits+7)/8;
-
-	fd = open("/dev/urandom", O_RDONLY);
-	if (fd) {
-		while (nbytes) {
-			read(fd, &u8[nbytes-1], 1);
-			if (u8[nbytes-1]) nbytes--;
+	if (random_bytes(u8, nbytes)) return -1;
+	/* no zero bytes in output, rsaes-pkcs1 padding string relies on it */
+	for (i=0; i<nbytes; i++) {
+		while (!u8[i]) {
+			if (random_bytes(&u8[i], 1)) return -1;
 		}
-		close(fd);
-		/* make sure msbit = 1 */
-		u8[0] &= ((0xFF >> (8-nbits%8))&7);
-		u8[0] |= (1<<(nbits-1)%8);
-		/* make sure lsbit = 1 */
-		u8[(nbits+7)/8-1] |= 1;
-		return nbits;
 	}
-	return -1;
+	/* make sure msbit = 1 */
+	u8[0] &= (0xFF >> ((8-nbits%8)&7));
+	u8[0] |= (1<<(nbits-1)%8);
+	/* make sure lsbit = 1 */
+	u8[nbytes-1] |= 1;
+	return nbits;
 }
 
-#endif
-
 uint32_t bn_gen_random(int bitlength, bn_t bn)
 {
         uint8_t c;
@@ -127,3 +111,29 @@ uint32_t bn_gen_random(int bitlength, bn_t bn)
         return bitlength;
 }
 
+/*
+ * FIPS 186-4 B.4.1 / B.5.1 "Extra Random Bits":
+ * c is bitlen(n) + 64 random bits, out = c mod (n-1) + 1,
+ * the bias is below 2^-64 and there is no retry loop
+ */
+int  bn_rand_range(bn_t n, bn_t out)
+{
+	int nbytes, rc;
+	uint8_t c[sizeof(bn_t)];
+	bn_t n1;
+
+	assert(bn_getmsbposn(n) > 1);   /* n >= 2 */
+	nbytes = (bn_getmsbposn(n) + 64 + 7) / 8;
+	assert(nbytes <= sizeof(c));
+
+	rc = random_bytes(c, nbytes);
+	if (!rc) {
+		bn_ba2bn(c, nbytes, out);
+		bn_cpy(n, n1);
+		bn_subx(1, n1);
+		bn_mod(out, n1, out);
+		bn_addx(1, out);
+	}
+	memset(c, 0, nbytes);
+	return rc;
+}
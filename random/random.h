@@ -20,14 +20,21 @@
 #ifndef __RANDOM_H__
 #define __RANDOM_H__
 
+#include <stddef.h>
 #include <stdint.h>
 #include "bn.h"
 
+/* len bytes of CTR_DRBG output, any byte value, per-thread and fork-safe */
+int  random_bytes(uint8_t *buf, size_t len);
+
 /* if array u8[] is longer than nbits, the caller has to clear it first */
 int  get_random(int nbits, uint8_t u8[]);
 
 /* bn will be cleared first inside bn_gen_random() */
 uint32_t bn_gen_random(int bitlength, bn_t bn);
 
+/* uniform out in [1, n-1], for private keys and nonces */
+int  bn_rand_range(bn_t n, bn_t out);
+
 #endif /* __RANDOM_H__ */
 
@@ -0,0 +1,111 @@
+/*
+   Copyright 2020 Andrew Li, Gavin Li
+
+   li.andrew.mail@gmail.com
+   gavinux@gmail.com
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <assert.h>
+#include <string.h>
+#include "rfc6979.h"
+
+static void rfc6979_generate(rfc6979_ctx_t *ctx, bn_t k);
+
+/* 2.3.2 bits2int: the leftmost qlen bits of the len bytes */
+static void bits2int(rfc6979_ctx_t *ctx, uint8_t *b, uint32_t len, bn_t r)
+{
+	bn_ba2bn(b, len, r);
+	if (len*8 > ctx->qlen)
+		bn_rshift(r, len*8 - ctx->qlen, r);
+}
+
+/* K = HMAC_K(V || sep || data),  V = HMAC_K(V) */
+static void hmac_kv(rfc6979_ctx_t *ctx, uint8_t sep, uint8_t *data, uint32_t len)
+{
+	hmac_ctx_t *hmac = &ctx->hmac;
+
+	hmac_init(hmac, ctx->K, ctx->mdlen, ctx->hash_id);
+	hmac->update(hmac, ctx->V, ctx->mdlen);
+	hmac->update(hmac, &sep, 1);
+	if (len) hmac->update(hmac, data, len);
+	hmac->final(hmac, ctx->K);
+
+	hmac_init(hmac, ctx->K, ctx->mdlen, ctx->hash_id);
+	hmac->update(hmac, ctx->V, ctx->mdlen);
+	hmac->final(hmac, ctx->V);
+}
+
+int  rfc6979_init(rfc6979_ctx_t *ctx, bn_t q, bn_t x, uint8_t *h1, uint32_t hlen)
+{
+	bn_t z;
+	uint8_t seed[2 * sizeof(bn_t)];
+
+	memset(ctx, 0, sizeof(*ctx));
+	ctx->init     = rfc6979_init;
+	ctx->generate = rfc6979_generate;
+
+	if (hlen <= SHA1_DIGEST_LENGTH/8)        ctx->hash_id = eHASH_SHA1;
+	else if (hlen <= SHA224_DIGEST_LENGTH/8) ctx->hash_id = eHASH_SHA224;
+	else if (hlen <= SHA256_DIGEST_LENGTH/8) ctx->hash_id = eHASH_SHA256;
+	else if (hlen <= SHA384_DIGEST_LENGTH/8) ctx->hash_id = eHASH_SHA384;
+	else                                     ctx->hash_id = eHASH_SHA512;
+	ctx->mdlen = hmac_init(&ctx->hmac, ctx->K, 0, ctx->hash_id);
+	ctx->qlen  = bn_getmsbposn(q);
+	ctx->rlen  = (ctx->qlen + 7) / 8;
+	assert(ctx->rlen <= sizeof(bn_t));
+	bn_cpy(q, ctx->q);
+
+	/* seed = int2octets(x) || bits2octets(h1) */
+	bn_bn2ba(x, ctx->rlen, seed);
+	bits2int(ctx, h1, hlen, z);
+	if (bn_cmp(z, q) >= 0)
+		bn_sub(z, q, z);
+	bn_bn2ba(z, ctx->rlen, seed + ctx->rlen);
+
+	/* 3.2 b. - g. */
+	memset(ctx->V, 0x01, ctx->mdlen);
+	memset(ctx->K, 0x00, ctx->mdlen);
+	hmac_kv(ctx, 0x00, seed, 2 * ctx->rlen);
+	hmac_kv(ctx, 0x01, seed, 2 * ctx->rlen);
+
+	memset(seed, 0, sizeof(seed));
+	return 0;
+}
+
+/* 3.2 h. */
+static void rfc6979_generate(rfc6979_ctx_t *ctx, bn_t k)
+{
+	uint32_t tlen, n;
+	uint8_t t[sizeof(bn_t)];
+	hmac_ctx_t *hmac = &ctx->hmac;
+
+	/* the previous k was rejected by the caller */
+	if (ctx->count++)
+		hmac_kv(ctx, 0x00, NULL, 0);
+	while (1) {
+		/* only the leftmost rlen bytes of T are used by bits2int */
+		for (tlen=0; tlen<ctx->rlen; tlen+=n) {
+			hmac_init(hmac, ctx->K, ctx->mdlen, ctx->hash_id);
+			hmac->update(hmac, ctx->V, ctx->mdlen);
+			hmac->final(hmac, ctx->V);
+			n = ctx->rlen - tlen < ctx->mdlen ? ctx->rlen - tlen : ctx->mdlen;
+			memcpy(t + tlen, ctx->V, n);
+		}
+		bits2int(ctx, t, ctx->rlen, k);
+		if (!bn_iszero(k) && bn_cmp(k, ctx->q) < 0) break;
+		hmac_kv(ctx, 0x00, NULL, 0);
+	}
+	memset(t, 0, sizeof(t));
+}
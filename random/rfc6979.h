@@ -0,0 +1,55 @@
+/*
+   Copyright 2020 Andrew Li, Gavin Li
+
+   li.andrew.mail@gmail.com
+   gavinux@gmail.com
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef __RFC6979_H__
+#define __RFC6979_H__
+
+#include <stdint.h>
+#include "bn.h"
+#include "hmac.h"
+
+/*
+ * RFC 6979 Deterministic Usage of DSA and ECDSA
+ * 3.2 Generation of k, HMAC_DRBG keyed by the private key and the message hash.
+ * HMAC uses the hash with the digest length of hlen:
+ * 20 SHA-1, 28 SHA-224, 32 SHA-256, 48 SHA-384, 64 SHA-512,
+ * other lengths take the next longer one of them
+ */
+typedef struct rfc6979_ctx rfc6979_ctx_t;
+
+struct rfc6979_ctx {
+	/* q is the group order, x is the private key, h1 is H(m) of hlen bytes */
+	int  (*init)(rfc6979_ctx_t *ctx, bn_t q, bn_t x, uint8_t *h1, uint32_t hlen);
+	/* k in [1, q-1], call again for the next k when r or s turns out to be 0 */
+	void (*generate)(rfc6979_ctx_t *ctx, bn_t k);
+
+	hmac_ctx_t hmac;
+	int      hash_id;
+	uint32_t mdlen;   /* HMAC output bytes */
+	uint32_t qlen;    /* bit length of q */
+	uint32_t rlen;    /* bytes of q */
+	uint32_t count;   /* k generated so far */
+	uint8_t  K[SHA512_DIGEST_LENGTH/8];
+	uint8_t  V[SHA512_DIGEST_LENGTH/8];
+	bn_t     q;
+};
+
+int  rfc6979_init(rfc6979_ctx_t *ctx, bn_t q, bn_t x, uint8_t *h1, uint32_t hlen);
+
+#endif /* __RFC6979_H__ */